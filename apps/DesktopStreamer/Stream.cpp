@@ -50,8 +50,13 @@
 #include <ApplicationServices/ApplicationServices.h>
 #endif
 #endif
+#include <deflect/CopyRect.h>
+
+#include <QHash>
 #include <QPainter>
 #include <QScreen>
+#include <algorithm>
+#include <map>
 #include <queue>
 
 namespace
@@ -59,6 +64,102 @@ namespace
 const char* CURSOR_IMAGE_FILE = ":/cursor.png";
 const int CURSOR_IMAGE_SIZE = 20;
 const int CURSOR_TIMEOUT_MS = 1000;
+const int MIN_SCROLL_ROWS = 64; // smaller scrolled regions are sent again
+
+/** Rows moved vertically between two images, and the rows left to send. */
+struct Scroll
+{
+    int dy = 0;
+    int begin = 0; // first moved row in the new image
+    int end = 0;   // last moved row (excluded) in the new image
+    int dirtyBegin = 0;
+    int dirtyEnd = 0;
+};
+
+std::vector<uint> _hashRows(const QImage& image)
+{
+    const auto rowSize = image.width() * image.depth() / 8;
+    std::vector<uint> hashes;
+    hashes.reserve(image.height());
+    for (int y = 0; y < image.height(); ++y)
+        hashes.push_back(qHashBits(image.constScanLine(y), rowSize));
+    return hashes;
+}
+
+// Find the displacement of the changed rows which are unique in the previous
+// image, then the longest range of rows that it moves.
+bool _findScroll(const QImage& previous, const QImage& image, Scroll& scroll)
+{
+    if (previous.size() != image.size() || previous.format() != image.format())
+        return false;
+
+    const auto oldRows = _hashRows(previous);
+    const auto newRows = _hashRows(image);
+    const auto height = int(newRows.size());
+
+    QHash<uint, int> oldPositions;
+    for (int y = 0; y < height; ++y)
+    {
+        const auto it = oldPositions.find(oldRows[y]);
+        if (it == oldPositions.end())
+            oldPositions.insert(oldRows[y], y);
+        else
+            *it = -1; // e.g. uniform rows, which match any displacement
+    }
+
+    std::map<int, int> votes;
+    for (int y = 0; y < height; ++y)
+    {
+        if (newRows[y] == oldRows[y])
+            continue;
+        const auto oldY = oldPositions.value(newRows[y], -1);
+        if (oldY >= 0)
+            ++votes[y - oldY];
+    }
+    if (votes.empty())
+        return false;
+
+    using Vote = std::pair<const int, int>;
+    const auto fewerVotes = [](const Vote& a, const Vote& b) {
+        return a.second < b.second;
+    };
+    scroll.dy = std::max_element(votes.begin(), votes.end(), fewerVotes)->first;
+
+    scroll.end = 0;
+    for (int y = std::max(0, scroll.dy), begin = y; y <= height; ++y)
+    {
+        const auto oldY = y - scroll.dy;
+        if (y < height && oldY < height && newRows[y] == oldRows[oldY])
+            continue;
+        if (y - begin > scroll.end - scroll.begin)
+        {
+            scroll.begin = begin;
+            scroll.end = y;
+        }
+        begin = y + 1;
+    }
+    if (scroll.end - scroll.begin < MIN_SCROLL_ROWS)
+        return false;
+
+    scroll.dirtyBegin = height;
+    scroll.dirtyEnd = 0;
+    for (int y = 0; y < height; ++y)
+    {
+        const auto moved = y >= scroll.begin && y < scroll.end;
+        if (newRows[y] != oldRows[moved ? y - scroll.dy : y])
+        {
+            scroll.dirtyBegin = std::min(scroll.dirtyBegin, y);
+            scroll.dirtyEnd = y + 1;
+        }
+    }
+    // Receivers determine the format of the frame from its images
+    if (scroll.dirtyBegin >= scroll.dirtyEnd)
+    {
+        scroll.dirtyBegin = scroll.begin;
+        scroll.dirtyEnd = scroll.begin + 1;
+    }
+    return true;
+}
 }
 
 class Stream::Impl
@@ -195,17 +296,39 @@ public:
         // deflect::BGRA. But for uncompressed images, Deflect currently only
         // supports GL_RGBA so the image colors have to be swapped.
         const auto format = compress ? deflect::BGRA : deflect::RGBA;
+        const auto previous = _image;
         _image = compress ? image : image.rgbSwapped();
 
-        deflect::ImageWrapper deflectImage((const void*)_image.bits(),
-                                           _image.width(), _image.height(),
-                                           format);
+        // OPT: Only send the rows exposed by a vertical scroll
+        Scroll scroll;
+        const auto scrolled = _stream.supportsCopyRect() &&
+                              !_stream.isFullFrameRequested() &&
+                              _findScroll(previous, _image, scroll);
+        const auto firstRow = scrolled ? scroll.dirtyBegin : 0;
+        const auto rows = scrolled ? scroll.dirtyEnd - firstRow
+                                   : _image.height();
+
+        deflect::ImageWrapper deflectImage(
+            (const void*)_image.constScanLine(firstRow), _image.width(), rows,
+            format, 0, firstRow);
         deflectImage.compressionPolicy =
             compress ? deflect::COMPRESSION_ON : deflect::COMPRESSION_OFF;
         deflectImage.compressionQuality = std::max(1, std::min(quality, 100));
         deflectImage.subsampling = subsamp;
 
-        _lastSend = _stream.sendAndFinish(deflectImage);
+        if (!scrolled)
+        {
+            _lastSend = _stream.sendAndFinish(deflectImage);
+            return;
+        }
+
+        deflect::CopyRect copy;
+        copy.y = scroll.begin - scroll.dy;
+        copy.width = _image.width();
+        copy.height = scroll.end - scroll.begin;
+        copy.dy = scroll.dy;
+        _stream.copyRect(copy);
+        _lastSend = _stream.sendAndFinishPartial(deflectImage);
     }
 
 #ifdef __APPLE__
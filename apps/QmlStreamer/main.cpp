@@ -55,17 +55,25 @@ int main(int argc, char** argv)
                                         "name");
     parser.addOption(streamNameOption);
 
+    QCommandLineOption fpsOption("fps",
+                                 "Maximum frame rate, 0 for no limit "
+                                 "(default: 60)",
+                                 "fps", "60");
+    parser.addOption(fpsOption);
+
     parser.process(app);
 
     const QString qmlFile = parser.value(qmlFileOption);
     const QString streamHost = parser.value(streamHostOption);
     const QString streamName = parser.value(streamNameOption);
+    const uint maxFps = parser.value(fpsOption).toUInt();
 
     try
     {
         std::unique_ptr<deflect::qt::QmlStreamer> streamer(
             new deflect::qt::QmlStreamer(qmlFile, streamHost.toStdString(),
                                          streamName.toStdString()));
+        streamer->setMaxFrameRate(maxFps);
         app.connect(streamer.get(), &deflect::qt::QmlStreamer::streamClosed,
                     &app, &QCoreApplication::quit);
         return app.exec();
@@ -0,0 +1,125 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include <deflect/server/Relay.h>
+#include <deflect/server/Server.h>
+#include <deflect/version.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationVersion(
+        QString::fromStdString(deflect::Version::getString()));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        "Merge the streams of many local sources (e.g. the ranks of a parallel "
+        "renderer, each sending a part of the frames) and forward them over a "
+        "single connection to the upstream host(s)");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption portOption("port",
+                                  "Port to listen on for the local sources "
+                                  "(default: 1702)",
+                                  "port", "1702");
+    parser.addOption(portOption);
+
+    QCommandLineOption unixSocketOption("unix-socket",
+                                        "Also listen on a unix socket path, "
+                                        "for sources using the host "
+                                        "'unix:<path>'",
+                                        "path");
+    parser.addOption(unixSocketOption);
+
+    parser.addPositionalArgument("upstream",
+                                 "Upstream host(s) to forward the streams "
+                                 "to, as host[:port]",
+                                 "upstream...");
+    parser.process(app);
+
+    const auto upstreams = parser.positionalArguments();
+    if (upstreams.isEmpty())
+    {
+        qWarning() << "No upstream host given";
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    const auto port = parser.value(portOption).toInt();
+    const auto unixSocketPath = parser.value(unixSocketOption);
+
+    try
+    {
+        std::unique_ptr<deflect::server::Server> server;
+        if (unixSocketPath.isEmpty())
+            server.reset(new deflect::server::Server(port));
+        else
+            server.reset(new deflect::server::Server(port, unixSocketPath));
+
+        // Owned by the server
+        auto relay = new deflect::server::Relay(*server, upstreams,
+                                                server.get());
+
+        app.connect(server.get(),
+                    &deflect::server::Server::pixelStreamException,
+                    [](const QString uri, const QString what) {
+                        qWarning() << "Stream" << uri << "error:" << what;
+                    });
+        app.connect(relay, &deflect::server::Relay::relayError,
+                    [](const QString uri, const QString upstream,
+                       const QString what) {
+                        qWarning() << "Could not forward stream" << uri
+                                   << "to" << upstream << ":" << what;
+                    });
+        return app.exec();
+    }
+    catch (const std::runtime_error& exception)
+    {
+        qWarning() << "StreamAggregator startup failed:" << exception.what();
+        return EXIT_FAILURE;
+    }
+}
@@ -40,9 +40,102 @@
 #include "Event.h"
 
 #include <QDataStream>
+#include <QtEndian>
+
+#include <cstring>
+#include <stdexcept>
 
 namespace deflect
 {
+namespace
+{
+enum CompactField : uint8_t
+{
+    FIELD_POSITION = 1 << 0,
+    FIELD_DELTA = 1 << 1,
+    FIELD_KEY = 1 << 2,
+    FIELD_MODIFIERS = 1 << 3,
+    FIELD_TEXT = 1 << 4,
+    FIELD_MOUSE_LEFT = 1 << 5,
+    FIELD_MOUSE_RIGHT = 1 << 6,
+    FIELD_MOUSE_MIDDLE = 1 << 7
+};
+
+uint8_t _getFields(const Event& event)
+{
+    uint8_t fields = 0;
+    if (event.mouseX != 0.0 || event.mouseY != 0.0)
+        fields |= FIELD_POSITION;
+    if (event.dx != 0.0 || event.dy != 0.0)
+        fields |= FIELD_DELTA;
+    if (event.key != 0)
+        fields |= FIELD_KEY;
+    if (event.modifiers != 0)
+        fields |= FIELD_MODIFIERS;
+    for (size_t i = 0; i < UNICODE_TEXT_SIZE; ++i)
+    {
+        if (event.text[i] != '\0')
+            fields |= FIELD_TEXT;
+    }
+    if (event.mouseLeft)
+        fields |= FIELD_MOUSE_LEFT;
+    if (event.mouseRight)
+        fields |= FIELD_MOUSE_RIGHT;
+    if (event.mouseMiddle)
+        fields |= FIELD_MOUSE_MIDDLE;
+    return fields;
+}
+
+template <typename T>
+void _append(QByteArray& data, const T value)
+{
+    const auto littleEndian = qToLittleEndian(value);
+    data.append(reinterpret_cast<const char*>(&littleEndian), sizeof(T));
+}
+
+void _append(QByteArray& data, const double value)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    _append(data, bits);
+}
+
+class CompactReader
+{
+public:
+    explicit CompactReader(const QByteArray& data)
+        : _data{data}
+    {
+    }
+
+    bool atEnd() const { return _pos == _data.size(); }
+
+    template <typename T>
+    T read()
+    {
+        if (_pos + int(sizeof(T)) > _data.size())
+            throw std::runtime_error("truncated event data");
+
+        T value;
+        std::memcpy(&value, _data.constData() + _pos, sizeof(T));
+        _pos += sizeof(T);
+        return qFromLittleEndian(value);
+    }
+
+    double readDouble()
+    {
+        const auto bits = read<quint64>();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+private:
+    const QByteArray& _data;
+    int _pos = 0;
+};
+}
+
 const uint32_t Event::serializedSize = 3 * sizeof(quint32) +
                                        4 * sizeof(double) + 3 * sizeof(bool) +
                                        UNICODE_TEXT_SIZE;
@@ -89,4 +182,72 @@ QDataStream& operator>>(QDataStream& in, deflect::Event& event)
 
     return in;
 }
+
+QByteArray serializeEvents(const std::vector<Event>& events)
+{
+    QByteArray data;
+    data.reserve(int(events.size()) * 22);
+
+    for (const auto& event : events)
+    {
+        const auto fields = _getFields(event);
+        _append(data, quint8(event.type));
+        _append(data, fields);
+
+        if (fields & FIELD_POSITION)
+        {
+            _append(data, event.mouseX);
+            _append(data, event.mouseY);
+        }
+        if (fields & FIELD_DELTA)
+        {
+            _append(data, event.dx);
+            _append(data, event.dy);
+        }
+        if (fields & FIELD_KEY)
+            _append(data, qint32(event.key));
+        if (fields & FIELD_MODIFIERS)
+            _append(data, qint32(event.modifiers));
+        if (fields & FIELD_TEXT)
+            data.append(event.text, UNICODE_TEXT_SIZE);
+    }
+    return data;
+}
+
+std::vector<Event> deserializeEvents(const QByteArray& data)
+{
+    std::vector<Event> events;
+
+    CompactReader reader{data};
+    while (!reader.atEnd())
+    {
+        Event event;
+        event.type = (Event::EventType)reader.read<quint8>();
+        const auto fields = reader.read<quint8>();
+
+        if (fields & FIELD_POSITION)
+        {
+            event.mouseX = reader.readDouble();
+            event.mouseY = reader.readDouble();
+        }
+        if (fields & FIELD_DELTA)
+        {
+            event.dx = reader.readDouble();
+            event.dy = reader.readDouble();
+        }
+        if (fields & FIELD_KEY)
+            event.key = reader.read<qint32>();
+        if (fields & FIELD_MODIFIERS)
+            event.modifiers = reader.read<qint32>();
+        for (size_t i = 0; i < UNICODE_TEXT_SIZE; ++i)
+            event.text[i] = (fields & FIELD_TEXT) ? char(reader.read<quint8>())
+                                                  : '\0';
+        event.mouseLeft = fields & FIELD_MOUSE_LEFT;
+        event.mouseRight = fields & FIELD_MOUSE_RIGHT;
+        event.mouseMiddle = fields & FIELD_MOUSE_MIDDLE;
+
+        events.push_back(event);
+    }
+    return events;
+}
 }
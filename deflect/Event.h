@@ -47,8 +47,11 @@
 #include <deflect/api.h>
 #include <deflect/types.h>
 
+#include <vector>
+
 #define UNICODE_TEXT_SIZE 4
 
+class QByteArray;
 class QDataStream;
 
 namespace deflect
@@ -178,6 +181,22 @@ struct Event
  */
 DEFLECT_API QDataStream& operator<<(QDataStream& out, const Event& event);
 DEFLECT_API QDataStream& operator>>(QDataStream& in, Event& event);
+
+/**
+ * Compact serialization of multiple Events for sending them in a single
+ * network message.
+ *
+ * Only the fields which are set are serialized, without loss of precision.
+ * A typical touch or mouse move event takes 22 bytes instead of
+ * Event::serializedSize.
+ */
+DEFLECT_API QByteArray serializeEvents(const std::vector<Event>& events);
+
+/**
+ * Deserialize Events written by serializeEvents().
+ * @throw std::runtime_error if the data is corrupted.
+ */
+DEFLECT_API std::vector<Event> deserializeEvents(const QByteArray& data);
 }
 
 #endif
@@ -48,22 +48,134 @@
 #include <QThreadStorage>
 #include <QtConcurrentMap>
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 namespace deflect
 {
+namespace
+{
+// Classification of the segments for ImageWrapper::contentAdaptiveCompression,
+// which only raises the JPEG quality of the sharp ones.
+const int CLASSIFIER_SAMPLING_STEP = 2;
+const int FLAT_GRADIENT = 6; // on the sum of the RGB components
+const int SHARP_GRADIENT = 192;
+const double SHARP_CONTENT_MIN_FLAT_RATIO = 0.5;
+const double SHARP_CONTENT_MIN_EDGE_RATIO = 0.02;
+const unsigned int SHARP_CONTENT_MIN_QUALITY = 90;
+
+const char* _getPixel(const ImageWrapper& image, const QRect& region,
+                      const int row)
+{
+    const auto bytesPerPixel = image.getBytesPerPixel();
+    const auto pitch = image.width * bytesPerPixel;
+    return reinterpret_cast<const char*>(image.data) +
+           (region.y() + row) * pitch + region.x() * bytesPerPixel;
+}
+
+// Relies on memcmp, which is vectorized by the standard library.
+bool _isUniform(const ImageWrapper& image, const QRect& region)
+{
+    const auto bytesPerPixel = image.getBytesPerPixel();
+    const auto rowSize = size_t(region.width()) * bytesPerPixel;
+
+    // a row is uniform if it is equal to itself shifted by one pixel
+    const auto firstRow = _getPixel(image, region, 0);
+    if (std::memcmp(firstRow, firstRow + bytesPerPixel,
+                    rowSize - bytesPerPixel) != 0)
+    {
+        return false;
+    }
+    for (int row = 1; row < region.height(); ++row)
+    {
+        if (std::memcmp(_getPixel(image, region, row), firstRow, rowSize) != 0)
+            return false;
+    }
+    return true;
+}
+
+int _getIntensity(const char* pixel, const PixelFormat format)
+{
+    const auto rgb = reinterpret_cast<const uint8_t*>(pixel) +
+                     (format == ARGB || format == ABGR ? 1 : 0);
+    return int(rgb[0]) + rgb[1] + rgb[2];
+}
+
+// Text and user interfaces are mostly flat areas separated by sharp edges,
+// unlike natural images made of smooth gradients. The horizontal gradients of
+// a subset of the pixels are enough to tell them apart.
+bool _hasSharpContent(const ImageWrapper& image, const QRect& region)
+{
+    const auto bytesPerPixel = int(image.getBytesPerPixel());
+    size_t samples = 0;
+    size_t flat = 0;
+    size_t edges = 0;
+    for (int row = 0; row < region.height(); row += CLASSIFIER_SAMPLING_STEP)
+    {
+        const auto pixels = _getPixel(image, region, row);
+        for (int x = 1; x < region.width(); x += CLASSIFIER_SAMPLING_STEP)
+        {
+            const auto pixel = pixels + x * bytesPerPixel;
+            const auto gradient =
+                std::abs(_getIntensity(pixel, image.pixelFormat) -
+                         _getIntensity(pixel - bytesPerPixel,
+                                       image.pixelFormat));
+            if (gradient <= FLAT_GRADIENT)
+                ++flat;
+            else if (gradient >= SHARP_GRADIENT)
+                ++edges;
+            ++samples;
+        }
+    }
+    return samples > 0 && flat >= SHARP_CONTENT_MIN_FLAT_RATIO * samples &&
+           edges >= SHARP_CONTENT_MIN_EDGE_RATIO * samples;
+}
+
+QByteArray _makeSolidData(const ImageWrapper& image, const QRect& region)
+{
+    const auto pixel = _getPixel(image, region, 0);
+    char rgb[3];
+    switch (image.pixelFormat)
+    {
+    case RGB:
+    case RGBA:
+        rgb[0] = pixel[0], rgb[1] = pixel[1], rgb[2] = pixel[2];
+        break;
+    case ARGB:
+        rgb[0] = pixel[1], rgb[1] = pixel[2], rgb[2] = pixel[3];
+        break;
+    case BGR:
+    case BGRA:
+        rgb[0] = pixel[2], rgb[1] = pixel[1], rgb[2] = pixel[0];
+        break;
+    case ABGR:
+        rgb[0] = pixel[3], rgb[1] = pixel[2], rgb[2] = pixel[1];
+        break;
+    default:
+        throw std::invalid_argument("unknown pixel format");
+    }
+
+    QByteArray data(rgb, 3);
+    data.append(char(image.subsampling));
+    return data;
+}
+}
+
 bool ImageSegmenter::_isOnRightSideOfSideBySideImage(const SegmentTask& segment)
 {
     return segment.sourceImage->view == View::side_by_side &&
            segment.view == View::right_eye;
 }
 
-bool ImageSegmenter::generate(const ImageWrapper& image, Handler handler)
+bool ImageSegmenter::generate(const ImageWrapper& image, Handler handler,
+                              Filter filter)
 {
     if (image.compressionPolicy == COMPRESSION_ON)
-        return _generateJpeg(image, handler);
-    return _generateRaw(image, handler);
+        return _generateJpeg(image, handler, filter);
+    return _generateRaw(image, handler, filter);
 }
 
 Segment ImageSegmenter::createSingleSegment(const ImageWrapper& image)
@@ -106,12 +218,17 @@ void ImageSegmenter::setNominalSegmentDimensions(const uint width,
     _nominalSegmentHeight = height;
 }
 
+void ImageSegmenter::setSolidSegmentsEnabled(const bool enabled)
+{
+    _solidSegmentsEnabled = enabled;
+}
+
 bool ImageSegmenter::_generateJpeg(const ImageWrapper& image,
-                                   const Handler& handler)
+                                   const Handler& handler, const Filter& filter)
 {
 #ifdef DEFLECT_USE_LIBJPEGTURBO
     // The resulting Jpeg segments
-    auto segments = _generateSegmentTasks(image);
+    auto segments = _generateSegmentTasks(image, filter);
 
     // start creating JPEGs for each segment, in parallel
     QtConcurrent::map(segments, std::bind(&ImageSegmenter::_computeJpeg, this,
@@ -164,27 +281,46 @@ void ImageSegmenter::_computeJpeg(SegmentTask& segment, const bool sendSegment)
     // turbojpeg handles need to be per thread, and this function is called from
     // multiple threads by QtConcurrent::map
     static QThreadStorage<ImageJpegCompressor> compressor;
+    segment.parameters.format = Format::jpeg;
     try
     {
-        segment.imageData =
-            compressor.localData().computeJpeg(*segment.sourceImage,
-                                               imageRegion);
+        const auto& image = *segment.sourceImage;
+        if (_solidSegmentsEnabled && image.data &&
+            _isUniform(image, imageRegion))
+        {
+            segment.imageData = _makeSolidData(image, imageRegion);
+            segment.parameters.format = Format::solid;
+        }
+        else if (image.contentAdaptiveCompression && image.data &&
+                 _hasSharpContent(image, imageRegion))
+        {
+            auto sharpImage = image;
+            sharpImage.compressionQuality =
+                std::max(image.compressionQuality, SHARP_CONTENT_MIN_QUALITY);
+            segment.imageData =
+                compressor.localData().computeJpeg(sharpImage, imageRegion);
+        }
+        else
+        {
+            segment.imageData =
+                compressor.localData().computeJpeg(image, imageRegion);
+        }
     }
     catch (...)
     {
         segment.exception = std::current_exception();
     }
 
-    segment.parameters.format = Format::jpeg;
     if (sendSegment)
         _sendQueue.enqueue(segment);
 #endif
 }
 
 bool ImageSegmenter::_generateRaw(const ImageWrapper& image,
-                                  const Handler& handler) const
+                                  const Handler& handler,
+                                  const Filter& filter) const
 {
-    auto segments = _generateSegmentTasks(image);
+    auto segments = _generateSegmentTasks(image, filter);
     for (auto& segment : segments)
     {
         segment.imageData.reserve(segment.parameters.width *
@@ -192,7 +328,8 @@ bool ImageSegmenter::_generateRaw(const ImageWrapper& image,
                                   image.getBytesPerPixel());
         segment.parameters.format = Format::rgba;
 
-        if (segments.size() == 1)
+        if (segment.parameters.width == image.width &&
+            segment.parameters.height == image.height)
         {
             // If we are not segmenting the image, just append the image data
             segment.imageData.append((const char*)image.data,
@@ -203,8 +340,8 @@ bool ImageSegmenter::_generateRaw(const ImageWrapper& image,
             // assume imageBuffer isn't padded
             const auto bytesPerPixel = image.getBytesPerPixel();
             const size_t imagePitch = image.width * bytesPerPixel;
-            size_t offset = segment.parameters.y * imagePitch +
-                            segment.parameters.x * bytesPerPixel;
+            size_t offset = (segment.parameters.y - image.y) * imagePitch +
+                            (segment.parameters.x - image.x) * bytesPerPixel;
 
             if (_isOnRightSideOfSideBySideImage(segment))
                 offset += segment.sourceImage->width / 2 * bytesPerPixel;
@@ -227,11 +364,14 @@ bool ImageSegmenter::_generateRaw(const ImageWrapper& image,
 }
 
 ImageSegmenter::SegmentTasks ImageSegmenter::_generateSegmentTasks(
-    const ImageWrapper& image) const
+    const ImageWrapper& image, const Filter& filter) const
 {
     SegmentTasks segments;
     for (const auto& params : _makeSegmentParameters(image))
     {
+        if (filter && !filter(params))
+            continue;
+
         SegmentTask segment;
         segment.parameters = params;
         segment.view =
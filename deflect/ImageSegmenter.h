@@ -47,6 +47,7 @@
 #include <deflect/MTQueue.h>
 #include <deflect/Segment.h>
 
+#include <atomic>
 #include <functional>
 
 namespace deflect
@@ -63,6 +64,9 @@ public:
     /** Function called on each segment. */
     using Handler = std::function<bool(const Segment&)>;
 
+    /** Function deciding if a segment should be generated. */
+    using Filter = std::function<bool(const SegmentParameters&)>;
+
     /**
      * Generate segments.
      *
@@ -72,12 +76,15 @@ public:
      *
      * @param image The image to be segmented.
      * @param handler the function to handle the generated segment.
+     * @param filter optional function to skip some of the segments, which are
+     *        then neither compressed nor handled.
      * @return true if all image handlers returned true, false on failure.
      * @throw std::runtime_error if JPEG compression failed.
      * @throw std::invalid_argument if JPEG compression arguments are invalid.
      * @see setNominalSegmentDimensions()
      */
-    DEFLECT_API bool generate(const ImageWrapper& image, Handler handler);
+    DEFLECT_API bool generate(const ImageWrapper& image, Handler handler,
+                              Filter filter = Filter());
 
     /**
      * Set the nominal segment dimensions.
@@ -92,6 +99,17 @@ public:
      */
     DEFLECT_API void setNominalSegmentDimensions(uint width, uint height);
 
+    /**
+     * Detect the segments of a single color when JPEG compressing images.
+     *
+     * Such segments are sent in Format::solid instead of being compressed,
+     * which must be supported by the receiver.
+     *
+     * @param enabled true to detect the uniform segments (default: false).
+     * @threadsafe
+     */
+    DEFLECT_API void setSolidSegmentsEnabled(bool enabled);
+
     /**
      * For a small input image (tested with 64x64, possible for <=512 as well),
      * directly compress it to a single segment which will be enqueued for
@@ -129,12 +147,15 @@ private:
     };
     static bool _isOnRightSideOfSideBySideImage(const SegmentTask& segment);
 
-    bool _generateJpeg(const ImageWrapper& image, const Handler& handler);
+    bool _generateJpeg(const ImageWrapper& image, const Handler& handler,
+                       const Filter& filter);
     void _computeJpeg(SegmentTask& segment, bool sendSegment);
-    bool _generateRaw(const ImageWrapper& image, const Handler& handler) const;
+    bool _generateRaw(const ImageWrapper& image, const Handler& handler,
+                      const Filter& filter) const;
 
     using SegmentTasks = std::vector<SegmentTask>;
-    SegmentTasks _generateSegmentTasks(const ImageWrapper& image) const;
+    SegmentTasks _generateSegmentTasks(const ImageWrapper& image,
+                                       const Filter& filter = Filter()) const;
 
     using SegmentParametersList = std::vector<SegmentParameters>;
     SegmentParametersList _makeSegmentParameters(
@@ -143,6 +164,7 @@ private:
 
     uint _nominalSegmentWidth = 0;
     uint _nominalSegmentHeight = 0;
+    std::atomic_bool _solidSegmentsEnabled{false};
 
     MTQueue<SegmentTask> _sendQueue;
 };
@@ -58,6 +58,7 @@ ImageWrapper::ImageWrapper(const void* data_, const unsigned int width_,
     , compressionPolicy(COMPRESSION_AUTO)
     , compressionQuality(DEFAULT_COMPRESSION_QUALITY)
     , subsampling(ChromaSubsampling::YUV444)
+    , contentAdaptiveCompression(false)
 {
 }
 
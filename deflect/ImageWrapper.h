@@ -129,6 +129,20 @@ struct ImageWrapper
                                               @version 1.0 */
     ChromaSubsampling subsampling;       /**< Chrominance sub-sampling.
                                               (default: YUV444). @version 1.0 */
+
+    /**
+     * Adapt the JPEG quality to the content of each segment.
+     *
+     * The compressionQuality then only applies to the segments of smooth
+     * imagery, while the segments of sharp-edged content such as text or user
+     * interfaces are compressed with a quality of at least 90. Only the
+     * quality is adapted: all segments are JPEG compressed with the image's
+     * chrominance sub-sampling, which the receivers expect to be uniform
+     * within a frame; use YUV444 to preserve colored text.
+     * (default: false)
+     * @version 1.1
+     */
+    bool contentAdaptiveCompression;
     //@}
 
     /**
@@ -70,7 +70,17 @@ enum MessageType
     MESSAGE_TYPE_IMAGE_VIEW = 15,
     MESSAGE_TYPE_OBSERVER_OPEN = 16,
     MESSAGE_TYPE_IMAGE_ROW_ORDER = 17,
-    MESSAGE_TYPE_IMAGE_CHANNEL = 18
+    MESSAGE_TYPE_IMAGE_CHANNEL = 18,
+    MESSAGE_TYPE_SHARED_MEMORY_OPEN = 19,
+    MESSAGE_TYPE_SHARED_MEMORY_REPLY = 20,
+    MESSAGE_TYPE_PIXELSTREAM_SHARED_MEMORY = 21,
+    MESSAGE_TYPE_EVENTS = 22,
+    MESSAGE_TYPE_PIXELSTREAM_FINISH_PARTIAL_FRAME = 23,
+    MESSAGE_TYPE_VISIBILITY = 24,
+    MESSAGE_TYPE_MULTICAST_OPEN = 25,
+    MESSAGE_TYPE_MULTICAST_REPLY = 26,
+    MESSAGE_TYPE_REQUEST_FULL_FRAME = 27,
+    MESSAGE_TYPE_TILE_FORMATS = 28
 };
 
 #define MESSAGE_HEADER_URI_LENGTH 64
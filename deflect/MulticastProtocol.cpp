@@ -0,0 +1,350 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "MulticastProtocol.h"
+
+#include <QDataStream>
+
+#include <algorithm>
+#include <cstring>
+
+namespace deflect
+{
+namespace
+{
+const uint32_t DATAGRAM_MAGIC = 0xDEF1EC70;
+
+// Keep the datagrams below the usual ethernet MTU to avoid IP fragmentation
+const int MAX_DATAGRAM_PAYLOAD = 1400;
+
+const size_t MAX_NACK_RANGES = MAX_DATAGRAM_PAYLOAD / sizeof(SequenceRange);
+const size_t MAX_REPAIRS_PER_NACK = 1024;
+const size_t MAX_PENDING_FRAGMENTS = 65536;
+const std::chrono::milliseconds NACK_INTERVAL{20};
+const unsigned int MAX_NACKS_PER_GAP = 5;
+
+QByteArray _makeDatagram(const DatagramHeader& header, const char* data,
+                         const int size)
+{
+    QByteArray datagram(int(sizeof(DatagramHeader)) + size, Qt::Uninitialized);
+    std::memcpy(datagram.data(), &header, sizeof(DatagramHeader));
+    if (size > 0)
+        std::memcpy(datagram.data() + sizeof(DatagramHeader), data, size);
+    return datagram;
+}
+
+QByteArray _serialize(const MessageHeader& header, const QByteArray& payload)
+{
+    QByteArray message;
+    message.reserve(int(MessageHeader::serializedSize) + payload.size());
+    {
+        QDataStream stream(&message, QIODevice::WriteOnly);
+        stream << header;
+    }
+    message.append(payload);
+    return message;
+}
+}
+
+bool parseDatagram(const QByteArray& datagram, DatagramHeader& header,
+                   QByteArray& payload)
+{
+    if (size_t(datagram.size()) < sizeof(DatagramHeader))
+        return false;
+
+    std::memcpy(&header, datagram.constData(), sizeof(DatagramHeader));
+    if (header.magic != DATAGRAM_MAGIC ||
+        header.type > DatagramType::fullFrame)
+        return false;
+
+    payload = datagram.mid(int(sizeof(DatagramHeader)));
+    return true;
+}
+
+QByteArray makeNack(const uint32_t session,
+                    const std::vector<SequenceRange>& ranges)
+{
+    DatagramHeader header;
+    header.magic = DATAGRAM_MAGIC;
+    header.session = session;
+    header.type = DatagramType::nack;
+
+    const auto count = std::min(ranges.size(), MAX_NACK_RANGES);
+    return _makeDatagram(header, reinterpret_cast<const char*>(ranges.data()),
+                         int(count * sizeof(SequenceRange)));
+}
+
+std::vector<SequenceRange> parseNack(const QByteArray& payload)
+{
+    const auto count = size_t(payload.size()) / sizeof(SequenceRange);
+    std::vector<SequenceRange> ranges(std::min(count, MAX_NACK_RANGES));
+    if (!ranges.empty())
+        std::memcpy(ranges.data(), payload.constData(),
+                    ranges.size() * sizeof(SequenceRange));
+    return ranges;
+}
+
+QByteArray makeFullFrameRequest(const uint32_t session)
+{
+    DatagramHeader header;
+    header.magic = DATAGRAM_MAGIC;
+    header.session = session;
+    header.type = DatagramType::fullFrame;
+    return _makeDatagram(header, nullptr, 0);
+}
+
+DatagramHistory::DatagramHistory(const uint32_t session,
+                                 const uint16_t repairPort,
+                                 const size_t capacity)
+    : _session{session}
+    , _repairPort{repairPort}
+    , _capacity{capacity}
+{
+}
+
+std::vector<QByteArray> DatagramHistory::add(const MessageHeader& header,
+                                             const QByteArray& payload)
+{
+    const auto message = _serialize(header, payload);
+
+    DatagramHeader datagramHeader;
+    datagramHeader.magic = DATAGRAM_MAGIC;
+    datagramHeader.session = _session;
+    datagramHeader.type = DatagramType::data;
+    datagramHeader.repairPort = _repairPort;
+
+    std::vector<QByteArray> datagrams;
+    for (int offset = 0; offset < message.size();
+         offset += MAX_DATAGRAM_PAYLOAD)
+    {
+        const auto size = std::min(MAX_DATAGRAM_PAYLOAD,
+                                   message.size() - offset);
+        datagramHeader.sequence = getNextSequence();
+        datagramHeader.flags = 0u;
+        if (offset == 0)
+            datagramHeader.flags |= DATAGRAM_FIRST_FRAGMENT;
+        if (offset + size == message.size())
+            datagramHeader.flags |= DATAGRAM_LAST_FRAGMENT;
+
+        datagrams.emplace_back(_makeDatagram(datagramHeader,
+                                             message.constData() + offset,
+                                             size));
+        _datagrams.push_back(datagrams.back());
+        if (_datagrams.size() > _capacity)
+        {
+            _datagrams.pop_front();
+            ++_firstSequence;
+        }
+    }
+    return datagrams;
+}
+
+std::vector<QByteArray> DatagramHistory::getRepairs(
+    const std::vector<SequenceRange>& ranges) const
+{
+    std::vector<QByteArray> repairs;
+    for (const auto& range : ranges)
+    {
+        const auto begin = std::max(range.first, _firstSequence);
+        const auto end = std::min(range.first + range.count, getNextSequence());
+        for (auto sequence = begin; sequence < end; ++sequence)
+        {
+            if (repairs.size() == MAX_REPAIRS_PER_NACK)
+                return repairs;
+            repairs.push_back(_datagrams[sequence - _firstSequence]);
+        }
+    }
+    return repairs;
+}
+
+QByteArray DatagramHistory::makeHeartbeat() const
+{
+    DatagramHeader header;
+    header.magic = DATAGRAM_MAGIC;
+    header.session = _session;
+    header.sequence = getNextSequence();
+    header.type = DatagramType::heartbeat;
+    header.repairPort = _repairPort;
+    return _makeDatagram(header, nullptr, 0);
+}
+
+uint64_t DatagramHistory::getNextSequence() const
+{
+    return _firstSequence + _datagrams.size();
+}
+
+void DatagramAssembler::add(const DatagramHeader& header,
+                            const QByteArray& payload,
+                            const Clock::time_point now)
+{
+    if (!_started)
+    {
+        _started = true;
+        _next = header.sequence;
+        _end = header.sequence;
+        _lastNack = now;
+    }
+
+    if (header.type == DatagramType::heartbeat)
+    {
+        _end = std::max(_end, header.sequence);
+        return;
+    }
+
+    if (header.type != DatagramType::data || header.sequence < _next)
+        return; // duplicate, or repair of a skipped gap
+
+    _fragments.emplace(header.sequence, Fragment{header.flags, payload});
+    _end = std::max(_end, header.sequence + 1);
+
+    // Waiting for the gap does not scale if the sender is much faster
+    if (_fragments.size() > MAX_PENDING_FRAGMENTS)
+        _skipGap();
+    else
+        _assemble();
+}
+
+bool DatagramAssembler::takeMessage(MessageHeader& header, QByteArray& payload)
+{
+    if (_messages.empty())
+        return false;
+
+    header = _messages.front().first;
+    payload = std::move(_messages.front().second);
+    _messages.pop_front();
+    return true;
+}
+
+std::vector<SequenceRange> DatagramAssembler::getNack(
+    const Clock::time_point now)
+{
+    if (_next >= _end)
+    {
+        _nackCount = 0;
+        return {};
+    }
+
+    if (now - _lastNack < NACK_INTERVAL)
+        return {};
+
+    if (_nackCount > 0 && _nackedSequence == _next)
+    {
+        if (_nackCount == MAX_NACKS_PER_GAP)
+        {
+            _skipGap();
+            return {};
+        }
+    }
+    else
+        _nackCount = 0;
+
+    _nackedSequence = _next;
+    ++_nackCount;
+    _lastNack = now;
+
+    std::vector<SequenceRange> ranges;
+    auto expected = _next;
+    for (const auto& fragment : _fragments)
+    {
+        if (ranges.size() == MAX_NACK_RANGES)
+            return ranges;
+        if (fragment.first > expected)
+            ranges.push_back({expected, fragment.first - expected});
+        expected = fragment.first + 1;
+    }
+    if (expected < _end && ranges.size() < MAX_NACK_RANGES)
+        ranges.push_back({expected, _end - expected});
+    return ranges;
+}
+
+void DatagramAssembler::_assemble()
+{
+    for (auto it = _fragments.begin();
+         it != _fragments.end() && it->first == _next;
+         it = _fragments.erase(it), ++_next)
+    {
+        auto& fragment = it->second;
+        if (fragment.flags & DATAGRAM_FIRST_FRAGMENT)
+        {
+            _message.clear();
+            _assembling = true;
+        }
+
+        // the start of the message was skipped or received before joining
+        if (!_assembling)
+            continue;
+
+        _message.append(fragment.data);
+        if (fragment.flags & DATAGRAM_LAST_FRAGMENT)
+        {
+            _assembling = false;
+            _completeMessage();
+        }
+    }
+}
+
+void DatagramAssembler::_completeMessage()
+{
+    if (size_t(_message.size()) < MessageHeader::serializedSize)
+        return;
+
+    MessageHeader header;
+    {
+        QDataStream stream(_message);
+        stream >> header;
+    }
+    auto payload = _message.mid(int(MessageHeader::serializedSize));
+    _message.clear();
+
+    if (payload.size() == int(header.size))
+        _messages.emplace_back(header, std::move(payload));
+}
+
+void DatagramAssembler::_skipGap()
+{
+    const auto resume = _fragments.empty() ? _end : _fragments.begin()->first;
+    _lostCount += resume - _next;
+    _next = resume;
+    _nackCount = 0;
+
+    _message.clear();
+    _assembling = false;
+    _assemble();
+}
+}
@@ -0,0 +1,216 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_MULTICASTPROTOCOL_H
+#define DEFLECT_MULTICASTPROTOCOL_H
+
+#include <deflect/MessageHeader.h>
+#include <deflect/api.h>
+
+#include <QByteArray>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace deflect
+{
+/** The types of datagram exchanged on a multicast stream. */
+enum class DatagramType : uint16_t
+{
+    data,      //!< Fragment of a message, sent to the group
+    heartbeat, //!< Next sequence number of the sender, sent to the group
+    nack,      //!< Sequences missed by a receiver, sent back to the sender
+    fullFrame  //!< Request of a receiver which lost a frame, sent back too
+};
+
+/** @name Flags of the data datagrams */
+//@{
+const uint16_t DATAGRAM_FIRST_FRAGMENT = 1u << 0;
+const uint16_t DATAGRAM_LAST_FRAGMENT = 1u << 1;
+//@}
+
+/** Header of the datagrams of a multicast stream. */
+struct DatagramHeader
+{
+    uint32_t magic = 0u;   //!< Identifies deflect datagrams
+    uint32_t session = 0u; //!< Random identifier of the sending Stream
+    uint64_t sequence = 0u; //!< Of a data datagram, the next one for heartbeat
+    DatagramType type = DatagramType::data;
+    uint16_t flags = 0u;      //!< Position of a data fragment in its message
+    uint16_t repairPort = 0u; //!< UDP port on which the sender accepts nacks
+    uint16_t reserved = 0u;
+};
+
+/** A range of missing sequence numbers. */
+struct SequenceRange
+{
+    uint64_t first = 0u;
+    uint64_t count = 0u;
+};
+
+/**
+ * Split a datagram into its header and payload.
+ *
+ * @return false if the datagram does not belong to the deflect protocol.
+ */
+DEFLECT_API bool parseDatagram(const QByteArray& datagram,
+                               DatagramHeader& header, QByteArray& payload);
+
+/** @return a nack datagram requesting ranges of a session to be sent again. */
+DEFLECT_API QByteArray makeNack(uint32_t session,
+                                const std::vector<SequenceRange>& ranges);
+
+/** @return the ranges requested by the payload of a nack datagram. */
+DEFLECT_API std::vector<SequenceRange> parseNack(const QByteArray& payload);
+
+/** @return a datagram requesting the next frame of a session to be full. */
+DEFLECT_API QByteArray makeFullFrameRequest(uint32_t session);
+
+/**
+ * Split the messages of a Stream into sequenced datagrams for a multicast
+ * group, keeping the latest ones to repair the losses reported by receivers.
+ *
+ * Not thread-safe.
+ */
+class DatagramHistory
+{
+public:
+    /**
+     * Create a history for a new session.
+     *
+     * @param session random identifier of the sending Stream.
+     * @param repairPort the port on which the sender accepts nacks.
+     * @param capacity the number of datagrams kept for repairs.
+     */
+    DEFLECT_API DatagramHistory(uint32_t session, uint16_t repairPort,
+                                size_t capacity);
+
+    /** @return the datagrams of a message, which are kept for repairs. */
+    DEFLECT_API std::vector<QByteArray> add(const MessageHeader& header,
+                                            const QByteArray& payload);
+
+    /** @return the datagrams of the ranges of a nack which are still kept. */
+    DEFLECT_API std::vector<QByteArray> getRepairs(
+        const std::vector<SequenceRange>& ranges) const;
+
+    /** @return a heartbeat announcing the next sequence number. */
+    DEFLECT_API QByteArray makeHeartbeat() const;
+
+    /** @return the sequence number of the next datagram. */
+    DEFLECT_API uint64_t getNextSequence() const;
+
+private:
+    const uint32_t _session;
+    const uint16_t _repairPort;
+    const size_t _capacity;
+
+    std::deque<QByteArray> _datagrams;
+    uint64_t _firstSequence = 0u;
+};
+
+/**
+ * Reassemble the messages of one sender from its datagrams, delivering them
+ * in order and reporting the missing datagrams.
+ *
+ * Reassembly starts at the first datagram received, so receivers can join a
+ * session at any time. Missing datagrams are requested again at regular
+ * intervals; a gap which is still not repaired after a few requests (e.g. the
+ * sender no longer has it) is skipped along with the messages it belongs to.
+ *
+ * Not thread-safe.
+ */
+class DatagramAssembler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /** Add a data or heartbeat datagram of the session. */
+    DEFLECT_API void add(const DatagramHeader& header,
+                         const QByteArray& payload, Clock::time_point now);
+
+    /**
+     * Take the next complete message.
+     *
+     * @return false if no message is complete.
+     */
+    DEFLECT_API bool takeMessage(MessageHeader& header, QByteArray& payload);
+
+    /**
+     * Get the missing ranges to request from the sender.
+     *
+     * @return the ranges to request, empty if none are missing or no request
+     *         is due yet.
+     */
+    DEFLECT_API std::vector<SequenceRange> getNack(Clock::time_point now);
+
+    /** @return the number of datagrams skipped because they were lost. */
+    uint64_t getLostCount() const { return _lostCount; }
+
+private:
+    struct Fragment
+    {
+        uint16_t flags;
+        QByteArray data;
+    };
+
+    bool _started = false;
+    uint64_t _next = 0u; // next sequence to assemble
+    uint64_t _end = 0u;  // one past the last sequence known to be sent
+    std::map<uint64_t, Fragment> _fragments;
+
+    QByteArray _message;
+    bool _assembling = false;
+    std::deque<std::pair<MessageHeader, QByteArray>> _messages;
+
+    Clock::time_point _lastNack;
+    uint64_t _nackedSequence = 0u;
+    unsigned int _nackCount = 0u;
+    uint64_t _lostCount = 0u;
+
+    void _assemble();
+    void _completeMessage();
+    void _skipGap();
+};
+}
+
+#endif
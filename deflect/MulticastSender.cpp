@@ -0,0 +1,254 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "MulticastSender.h"
+
+#include <QThread>
+#include <QUdpSocket>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+namespace deflect
+{
+namespace
+{
+const size_t HISTORY_SIZE = 16384; // ~22 MB, a few frames of 4K JPEG
+const std::chrono::milliseconds HEARTBEAT_INTERVAL{50};
+const int MAX_WRITE_ATTEMPTS = 10;
+const int SEND_BUFFER_SIZE = 4 * 1024 * 1024;
+
+class FunctionThread : public QThread
+{
+public:
+    explicit FunctionThread(std::function<void()> function)
+        : _function{std::move(function)}
+    {
+    }
+
+private:
+    std::function<void()> _function;
+
+    void run() final { _function(); }
+};
+
+uint32_t _makeSessionId()
+{
+    std::random_device device;
+    return device();
+}
+
+bool _bind(QUdpSocket& socket, const QHostAddress& group)
+{
+    const auto ipv6 = group.protocol() == QAbstractSocket::IPv6Protocol;
+    if (!socket.bind(ipv6 ? QHostAddress::AnyIPv6 : QHostAddress::AnyIPv4, 0))
+        return false;
+
+    // Restrict the group to the local network, which includes this machine
+    socket.setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+    socket.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+    socket.setSocketOption(QAbstractSocket::SendBufferSizeSocketOption,
+                           SEND_BUFFER_SIZE);
+    return true;
+}
+
+bool _write(QUdpSocket& socket, const QByteArray& datagram,
+            const QHostAddress& address, const quint16 port)
+{
+    for (int attempt = 0; attempt < MAX_WRITE_ATTEMPTS; ++attempt)
+    {
+        if (socket.writeDatagram(datagram, address, port) == datagram.size())
+            return true;
+
+        // Most likely the send buffer is full, give the network some time
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+}
+
+MulticastSender::MulticastSender(
+    const QHostAddress& group, const quint16 port,
+    const FullFrameRequestHandler& onFullFrameRequest)
+    : _group{group}
+    , _port{port}
+    , _session{_makeSessionId()}
+    , _onFullFrameRequest{onFullFrameRequest}
+{
+    if (!_group.isMulticast())
+    {
+        throw std::runtime_error("not a multicast address: " +
+                                 _group.toString().toStdString());
+    }
+
+    std::promise<quint16> repairPort;
+    auto future = repairPort.get_future();
+    _repairThread.reset(
+        new FunctionThread([this, &repairPort]() { _runRepairs(repairPort); }));
+    _repairThread->start();
+    try
+    {
+        const auto boundPort = future.get();
+        std::lock_guard<std::mutex> lock(_historyMutex);
+        _history.reset(new DatagramHistory(_session, boundPort, HISTORY_SIZE));
+    }
+    catch (...)
+    {
+        _running = false;
+        _repairThread->wait();
+        throw;
+    }
+}
+
+MulticastSender::~MulticastSender()
+{
+    _running = false;
+    _repairThread->wait();
+}
+
+bool MulticastSender::send(const MessageHeader& header,
+                           const QByteArray& payload)
+{
+    if (!_socket && !_openSocket())
+        return false;
+
+    std::vector<QByteArray> datagrams;
+    {
+        std::lock_guard<std::mutex> lock(_historyMutex);
+        datagrams = _history->add(header, payload);
+    }
+
+    // Lost datagrams are repaired on request of the receivers, but a failure
+    // to send is not going to get better
+    for (const auto& datagram : datagrams)
+    {
+        if (!_write(*_socket, datagram, _group, _port))
+            return false;
+    }
+    return true;
+}
+
+bool MulticastSender::_openSocket()
+{
+    std::unique_ptr<QUdpSocket> socket(new QUdpSocket);
+    if (!_bind(*socket, _group))
+        return false;
+    _socket = std::move(socket);
+    return true;
+}
+
+void MulticastSender::_runRepairs(std::promise<quint16>& repairPort)
+{
+    QUdpSocket socket;
+    if (!_bind(socket, _group))
+    {
+        repairPort.set_exception(std::make_exception_ptr(std::runtime_error(
+            "could not bind the multicast repair socket: " +
+            socket.errorString().toStdString())));
+        return;
+    }
+    repairPort.set_value(socket.localPort());
+
+    using Clock = std::chrono::steady_clock;
+    auto nextHeartbeat = Clock::now();
+    while (_running)
+    {
+        const auto timeout = std::chrono::duration_cast<
+            std::chrono::milliseconds>(nextHeartbeat - Clock::now());
+        if (socket.waitForReadyRead(std::max(0, int(timeout.count()))))
+            _answerReceivers(socket);
+
+        if (Clock::now() < nextHeartbeat)
+            continue;
+
+        QByteArray heartbeat;
+        {
+            std::lock_guard<std::mutex> lock(_historyMutex);
+            if (_history)
+                heartbeat = _history->makeHeartbeat();
+        }
+        if (!heartbeat.isEmpty())
+            _write(socket, heartbeat, _group, _port);
+        nextHeartbeat = Clock::now() + HEARTBEAT_INTERVAL;
+    }
+}
+
+void MulticastSender::_answerReceivers(QUdpSocket& socket)
+{
+    while (socket.hasPendingDatagrams())
+    {
+        QByteArray datagram(int(socket.pendingDatagramSize()),
+                            Qt::Uninitialized);
+        if (socket.readDatagram(datagram.data(), datagram.size()) < 0)
+            return;
+
+        DatagramHeader header;
+        QByteArray payload;
+        if (!parseDatagram(datagram, header, payload) ||
+            header.session != _session)
+        {
+            continue;
+        }
+
+        if (header.type == DatagramType::fullFrame)
+        {
+            if (_onFullFrameRequest)
+                _onFullFrameRequest();
+            continue;
+        }
+        if (header.type != DatagramType::nack)
+            continue;
+
+        std::vector<QByteArray> repairs;
+        {
+            std::lock_guard<std::mutex> lock(_historyMutex);
+            if (_history)
+                repairs = _history->getRepairs(parseNack(payload));
+        }
+
+        // The other receivers have likely missed the same datagrams
+        for (const auto& repair : repairs)
+            _write(socket, repair, _group, _port);
+    }
+}
+}
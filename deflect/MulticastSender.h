@@ -0,0 +1,116 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_MULTICASTSENDER_H
+#define DEFLECT_MULTICASTSENDER_H
+
+#include "MessageHeader.h"     // MessageHeader
+#include "MulticastProtocol.h" // member
+
+#include <QHostAddress>
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+class QThread;
+class QUdpSocket;
+
+namespace deflect
+{
+/**
+ * Send the messages of a Stream to a UDP multicast group.
+ *
+ * The datagrams are sent from the caller thread. An internal thread answers
+ * the nacks of the receivers with the datagrams they missed, forwards their
+ * requests for a full frame when the datagrams can no longer be repaired, and
+ * sends regular heartbeats so that the receivers also notice the loss of the
+ * last datagrams of a frame. Like the rest of the Stream, it does not need a Qt
+ * event loop. The sockets are only used from QThreads, which Qt requires.
+ */
+class MulticastSender
+{
+public:
+    using FullFrameRequestHandler = std::function<void()>;
+
+    /**
+     * Create a sender for a multicast group.
+     *
+     * @param group the address of the multicast group.
+     * @param port the port of the multicast group.
+     * @param onFullFrameRequest called from the internal thread when a
+     *        receiver needs a full frame.
+     * @throw std::runtime_error if the sockets could not be opened.
+     */
+    MulticastSender(const QHostAddress& group, quint16 port,
+                    const FullFrameRequestHandler& onFullFrameRequest);
+
+    /** Stop answering the receivers. */
+    ~MulticastSender();
+
+    /**
+     * Send a message to the group.
+     *
+     * Must always be called from the same thread.
+     * @return false if the message could not be sent.
+     */
+    bool send(const MessageHeader& header, const QByteArray& payload);
+
+private:
+    const QHostAddress _group;
+    const quint16 _port;
+    const uint32_t _session;
+    const FullFrameRequestHandler _onFullFrameRequest;
+
+    std::unique_ptr<QUdpSocket> _socket; // created in the sending thread
+    std::unique_ptr<DatagramHistory> _history;
+    std::mutex _historyMutex;
+
+    std::atomic_bool _running{true};
+    std::unique_ptr<QThread> _repairThread;
+
+    bool _openSocket();
+    void _runRepairs(std::promise<quint16>& repairPort);
+    void _answerReceivers(QUdpSocket& socket);
+};
+}
+
+#endif
@@ -39,7 +39,26 @@
 #ifndef DEFLECT_NETWORK_PROTOCOL_H
 #define DEFLECT_NETWORK_PROTOCOL_H
 
-#define NETWORK_PROTOCOL_VERSION 8
+#define NETWORK_PROTOCOL_VERSION 17
 #define DEFAULT_PORT_NUMBER 1701
 
+/** Host prefix for connecting to a Server through a unix socket path. */
+#define UNIX_SOCKET_HOST_PREFIX "unix:"
+
+/** Oldest server protocol version which clients can still connect to. */
+#define MIN_NETWORK_PROTOCOL_VERSION 8
+
+/** @name Protocol versions introducing optional features */
+//@{
+#define SHARED_MEMORY_PROTOCOL_VERSION 9
+#define EVENT_BATCH_PROTOCOL_VERSION 10
+#define PARTIAL_FRAME_PROTOCOL_VERSION 11
+#define VISIBILITY_PROTOCOL_VERSION 12
+#define SOLID_SEGMENT_PROTOCOL_VERSION 13
+#define COPY_RECT_PROTOCOL_VERSION 14
+#define MULTICAST_PROTOCOL_VERSION 15
+#define FULL_FRAME_REQUEST_PROTOCOL_VERSION 16
+#define TILE_FORMATS_PROTOCOL_VERSION 17
+//@}
+
 #endif
@@ -43,10 +43,9 @@
 #include "NetworkProtocol.h"
 #include "StreamPrivate.h"
 
-#include <QDataStream>
-
-#include <cassert>
+#include <chrono>
 #include <iostream>
+#include <stdexcept>
 
 namespace deflect
 {
@@ -117,21 +116,15 @@ bool Observer::registerForEvents(const bool exclusive)
         return false;
     }
 
-    // Wait for bind reply
-    MessageHeader mh;
+    // Wait for bind reply, other messages may arrive before it
     QByteArray message;
-    if (!_impl->socket.receive(mh, message))
+    if (!_impl->receiveReply(MESSAGE_TYPE_BIND_EVENTS_REPLY, message) ||
+        message.size() != sizeof(bool))
     {
         std::cerr << "deflect::Stream::registerForEvents: receive bind reply "
                   << "failed" << std::endl;
         return false;
     }
-    if (mh.type != MESSAGE_TYPE_BIND_EVENTS_REPLY)
-    {
-        std::cerr << "deflect::Stream::registerForEvents: received unexpected "
-                  << "message type (" << int(mh.type) << ")" << std::endl;
-        return false;
-    }
     _impl->registeredForEvents = *(bool*)(message.data());
 
     return isRegisteredForEvents();
@@ -149,33 +142,42 @@ int Observer::getDescriptor() const
 
 bool Observer::hasEvent() const
 {
-    return _impl->socket.hasMessage(Event::serializedSize);
+    if (!_impl->isReceivingEventsAsync())
+        _impl->receiveEvents();
+    return _impl->events.size_approx() > 0;
 }
 
 Event Observer::getEvent()
 {
-    MessageHeader mh;
-    QByteArray message;
-    if (!_impl->socket.receive(mh, message))
-    {
+    Event event;
+    if (_impl->events.try_dequeue(event))
+        return event;
+
+    const bool received =
+        _impl->isReceivingEventsAsync()
+            ? _impl->events.wait_dequeue_timed(event, std::chrono::seconds(1))
+            : _impl->waitForEvents() && _impl->events.try_dequeue(event);
+    if (!received)
         std::cerr << "deflect::Stream::getEvent: receive failed" << std::endl;
-        return Event();
-    }
-    if (mh.type != MESSAGE_TYPE_EVENT)
-    {
-        std::cerr << "deflect::Stream::getEvent: received unexpected message "
-                  << "type (" << int(mh.type) << ")" << std::endl;
-        return Event();
-    }
+    return event;
+}
 
-    assert((size_t)message.size() == Event::serializedSize);
+std::vector<Event> Observer::getEvents()
+{
+    if (!_impl->isReceivingEventsAsync())
+        _impl->receiveEvents();
 
-    Event event;
-    {
-        QDataStream stream(message);
-        stream >> event;
-    }
-    return event;
+    std::vector<Event> events(_impl->events.size_approx());
+    events.resize(_impl->events.try_dequeue_bulk(events.begin(), events.size()));
+    return events;
+}
+
+void Observer::setEventCallback(std::function<void()> callback)
+{
+    if (!isRegisteredForEvents())
+        throw std::runtime_error("Observer is not registered for events");
+
+    _impl->setEventCallback(std::move(callback));
 }
 
 void Observer::setDisconnectedCallback(const std::function<void()> callback)
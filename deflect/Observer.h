@@ -49,6 +49,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace deflect
 {
@@ -74,6 +75,8 @@ public:
      *
      * DEFLECT_HOST  The address[:port] of the target Server instance, required.
      *               If no port is provided, the default port 1701 is used.
+     *               A Server listening on a unix socket path can be reached
+     *               with "unix:/path/to/socket".
      * DEFLECT_ID    The identifier for the stream. If not provided, a random
      *               unique identifier will be used.
      * @throw std::runtime_error if DEFLECT_HOST was not provided or no
@@ -109,8 +112,9 @@ public:
      *           a random unique identifier will be used.
      * @param host The address of the target Server instance. It can be a
      *             hostname like "localhost" or an IP in string format like
-     *             "192.168.1.83". If left empty, the environment variable
-     *             DEFLECT_HOST will be used instead.
+     *             "192.168.1.83", or a unix socket path of a local Server
+     *             like "unix:/tmp/deflect.sock". If left empty, the
+     *             environment variable DEFLECT_HOST will be used instead.
      * @param port Port of the Server instance, default 1701.
      * @throw std::runtime_error if no host was provided or no
      *                           connection to server could be established
@@ -143,7 +147,7 @@ public:
      * After registering, the Server application will send Events whenever a
      * user is interacting with this Observers's window.
      *
-     * Events can be retrieved using hasEvent() and getEvent().
+     * Events can be retrieved using hasEvent() and getEvent(), or getEvents().
      *
      * The current registration status can be checked with
      * isRegisteredForEvents().
@@ -178,6 +182,9 @@ public:
      * Observer, for example using hasEvent(), and process the events
      * accordingly.
      *
+     * The descriptor must not be used anymore after setEventCallback() was
+     * called, as the events are then read by a background thread.
+     *
      * @return The native descriptor if available; otherwise returns -1.
      * @version 1.0
      */
@@ -209,6 +216,37 @@ public:
      */
     DEFLECT_API Event getEvent();
 
+    /**
+     * Get all the Events received so far.
+     *
+     * This method is non-blocking and retrieves all the pending events at once,
+     * which is much more efficient than hasEvent() + getEvent() for high rates
+     * of events such as multi-touch input.
+     *
+     * @return the pending Events in order of reception, possibly none.
+     * @version 1.1
+     */
+    DEFLECT_API std::vector<Event> getEvents();
+
+    /**
+     * Receive the Events asynchronously in a background thread.
+     *
+     * The Events are decoded and queued as soon as they arrive, and the
+     * callback notifies that new Events can be retrieved with getEvents() (or
+     * hasEvent() + getEvent()). This removes the need for polling the
+     * descriptor.
+     *
+     * Must be called after registerForEvents(). Calling it again replaces the
+     * previous callback; an empty callback stops the notifications but the
+     * Events are still queued.
+     *
+     * @param callback the function to call when new Events are available or
+     *        the observer got disconnected. It is called from the background
+     *        thread, and must not block.
+     * @version 1.1
+     */
+    DEFLECT_API void setEventCallback(std::function<void()> callback);
+
     /**
      * Set a function to be be called just after the observer gets disconnected.
      *
@@ -0,0 +1,84 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "RelayStream.h"
+
+#include "Segment.h"
+#include "StreamPrivate.h"
+
+#include <iterator>
+
+namespace deflect
+{
+RelayStream::RelayStream(const std::string& id, const std::string& host,
+                         const unsigned short port)
+    : Stream(id, host, port)
+{
+}
+
+RelayStream::~RelayStream()
+{
+}
+
+bool RelayStream::supportsFormat(const Format format) const
+{
+    switch (format)
+    {
+    case Format::solid:
+        return _impl->supportsSolidSegments();
+    case Format::copy:
+        return _impl->supportsCopyRect();
+    default:
+        return true;
+    }
+}
+
+Stream::Future RelayStream::sendFrame(Segments&& segments, const bool partial)
+{
+    std::vector<Task> tasks;
+    tasks.reserve(segments.size() + 2);
+    for (auto& segment : segments)
+        tasks.emplace_back(_impl->task.send(std::move(segment)));
+
+    auto finishTasks = _impl->task.finishFrame(partial);
+    tasks.insert(tasks.end(), std::make_move_iterator(finishTasks.begin()),
+                 std::make_move_iterator(finishTasks.end()));
+    return _impl->sendWorker.enqueueRequest(std::move(tasks));
+}
+}
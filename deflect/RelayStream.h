@@ -0,0 +1,88 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_RELAYSTREAM_H
+#define DEFLECT_RELAYSTREAM_H
+
+#include <deflect/Stream.h>
+#include <deflect/api.h>
+
+namespace deflect
+{
+/**
+ * A Stream which forwards segments that are already compressed.
+ *
+ * Used by servers relaying the frames they receive to other servers, without
+ * decoding and encoding them again.
+ */
+class RelayStream : public Stream
+{
+public:
+    /**
+     * Open a new connection to the Server.
+     *
+     * @param id the unique stream identifier.
+     * @param host the address of the target Server.
+     * @param port the port of the target Server.
+     * @throw std::runtime_error if the connection could not be established.
+     */
+    DEFLECT_API RelayStream(const std::string& id, const std::string& host,
+                            unsigned short port);
+
+    /** Close the stream. */
+    DEFLECT_API ~RelayStream();
+
+    /** @return true if the server can receive segments in the given format. */
+    DEFLECT_API bool supportsFormat(Format format) const;
+
+    /**
+     * Send the segments of a frame and finish it.
+     *
+     * The segments are sent as they are, the caller is responsible for only
+     * sending formats that the server supports.
+     * @param segments the segments of the frame.
+     * @param partial finish a partial frame, which only updates a part of the
+     *        previous frame (see supportsPartialFrames()).
+     * @return true if all the segments could be sent.
+     */
+    DEFLECT_API Future sendFrame(Segments&& segments, bool partial);
+};
+}
+
+#endif
@@ -0,0 +1,212 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "SegmentTracker.h"
+
+#include <cstring>
+
+namespace deflect
+{
+namespace
+{
+const char* _getRow(const ImageWrapper& image, const SegmentParameters& params,
+                    const uint32_t row)
+{
+    const auto bytesPerPixel = image.getBytesPerPixel();
+    const auto pitch = size_t(image.width) * bytesPerPixel;
+    return reinterpret_cast<const char*>(image.data) +
+           (params.y - image.y + row) * pitch +
+           (params.x - image.x) * bytesPerPixel;
+}
+
+bool _hasPixels(const QByteArray& pixels, const ImageWrapper& image,
+                const SegmentParameters& params)
+{
+    const auto rowSize = size_t(params.width) * image.getBytesPerPixel();
+    if (size_t(pixels.size()) != rowSize * params.height)
+        return false;
+
+    auto data = pixels.constData();
+    for (uint32_t row = 0; row < params.height; ++row, data += rowSize)
+    {
+        if (std::memcmp(data, _getRow(image, params, row), rowSize) != 0)
+            return false;
+    }
+    return true;
+}
+
+QByteArray _copyPixels(const ImageWrapper& image,
+                       const SegmentParameters& params)
+{
+    const auto rowSize = int(params.width * image.getBytesPerPixel());
+    QByteArray pixels;
+    pixels.reserve(rowSize * int(params.height));
+    for (uint32_t row = 0; row < params.height; ++row)
+        pixels.append(_getRow(image, params, row), rowSize);
+    return pixels;
+}
+}
+
+ImageWrapper SegmentTracker::Refinement::makeImage(
+    const unsigned int quality) const
+{
+    ImageWrapper image(pixels.constData(), parameters.width, parameters.height,
+                       pixelFormat, parameters.x, parameters.y);
+    image.compressionPolicy = COMPRESSION_ON;
+    image.compressionQuality = quality;
+    image.subsampling = subsampling;
+    image.view = view;
+    image.rowOrder = rowOrder;
+    image.channel = channel;
+    return image;
+}
+
+SegmentTracker::SegmentTracker(const std::chrono::milliseconds delay)
+    : _delay{delay}
+{
+}
+
+bool SegmentTracker::update(const ImageWrapper& image,
+                            const SegmentParameters& params, const bool refine)
+{
+    const Key key{image.view, image.channel, params.x, params.y, params.width,
+                  params.height};
+    auto& entry = _segments[key];
+    auto& segment = entry.segment;
+
+    const auto changed = segment.pixelFormat != image.pixelFormat ||
+                         segment.rowOrder != image.rowOrder ||
+                         !_hasPixels(segment.pixels, image, params);
+    if (changed)
+    {
+        segment.parameters = params;
+        segment.pixels = _copyPixels(image, params);
+        segment.pixelFormat = image.pixelFormat;
+        segment.view = image.view;
+        segment.rowOrder = image.rowOrder;
+        segment.channel = image.channel;
+        entry.due = Clock::now() + _delay;
+        _eraseOverlapping(key);
+    }
+    // refined like the latest frames, even if the segment did not change
+    segment.subsampling = image.subsampling;
+    entry.pending = refine && (changed || entry.pending);
+    return changed;
+}
+
+bool SegmentTracker::takeRefinement(Refinement& refinement)
+{
+    auto next = _segments.end();
+    for (auto it = _segments.begin(); it != _segments.end(); ++it)
+    {
+        const auto& entry = it->second;
+        if (entry.pending && (next == _segments.end() ||
+                              entry.due < next->second.due))
+        {
+            next = it;
+        }
+    }
+    if (next == _segments.end() || next->second.due > Clock::now())
+        return false;
+
+    next->second.pending = false;
+    refinement = next->second.segment;
+    return true;
+}
+
+std::chrono::milliseconds SegmentTracker::getTimeToNextRefinement() const
+{
+    using std::chrono::milliseconds;
+
+    auto time = milliseconds(-1);
+    const auto now = Clock::now();
+    for (const auto& kv : _segments)
+    {
+        const auto& entry = kv.second;
+        if (!entry.pending)
+            continue;
+
+        // round up to not wake up before the refinement is due
+        auto remaining = milliseconds(0);
+        if (entry.due > now)
+        {
+            remaining =
+                std::chrono::duration_cast<milliseconds>(entry.due - now) +
+                milliseconds(1);
+        }
+        if (time.count() < 0 || remaining < time)
+            time = remaining;
+    }
+    return time;
+}
+
+void SegmentTracker::setFrameSize(const QSize& size)
+{
+    if (size == _frameSize)
+        return;
+
+    _frameSize = size;
+    clear();
+}
+
+void SegmentTracker::clear()
+{
+    _segments.clear();
+}
+
+void SegmentTracker::_eraseOverlapping(const Key& key)
+{
+    const auto overlaps = [&key](const Key& other) {
+        return std::get<0>(other) == std::get<0>(key) &&
+               std::get<1>(other) == std::get<1>(key) &&
+               std::get<2>(other) < std::get<2>(key) + std::get<4>(key) &&
+               std::get<2>(key) < std::get<2>(other) + std::get<4>(other) &&
+               std::get<3>(other) < std::get<3>(key) + std::get<5>(key) &&
+               std::get<3>(key) < std::get<3>(other) + std::get<5>(other);
+    };
+
+    for (auto it = _segments.begin(); it != _segments.end();)
+    {
+        if (it->first != key && overlaps(it->first))
+            it = _segments.erase(it);
+        else
+            ++it;
+    }
+}
+}
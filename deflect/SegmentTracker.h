@@ -0,0 +1,149 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SEGMENTTRACKER_H
+#define DEFLECT_SEGMENTTRACKER_H
+
+#include <deflect/api.h>
+#include <deflect/ImageWrapper.h>
+#include <deflect/SegmentParameters.h>
+
+#include <QByteArray>
+#include <QSize>
+
+#include <chrono>
+#include <map>
+#include <tuple>
+
+namespace deflect
+{
+/**
+ * Track the content of the segments sent by a Stream, to skip the unchanged
+ * ones and to send again the ones which stopped changing at a better quality.
+ *
+ * Not thread-safe, it is only used by the thread of the StreamSendWorker.
+ */
+class SegmentTracker
+{
+public:
+    /** A segment to send again, with a copy of its last content. */
+    struct Refinement
+    {
+        SegmentParameters parameters;
+        QByteArray pixels;
+        PixelFormat pixelFormat = RGBA;
+        View view = View::mono;
+        RowOrder rowOrder = RowOrder::top_down;
+        uint8_t channel = 0;
+        ChromaSubsampling subsampling = ChromaSubsampling::YUV444;
+
+        /**
+         * Make an image of the pixels to send again.
+         *
+         * The image keeps the subsampling of the last frame of the segment, as
+         * the receivers may compose the refined segment with that frame.
+         * @param quality the JPEG quality of the refined segment.
+         * @return an image referencing the pixels of this refinement.
+         */
+        DEFLECT_API ImageWrapper makeImage(unsigned int quality) const;
+    };
+
+    /**
+     * Construct a tracker.
+     * @param delay without changes after which a segment is refined.
+     */
+    DEFLECT_API explicit SegmentTracker(std::chrono::milliseconds delay);
+
+    /**
+     * Update the content of a segment.
+     *
+     * The other segments which overlap it, i.e. of a different geometry, are
+     * forgotten as their content is outdated.
+     *
+     * @param image the image of the segment, which must not be side_by_side.
+     * @param params the parameters of the segment in the image.
+     * @param refine schedule the refinement of the segment if it changed,
+     *        otherwise any pending refinement of it is canceled.
+     * @return true if the content of the segment changed since the last update.
+     */
+    DEFLECT_API bool update(const ImageWrapper& image,
+                            const SegmentParameters& params, bool refine);
+
+    /**
+     * Take the segment whose refinement is the most overdue.
+     * @param refinement set to the segment to refine, if any.
+     * @return true if a refinement was due.
+     */
+    DEFLECT_API bool takeRefinement(Refinement& refinement);
+
+    /**
+     * @return the time until the next refinement is due, zero if one is due
+     *         already, negative if no refinement is pending.
+     */
+    DEFLECT_API std::chrono::milliseconds getTimeToNextRefinement() const;
+
+    /**
+     * Set the dimensions of the frames, forgetting all the segments if they
+     * changed.
+     */
+    DEFLECT_API void setFrameSize(const QSize& size);
+
+    /** Forget all segments, which are then considered as changed. */
+    DEFLECT_API void clear();
+
+private:
+    using Clock = std::chrono::steady_clock;
+    using Key = std::tuple<View, uint8_t, uint32_t, uint32_t, uint32_t,
+                           uint32_t>;
+    struct Entry
+    {
+        Refinement segment;
+        bool pending = false;
+        Clock::time_point due;
+    };
+
+    const std::chrono::milliseconds _delay;
+    std::map<Key, Entry> _segments;
+    QSize _frameSize;
+
+    void _eraseOverlapping(const Key& key);
+};
+}
+
+#endif
@@ -0,0 +1,205 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "SharedMemoryRing.h"
+
+#include <QCoreApplication>
+
+#include <atomic>
+#include <new>
+#include <stdexcept>
+
+namespace
+{
+const uint32_t RING_MAGIC = 0xdef1ec75;
+const uint32_t RING_LAYOUT_VERSION = 1;
+const uint32_t MAX_SLOTS = 256;
+const size_t DATA_ALIGNMENT = 64;
+
+enum SlotState : uint32_t
+{
+    SLOT_FREE,
+    SLOT_ACQUIRED,
+    SLOT_PUBLISHED
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "lock-free atomics are required in shared memory");
+}
+
+namespace deflect
+{
+struct SharedMemoryRing::Header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    std::atomic<uint32_t> states[MAX_SLOTS];
+
+    static size_t dataOffset()
+    {
+        return (sizeof(Header) + DATA_ALIGNMENT - 1) / DATA_ALIGNMENT *
+               DATA_ALIGNMENT;
+    }
+};
+
+SharedMemoryRing::SharedMemoryRing(const std::string& keyPrefix,
+                                   const uint32_t slotCount,
+                                   const uint32_t slotSize)
+{
+    if (slotCount == 0 || slotCount > MAX_SLOTS || slotSize == 0)
+        throw std::invalid_argument("invalid shared memory ring dimensions");
+
+    static std::atomic<uint32_t> counter{0};
+    const auto size = Header::dataOffset() + size_t(slotCount) * slotSize;
+    const auto prefix = QString("deflect_%1_%2_")
+                            .arg(QString::fromStdString(keyPrefix))
+                            .arg(QCoreApplication::applicationPid());
+    do
+    {
+        _memory.setKey(prefix + QString::number(counter++));
+    } while (!_memory.create(int(size)) &&
+             _memory.error() == QSharedMemory::AlreadyExists);
+
+    if (!_memory.isAttached())
+        throw std::runtime_error("could not create shared memory: " +
+                                 _memory.errorString().toStdString());
+
+    _header = new (_memory.data()) Header;
+    _header->magic = RING_MAGIC;
+    _header->version = RING_LAYOUT_VERSION;
+    _header->slotCount = slotCount;
+    _header->slotSize = slotSize;
+    for (auto& state : _header->states)
+        state.store(SLOT_FREE);
+}
+
+SharedMemoryRing::SharedMemoryRing(const std::string& key)
+    : _memory(QString::fromStdString(key))
+{
+    if (!_memory.attach())
+        throw std::runtime_error("could not attach shared memory: " +
+                                 _memory.errorString().toStdString());
+
+    if (size_t(_memory.size()) < Header::dataOffset())
+        throw std::runtime_error("shared memory is too small");
+
+    _header = static_cast<Header*>(_memory.data());
+    if (_header->magic != RING_MAGIC ||
+        _header->version != RING_LAYOUT_VERSION ||
+        _header->slotCount > MAX_SLOTS ||
+        size_t(_memory.size()) < Header::dataOffset() +
+                                     size_t(_header->slotCount) *
+                                         _header->slotSize)
+    {
+        throw std::runtime_error("shared memory is not a valid ring");
+    }
+}
+
+SharedMemoryRing::~SharedMemoryRing()
+{
+    _memory.detach();
+}
+
+std::string SharedMemoryRing::getKey() const
+{
+    return _memory.key().toStdString();
+}
+
+uint32_t SharedMemoryRing::getSlotCount() const
+{
+    return _header->slotCount;
+}
+
+uint32_t SharedMemoryRing::getSlotSize() const
+{
+    return _header->slotSize;
+}
+
+int SharedMemoryRing::acquireSlot()
+{
+    for (uint32_t i = 0; i < _header->slotCount; ++i)
+    {
+        const auto slot = (_nextSlot + i) % _header->slotCount;
+        auto& state = _header->states[slot];
+        auto expected = uint32_t(SLOT_FREE);
+        if (state.compare_exchange_strong(expected, SLOT_ACQUIRED,
+                                          std::memory_order_acquire))
+        {
+            _nextSlot = (slot + 1) % _header->slotCount;
+            return int(slot);
+        }
+    }
+    return -1;
+}
+
+char* SharedMemoryRing::getSlotData(const uint32_t slot)
+{
+    return _getData(slot);
+}
+
+void SharedMemoryRing::publishSlot(const uint32_t slot)
+{
+    _header->states[slot].store(SLOT_PUBLISHED, std::memory_order_release);
+}
+
+bool SharedMemoryRing::isPublished(const uint32_t slot) const
+{
+    return slot < _header->slotCount &&
+           _header->states[slot].load(std::memory_order_acquire) ==
+               SLOT_PUBLISHED;
+}
+
+const char* SharedMemoryRing::getSlotData(const uint32_t slot) const
+{
+    return _getData(slot);
+}
+
+void SharedMemoryRing::releaseSlot(const uint32_t slot)
+{
+    _header->states[slot].store(SLOT_FREE, std::memory_order_release);
+}
+
+char* SharedMemoryRing::_getData(const uint32_t slot) const
+{
+    return reinterpret_cast<char*>(_header) + Header::dataOffset() +
+           size_t(slot) * _header->slotSize;
+}
+}
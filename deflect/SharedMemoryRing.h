@@ -0,0 +1,142 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SHAREDMEMORYRING_H
+#define DEFLECT_SHAREDMEMORYRING_H
+
+#include <deflect/api.h>
+
+#include <QSharedMemory>
+
+#include <cstdint>
+#include <string>
+
+namespace deflect
+{
+/** Reference to the image data of a segment stored in a SharedMemoryRing. */
+struct SharedMemorySlot
+{
+    uint32_t index = 0u; /**< The index of the slot in the ring. */
+    uint32_t size = 0u;  /**< The size of the data in the slot. */
+};
+
+/**
+ * A ring of fixed-size buffers in shared memory, used to hand over image data
+ * between a Stream and a Server running on the same machine.
+ *
+ * The producer (Stream) creates the ring, acquires a free slot, writes its data
+ * and publishes the slot. The consumer (Server) attaches to the ring using its
+ * key and releases each published slot once the data is no longer in use.
+ * The state of the slots is stored in the shared memory, the notification of
+ * published slots is up to the caller (i.e. messages on the control socket).
+ *
+ * Acquiring and publishing must be done from a single producer thread, while
+ * releasing is thread-safe.
+ */
+class SharedMemoryRing
+{
+public:
+    /**
+     * Create a new ring in shared memory with a unique key.
+     *
+     * @param keyPrefix used to generate the unique key of the ring.
+     * @param slotCount number of slots in the ring.
+     * @param slotSize size of each slot in bytes.
+     * @throw std::runtime_error if the shared memory could not be created.
+     */
+    DEFLECT_API SharedMemoryRing(const std::string& keyPrefix,
+                                 uint32_t slotCount, uint32_t slotSize);
+
+    /**
+     * Attach to an existing ring.
+     *
+     * @param key the key of the ring, as returned by getKey().
+     * @throw std::runtime_error if the shared memory could not be attached or
+     *        is not a valid ring.
+     */
+    DEFLECT_API explicit SharedMemoryRing(const std::string& key);
+
+    /** Detach from the shared memory. */
+    DEFLECT_API ~SharedMemoryRing();
+
+    /** @return the key to attach to this ring from another process. */
+    DEFLECT_API std::string getKey() const;
+
+    /** @return the number of slots of the ring. */
+    DEFLECT_API uint32_t getSlotCount() const;
+
+    /** @return the size of each slot in bytes. */
+    DEFLECT_API uint32_t getSlotSize() const;
+
+    /** @name Producer */
+    //@{
+    /** @return the index of a free slot to write to, or -1 if none is free. */
+    DEFLECT_API int acquireSlot();
+
+    /** @return the data of a slot, to be written after acquireSlot(). */
+    DEFLECT_API char* getSlotData(uint32_t slot);
+
+    /** Make the data written in an acquired slot available to the consumer. */
+    DEFLECT_API void publishSlot(uint32_t slot);
+    //@}
+
+    /** @name Consumer */
+    //@{
+    /** @return true if the slot is published and can be read. */
+    DEFLECT_API bool isPublished(uint32_t slot) const;
+
+    /** @return the data of a published slot. */
+    DEFLECT_API const char* getSlotData(uint32_t slot) const;
+
+    /** Give a published slot back to the producer. @threadsafe */
+    DEFLECT_API void releaseSlot(uint32_t slot);
+    //@}
+
+private:
+    struct Header;
+
+    QSharedMemory _memory;
+    Header* _header = nullptr;
+    uint32_t _nextSlot = 0u;
+
+    char* _getData(uint32_t slot) const;
+};
+}
+
+#endif
@@ -46,14 +46,33 @@
 #include <QCoreApplication>
 #include <QDataStream>
 #include <QLoggingCategory>
+#include <QNetworkInterface>
 #include <QTcpSocket>
 
+#include <cstring>
 #include <sstream>
 
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 namespace
 {
 const int INVALID_NETWORK_PROTOCOL_VERSION = -1;
 const int RECEIVE_TIMEOUT_MS = 5000;
+#ifndef Q_OS_UNIX
+const int LOCKED_WAIT_TIMEOUT_MS = 10;
+#endif
+
+bool _isUnixSocketHost(const std::string& host)
+{
+    return host.compare(0, std::strlen(UNIX_SOCKET_HOST_PREFIX),
+                        UNIX_SOCKET_HOST_PREFIX) == 0;
+}
 }
 
 namespace deflect
@@ -70,15 +89,35 @@ Socket::Socket(const std::string& host, const unsigned short port)
     if (!qApp)
         QLoggingCategory::defaultCategory()->setEnabled(QtWarningMsg, false);
 
-    _socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
-    _socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    // TCP options are meaningless for unix sockets
+    if (!isUnixSocket())
+    {
+        _socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+        _socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    }
     _connect(host, port);
 
+#ifdef Q_OS_UNIX
+    // Self-pipe to wake up waitForData(), which blocks without timeout
+    if (::pipe(_wakeUpPipe) != 0)
+        throw std::runtime_error("could not create the socket wake-up pipe");
+    for (const auto fd : _wakeUpPipe)
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+
     // Both objects live in the same thread, can use direct connection.
     QObject::connect(_socket, &QTcpSocket::disconnected, this,
                      &Socket::disconnected, Qt::DirectConnection);
 }
 
+Socket::~Socket()
+{
+#ifdef Q_OS_UNIX
+    for (const auto fd : _wakeUpPipe)
+        ::close(fd);
+#endif
+}
+
 const std::string& Socket::getHost() const
 {
     return _host;
@@ -89,6 +128,11 @@ unsigned short Socket::getPort() const
     return _socket->peerPort();
 }
 
+bool Socket::isUnixSocket() const
+{
+    return _isUnixSocketHost(_host);
+}
+
 bool Socket::isConnected() const
 {
     return _socket->state() == QTcpSocket::ConnectedState;
@@ -99,25 +143,136 @@ int32_t Socket::getServerProtocolVersion() const
     return _serverProtocolVersion;
 }
 
+bool Socket::isLocal() const
+{
+    if (isUnixSocket())
+        return true;
+
+    const auto address = _socket->peerAddress();
+    return address.isLoopback() ||
+           QNetworkInterface::allAddresses().contains(address);
+}
+
 int Socket::getFileDescriptor() const
 {
     return _socket->socketDescriptor();
 }
 
-bool Socket::hasMessage(const size_t messageSize) const
+void Socket::waitForData() const
 {
+#ifdef Q_OS_UNIX
+    {
+        // Messages already read from the descriptor (e.g. while connecting)
+        // would not wake up poll(); send() and receive() notify the others.
+        QMutexLocker locker(&_socketMutex);
+        if (_hasBufferedMessage() || !isConnected())
+            return;
+    }
+
+    pollfd fds[2];
+    fds[0].fd = getFileDescriptor();
+    fds[1].fd = _wakeUpPipe[0];
+    for (auto& pfd : fds)
+    {
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+    }
+    ::poll(fds, 2, -1);
+
+    if (fds[1].revents != 0)
+    {
+        _wakeUpPending = false;
+        char buffer[16];
+        while (::read(_wakeUpPipe[0], buffer, sizeof(buffer)) > 0)
+            ;
+    }
+#else
+    // Without poll(), wait on the QTcpSocket itself, which must be locked
     QMutexLocker locker(&_socketMutex);
+    if (!_hasBufferedMessage() && !_wakeUpPending.exchange(false))
+        _socket->waitForReadyRead(LOCKED_WAIT_TIMEOUT_MS);
+#endif
+}
+
+void Socket::interruptWait()
+{
+    if (_wakeUpPending.exchange(true))
+        return;
+#ifdef Q_OS_UNIX
+    const char byte = 0;
+    if (::write(_wakeUpPipe[1], &byte, 1) != 1)
+        _wakeUpPending = false;
+#endif
+}
 
+void Socket::_wakeUpWaitingReader()
+{
+    if (_hasBufferedMessage() || !isConnected())
+        interruptWait();
+}
+
+bool Socket::_hasBufferedMessage() const
+{
+    MessageHeader messageHeader;
+    return _peekHeader(messageHeader) &&
+           _socket->bytesAvailable() >=
+               qint64(MessageHeader::serializedSize + messageHeader.size);
+}
+
+size_t Socket::receiveAvailable(const MessageHandler& handler)
+{
+    QMutexLocker locker(&_socketMutex);
+    return _receiveAvailable(handler);
+}
+
+size_t Socket::tryReceiveAvailable(const MessageHandler& handler)
+{
+    if (!_socketMutex.tryLock())
+        return 0;
+
+    const auto count = _receiveAvailable(handler);
+    _socketMutex.unlock();
+    return count;
+}
+
+size_t Socket::_receiveAvailable(const MessageHandler& handler)
+{
     // needed to 'wakeup' socket when no data was streamed for a while
     _socket->waitForReadyRead(0);
-    return _socket->bytesAvailable() >=
-           (int)(MessageHeader::serializedSize + messageSize);
+
+    size_t count = 0;
+    MessageHeader messageHeader;
+    while (_peekHeader(messageHeader) &&
+           _socket->bytesAvailable() >=
+               qint64(MessageHeader::serializedSize + messageHeader.size))
+    {
+        _socket->read(MessageHeader::serializedSize);
+        handler(messageHeader, _socket->read(messageHeader.size));
+        ++count;
+    }
+    return count;
 }
 
 bool Socket::send(const MessageHeader& messageHeader, const QByteArray& message,
                   const bool waitForBytesWritten)
 {
     QMutexLocker locker(&_socketMutex);
+    const auto sent = _send(messageHeader, message, waitForBytesWritten);
+    _wakeUpWaitingReader();
+    return sent;
+}
+
+bool Socket::receive(MessageHeader& messageHeader, QByteArray& message)
+{
+    QMutexLocker locker(&_socketMutex);
+    const auto received = _receive(messageHeader, message);
+    _wakeUpWaitingReader();
+    return received;
+}
+
+bool Socket::_send(const MessageHeader& messageHeader,
+                   const QByteArray& message, const bool waitForBytesWritten)
+{
     if (!isConnected())
         return false;
 
@@ -140,10 +295,8 @@ bool Socket::send(const MessageHeader& messageHeader, const QByteArray& message,
     return allSent;
 }
 
-bool Socket::receive(MessageHeader& messageHeader, QByteArray& message)
+bool Socket::_receive(MessageHeader& messageHeader, QByteArray& message)
 {
-    QMutexLocker locker(&_socketMutex);
-
     if (!_receiveHeader(messageHeader))
         return false;
 
@@ -184,14 +337,30 @@ bool Socket::_receiveHeader(MessageHeader& messageHeader)
     return stream.status() == QDataStream::Ok;
 }
 
+bool Socket::_peekHeader(MessageHeader& messageHeader) const
+{
+    if (_socket->bytesAvailable() < qint64(MessageHeader::serializedSize))
+        return false;
+
+    QDataStream stream(_socket->peek(MessageHeader::serializedSize));
+    stream >> messageHeader;
+
+    return stream.status() == QDataStream::Ok;
+}
+
 void Socket::_connect(const std::string& host, const unsigned short port)
 {
-    _socket->connectToHost(host.c_str(), port);
-    if (!_socket->waitForConnected(RECEIVE_TIMEOUT_MS))
+    if (isUnixSocket())
+        _connectUnixSocket(host.substr(std::strlen(UNIX_SOCKET_HOST_PREFIX)));
+    else
     {
-        std::stringstream ss;
-        ss << "could not connect to " << host << ":" << port;
-        throw std::runtime_error(ss.str());
+        _socket->connectToHost(host.c_str(), port);
+        if (!_socket->waitForConnected(RECEIVE_TIMEOUT_MS))
+        {
+            std::stringstream ss;
+            ss << "could not connect to " << host << ":" << port;
+            throw std::runtime_error(ss.str());
+        }
     }
 
     if (!_receiveProtocolVersion())
@@ -200,16 +369,45 @@ void Socket::_connect(const std::string& host, const unsigned short port)
         throw std::runtime_error("server protocol version was not received");
     }
 
-    if (_serverProtocolVersion < NETWORK_PROTOCOL_VERSION)
+    if (_serverProtocolVersion < MIN_NETWORK_PROTOCOL_VERSION)
     {
         //_socket->disconnectFromHost();
         std::stringstream ss;
         ss << "server uses unsupported protocol: " << _serverProtocolVersion
-           << " < " << NETWORK_PROTOCOL_VERSION;
+           << " < " << MIN_NETWORK_PROTOCOL_VERSION;
         throw std::runtime_error(ss.str());
     }
 }
 
+void Socket::_connectUnixSocket(const std::string& path)
+{
+#ifdef Q_OS_UNIX
+    sockaddr_un address;
+    if (path.empty() || path.size() >= sizeof(address.sun_path))
+        throw std::runtime_error("invalid unix socket path: '" + path + "'");
+
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw std::runtime_error("could not create unix socket");
+
+    // The QTcpSocket takes ownership of the connected descriptor, this is also
+    // how QLocalSocket is implemented on unix.
+    if (::connect(fd, (const sockaddr*)&address, sizeof(address)) != 0 ||
+        !_socket->setSocketDescriptor(fd))
+    {
+        ::close(fd);
+        throw std::runtime_error("could not connect to unix socket " + path);
+    }
+#else
+    throw std::runtime_error("unix sockets are not supported, could not "
+                             "connect to " + path);
+#endif
+}
+
 bool Socket::_receiveProtocolVersion()
 {
     while (_socket->bytesAvailable() < qint64(sizeof(int32_t)))
@@ -48,6 +48,8 @@ typedef __int32 int32_t;
 #include <deflect/api.h>
 #include <deflect/types.h>
 
+#include <atomic>
+#include <functional>
 #include <string>
 
 #include <QByteArray>
@@ -68,24 +70,31 @@ class Socket : public QObject
 public:
     /**
      * Construct a Socket and connect to host.
-     * @param host The target host (IP address or hostname)
-     * @param port The target port
+     * @param host The target host (IP address or hostname), or a unix socket
+     *        path with the "unix:" prefix (e.g. "unix:/tmp/deflect.sock")
+     * @param port The target port, ignored for unix sockets
      * @throw std::runtime_error if the socket could not connect
      */
     DEFLECT_API Socket(const std::string& host, unsigned short port);
 
     /** Destruct a Socket, disconnecting from host. */
-    DEFLECT_API ~Socket() = default;
+    DEFLECT_API ~Socket();
 
     /** Get the host passed to the constructor. */
     const std::string& getHost() const;
 
-    /** Get the remote port the socket is connected to. */
+    /** Get the remote port the socket is connected to (0 for unix sockets). */
     unsigned short getPort() const;
 
+    /** @return true if the socket is connected through a unix socket path. */
+    bool isUnixSocket() const;
+
     /** Is the Socket connected */
     DEFLECT_API bool isConnected() const;
 
+    /** @return true if the server runs on the local machine. */
+    bool isLocal() const;
+
     /** @return the protocol version of the server. */
     int32_t getServerProtocolVersion() const;
 
@@ -96,10 +105,40 @@ public:
     int getFileDescriptor() const;
 
     /**
-     * Is there a pending message
-     * @param messageSize Minimum size of the message
+     * Wait until data may be available for reading.
+     *
+     * Returns when the socket becomes readable, when a complete message was
+     * buffered by another thread's send() or receive(), when the connection
+     * is lost or when interruptWait() is called. On platforms which lack
+     * poll() the socket is locked, so the wait is bounded to a few
+     * milliseconds to let the other threads through.
      */
-    bool hasMessage(const size_t messageSize = 0) const;
+    void waitForData() const;
+
+    /** Make a concurrent or the next waitForData() return immediately. */
+    void interruptWait();
+
+    using MessageHandler =
+        std::function<void(const MessageHeader&, const QByteArray&)>;
+
+    /**
+     * Receive all the complete messages that are already available.
+     *
+     * This method is non-blocking and processes all the pending messages in a
+     * single socket access.
+     * @param handler the function to call for each message
+     * @return the number of messages received
+     */
+    size_t receiveAvailable(const MessageHandler& handler);
+
+    /**
+     * Receive all the complete messages that are already available, unless
+     * the socket is currently used by another thread.
+     *
+     * @param handler the function to call for each message
+     * @return the number of messages received
+     */
+    size_t tryReceiveAvailable(const MessageHandler& handler);
 
     /**
      * Send a message.
@@ -130,9 +169,19 @@ private:
     QTcpSocket* _socket; // Child QObject
     mutable QMutex _socketMutex;
     int32_t _serverProtocolVersion;
-
+    int _wakeUpPipe[2] = {-1, -1};
+    mutable std::atomic_bool _wakeUpPending{false};
+
+    size_t _receiveAvailable(const MessageHandler& handler);
+    bool _send(const MessageHeader& messageHeader, const QByteArray& message,
+               bool waitForBytesWritten);
+    bool _receive(MessageHeader& messageHeader, QByteArray& message);
+    void _wakeUpWaitingReader();
+    bool _hasBufferedMessage() const;
     bool _receiveHeader(MessageHeader& messageHeader);
+    bool _peekHeader(MessageHeader& messageHeader) const;
     void _connect(const std::string& host, const unsigned short port);
+    void _connectUnixSocket(const std::string& path);
     bool _receiveProtocolVersion();
     bool _write(const QByteArray& data);
 };
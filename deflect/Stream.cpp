@@ -78,4 +78,39 @@ Stream::Future Stream::sendAndFinish(const ImageWrapper& image)
 {
     return _impl->sendImage(image, true);
 }
+
+bool Stream::supportsPartialFrames() const
+{
+    return _impl->supportsPartialFrames();
+}
+
+Stream::Future Stream::finishPartialFrame()
+{
+    return _impl->sendFinishFrame(true);
+}
+
+Stream::Future Stream::sendAndFinishPartial(const ImageWrapper& image)
+{
+    return _impl->sendImage(image, true, true);
+}
+
+bool Stream::isFullFrameRequested() const
+{
+    return _impl->isFullFrameRequested();
+}
+
+bool Stream::supportsCopyRect() const
+{
+    return _impl->supportsCopyRect();
+}
+
+Stream::Future Stream::copyRect(const CopyRect& copy)
+{
+    return _impl->copyRect(copy);
+}
+
+void Stream::setProgressiveRefinement(const bool enabled)
+{
+    _impl->setProgressiveRefinement(enabled);
+}
 }
@@ -56,6 +56,19 @@ namespace deflect
  * allows to have different applications each responsible for sending one part
  * of the global image.
  *
+ * When the Server runs on the same machine, uncompressed images are handed
+ * over through shared memory instead of the socket. Set the environment
+ * variable DEFLECT_SHM=0 to disable this. The Server reads the segments in
+ * place, until it is done with their frames. The shared memory holds 128
+ * segments of 512x512 raw RGBA pixels (128 MB), set DEFLECT_SHM_SLOTS to change
+ * their number; the segments are sent through the socket when all slots are
+ * used.
+ *
+ * When the Server distributes its streams through a multicast group, the
+ * images are sent to the group over UDP, while the other messages and the
+ * events still go through the connection to the Server. Set the environment
+ * variable DEFLECT_MULTICAST=0 to disable this.
+ *
  * The methods in this class are reentrant (all instances are independant) but
  * are not thread-safe.
  */
@@ -67,6 +80,8 @@ public:
      *
      * DEFLECT_HOST  The address[:port] of the target Server instance, required.
      *               If no port is provided, the default port 1701 is used.
+     *               A Server listening on a unix socket path can be reached
+     *               with "unix:/path/to/socket".
      * DEFLECT_ID    The identifier for the stream. If not provided, a random
      *               unique identifier will be used.
      * @throw std::runtime_error if DEFLECT_HOST was not provided or no
@@ -103,8 +118,9 @@ public:
      *           a random unique identifier will be used.
      * @param host The address of the target Server instance. It can be a
      *             hostname like "localhost" or an IP in string format like
-     *             "192.168.1.83". If left empty, the environment variable
-     *             DEFLECT_HOST will be used instead.
+     *             "192.168.1.83", or a unix socket path of a local Server
+     *             like "unix:/tmp/deflect.sock". If left empty, the
+     *             environment variable DEFLECT_HOST will be used instead.
      * @param port Port of the Server instance, default 1701.
      * @throw std::runtime_error if no host was provided or no
      *                           connection to server could be established
@@ -124,6 +140,11 @@ public:
     /**
      * Send an image asynchronously.
      *
+     * The segments of the image which the Server reports as not visible are
+     * skipped, keeping the ones of the previous frame until they are sent
+     * again, and the JPEG quality is lowered for images which are displayed at
+     * a reduced scale.
+     *
      * @param image The image to send. Note that the image is not copied, so the
      *              referenced must remain valid until the send is finished.
      * @return true if the image data could be sent, false otherwise
@@ -168,6 +189,104 @@ public:
      * @version 1.0
      */
     DEFLECT_API Future sendAndFinish(const ImageWrapper& image);
+
+    /**
+     * @return true if the Server can receive partial frames.
+     * @see finishPartialFrame()
+     * @version 1.1
+     */
+    DEFLECT_API bool supportsPartialFrames() const;
+
+    /**
+     * Asynchronously notify that the images sent for this frame only update a
+     * part of the previous frame.
+     *
+     * Same as finishFrame(), except that the receiver keeps the tiles of the
+     * previous frame which are not fully covered by the tiles of this frame.
+     * To replace the previous tiles, the images must be aligned with the
+     * segments of the previous frame (i.e. multiples of 512 pixels).
+     *
+     * @throw std::runtime_error if !supportsPartialFrames()
+     * @see finishFrame()
+     * @version 1.1
+     */
+    DEFLECT_API Future finishPartialFrame();
+
+    /**
+     * Send an image and finish a partial frame asynchronously.
+     *
+     * @param image The image to send. Note that the image is not copied, so the
+     *              referenced must remain valid until the send is finished
+     * @return true if the image data could be sent, false otherwise.
+     * @throw std::runtime_error if !supportsPartialFrames()
+     * @see sendAndFinish()
+     * @see finishPartialFrame()
+     * @version 1.1
+     */
+    DEFLECT_API Future sendAndFinishPartial(const ImageWrapper& image);
+
+    /**
+     * @return true if the Server asked for a full frame.
+     *
+     * The Server only keeps the shared memory segments of the previous frame
+     * for the streams which already sent partial frames or copies, so it asks
+     * for a full frame when the first of them can not be completed. The next
+     * frame should then be sent entirely and finished with finishFrame(),
+     * without any copy. Until then, the receivers only get the updated regions
+     * of the frames.
+     *
+     * @version 1.1
+     */
+    DEFLECT_API bool isFullFrameRequested() const;
+
+    /**
+     * @return true if the Server application accepts copies of regions of the
+     *         previous frame. The Server tells it shortly after the connection,
+     *         which the Stream learns when finishing a frame or receiving the
+     *         events.
+     * @see copyRect()
+     * @version 1.1
+     */
+    DEFLECT_API bool supportsCopyRect() const;
+
+    /**
+     * Copy a region of the previous frame to a new position asynchronously.
+     *
+     * The copies of a frame are applied in order to the previous frame before
+     * any of its images, which allows scrolling content to be streamed by only
+     * sending the newly exposed parts. Such frames are never skipped or merged
+     * by the receiver.
+     *
+     * @param copy The region to copy and its displacement.
+     * @return true if the copy could be sent, false otherwise.
+     * @throw std::invalid_argument if the copy is empty or if its destination
+     *        has negative coordinates
+     * @throw std::runtime_error if !supportsCopyRect()
+     * @throw std::runtime_error if pending finishFrame() has not been completed
+     * @see finishPartialFrame()
+     * @version 1.1
+     */
+    DEFLECT_API Future copyRect(const CopyRect& copy);
+
+    /**
+     * Progressively refine the static content of the JPEG images sent.
+     *
+     * The segments of the images which did not change since they were last
+     * sent are skipped. Once a segment stops changing, it is sent again at
+     * the best JPEG quality in the background, as soon as no image is being
+     * sent, so that moving content can use a low quality without degrading
+     * static content. The chroma subsampling of the images is kept, so that
+     * all the tiles of a frame have the same one. Side-by-side stereo images
+     * are not refined.
+     *
+     * As the refined segments are sent in frames of their own, this is not
+     * suited to streams made of several sources.
+     *
+     * @param enabled true to refine the static content (default: false).
+     * @throw std::runtime_error if !supportsPartialFrames()
+     * @version 1.1
+     */
+    DEFLECT_API void setProgressiveRefinement(bool enabled);
     //@}
 
 private:
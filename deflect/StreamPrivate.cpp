@@ -41,10 +41,20 @@
 
 #include "StreamPrivate.h"
 
+#include "CopyRect.h"
+#include "MessageHeader.h"
+#include "MulticastSender.h"
 #include "NetworkProtocol.h"
+#include "SharedMemoryRing.h"
+#include "Visibility.h"
 
+#include <QDataStream>
 #include <QHostInfo>
 
+#include <algorithm>
+#include <cmath>
+
+#include <iostream>
 #include <sstream>
 #include <stdexcept>
 
@@ -52,9 +62,40 @@ namespace
 {
 const char* STREAM_ID_ENV_VAR = "DEFLECT_ID";
 const char* STREAM_HOST_ENV_VAR = "DEFLECT_HOST";
+const char* STREAM_SHM_ENV_VAR = "DEFLECT_SHM";
+const char* STREAM_SHM_SLOTS_ENV_VAR = "DEFLECT_SHM_SLOTS";
+const char* STREAM_MULTICAST_ENV_VAR = "DEFLECT_MULTICAST";
 
 const unsigned int SEGMENT_SIZE = 512;
 const unsigned int SMALL_IMAGE_SIZE = 64;
+// The server holds the slots until it is done with their frames: the one being
+// received, the one being rendered and the last one kept for partial updates.
+// A 4K frame of raw RGBA is 40 segments, the socket is used once all are held.
+const unsigned int DEFAULT_SHARED_MEMORY_SLOTS = 128;
+const std::chrono::seconds REPLY_TIMEOUT{5};
+const double MIN_QUALITY_FACTOR = 0.5;
+const std::chrono::milliseconds REFINEMENT_DELAY{500};
+const unsigned int REFINED_QUALITY = 100;
+
+bool _isReply(const MessageType type)
+{
+    return type == MESSAGE_TYPE_BIND_EVENTS_REPLY ||
+           type == MESSAGE_TYPE_SHARED_MEMORY_REPLY ||
+           type == MESSAGE_TYPE_MULTICAST_REPLY;
+}
+
+// Messages which may arrive at any time without carrying events
+bool _carriesNoEvents(const MessageType type)
+{
+    return type == MESSAGE_TYPE_VISIBILITY ||
+           type == MESSAGE_TYPE_REQUEST_FULL_FRAME ||
+           type == MESSAGE_TYPE_TILE_FORMATS || _isReply(type);
+}
+
+bool _isUnixSocketHost(const QString& host)
+{
+    return host.startsWith(UNIX_SOCKET_HOST_PREFIX);
+}
 
 std::string _getStreamHost(const std::string& host)
 {
@@ -62,6 +103,9 @@ std::string _getStreamHost(const std::string& host)
         return host;
 
     const auto streamHost = QString(qgetenv(STREAM_HOST_ENV_VAR).constData());
+    if (_isUnixSocketHost(streamHost))
+        return streamHost.toStdString();
+
     const auto list = streamHost.split(':');
     if (list.size() > 0 && !list[0].isEmpty())
         return list[0].toStdString();
@@ -75,6 +119,9 @@ unsigned short _getStreamPort(const unsigned short port)
         return port;
 
     const QString streamHost = qgetenv(STREAM_HOST_ENV_VAR).constData();
+    if (_isUnixSocketHost(streamHost))
+        return DEFAULT_PORT_NUMBER; // unused
+
     const auto list = streamHost.split(':');
     if (list.size() == 1)
         return DEFAULT_PORT_NUMBER;
@@ -90,6 +137,13 @@ unsigned short _getStreamPort(const unsigned short port)
     throw std::runtime_error("No port provided");
 }
 
+unsigned int _getSharedMemorySlots()
+{
+    bool ok = false;
+    const auto slots = qgetenv(STREAM_SHM_SLOTS_ENV_VAR).toUInt(&ok);
+    return ok && slots > 0 ? slots : DEFAULT_SHARED_MEMORY_SLOTS;
+}
+
 std::string _getStreamId(const std::string& id)
 {
     if (!id.empty())
@@ -134,6 +188,51 @@ bool _canSendAsSingleSegment(const ImageWrapper& image)
 {
     return image.width <= SMALL_IMAGE_SIZE && image.height <= SMALL_IMAGE_SIZE;
 }
+
+QRect _getFrameRect(const ImageWrapper& image)
+{
+    const auto width =
+        image.view == View::side_by_side ? image.width / 2 : image.width;
+    return QRect(image.x, image.y, width, image.height);
+}
+
+QSize _getFrameSize(const ImageWrapper& image)
+{
+    const auto rect = _getFrameRect(image);
+    return QSize(rect.x() + rect.width(), rect.y() + rect.height());
+}
+
+// Compression artifacts are less noticeable on images displayed downscaled
+void _adjustQuality(ImageWrapper& image, const double scale)
+{
+    if (image.compressionPolicy != COMPRESSION_ON || scale >= 1.0)
+        return;
+
+    const auto factor = std::max(scale, MIN_QUALITY_FACTOR);
+    const auto quality = std::lround(image.compressionQuality * factor);
+    image.compressionQuality = std::max(1u, unsigned(quality));
+}
+
+Segment _makeCopySegment(const CopyRect& copy)
+{
+    const auto x = int64_t(copy.x) + copy.dx;
+    const auto y = int64_t(copy.y) + copy.dy;
+    if (copy.width == 0 || copy.height == 0 || x < 0 || y < 0)
+        throw std::invalid_argument("Invalid copy rectangle");
+
+    Segment segment;
+    segment.parameters.x = uint32_t(x);
+    segment.parameters.y = uint32_t(y);
+    segment.parameters.width = copy.width;
+    segment.parameters.height = copy.height;
+    segment.parameters.format = Format::copy;
+    const uint32_t source[] = {copy.x, copy.y};
+    segment.imageData = QByteArray((const char*)source, sizeof(source));
+    segment.view = copy.view;
+    segment.rowOrder = copy.rowOrder;
+    segment.channel = copy.channel;
+    return segment;
+}
 }
 
 StreamPrivate::StreamPrivate(const std::string& id_, const std::string& host,
@@ -142,6 +241,7 @@ StreamPrivate::StreamPrivate(const std::string& id_, const std::string& host,
     , socket{_getStreamHost(host), _getStreamPort(port)}
     , sendWorker{socket, id}
     , task{&sendWorker, this}
+    , _segmentTracker{REFINEMENT_DELAY}
 {
     _imageSegmenter.setNominalSegmentDimensions(SEGMENT_SIZE, SEGMENT_SIZE);
 
@@ -150,17 +250,39 @@ StreamPrivate::StreamPrivate(const std::string& id_, const std::string& host,
             disconnectedCallback();
     });
 
+    sendWorker.setIdleTask(task.refineSegments(_segmentTracker, _imageSegmenter,
+                                               REFINED_QUALITY));
     socket.moveToThread(&sendWorker);
     sendWorker.start();
 
     if (observer)
         sendWorker.enqueueRequest(task.openObserver()).wait();
     else
+    {
         sendWorker.enqueueRequest(task.openStream()).wait();
+        const auto multicast = _canUseMulticast() && _openMulticast();
+        if (!multicast && _canUseSharedMemory())
+            _openSharedMemory();
+    }
 }
 
 StreamPrivate::~StreamPrivate()
 {
+    if (_eventThread.joinable())
+    {
+        _stopEventThread = true;
+        socket.interruptWait();
+        _eventThread.join();
+    }
+
+    // The idle task uses members which are destroyed before the sendWorker
+    sendWorker
+        .enqueueRequest([this]() {
+            sendWorker.setIdleTask(IdleTask());
+            return true;
+        })
+        .wait();
+
     if (socket.isConnected())
         sendWorker.enqueueRequest(task.close()).wait();
 }
@@ -181,29 +303,53 @@ Stream::Future StreamPrivate::send(QByteArray&& data)
 }
 
 Stream::Future StreamPrivate::sendImage(const ImageWrapper& image,
-                                        const bool finish)
+                                        const bool finish, const bool partial)
 {
     try
     {
         if (_pendingFinish)
             throw std::runtime_error("Pending finish, no send allowed");
 
+        if (finish && partial)
+            _checkSupportsPartialFrames();
+
         _checkParameters(image);
 
+        // Do not skip any segment when the server asks for a full frame
+        const auto fullFrame = !partial && _takeFullFrameRequest(finish);
+        auto visibility = _getVisibility();
+        if (fullFrame)
+            visibility.regions = Visibility().regions;
+
+        auto adjustedImage = image;
+        _adjustQuality(adjustedImage, visibility.scale);
+
         if (_canSendAsSingleSegment(image))
         {
+            if (!visibility.intersects(_getFrameRect(image)))
+            {
+                _skippedSegments = true;
+                return finish ? sendFinishFrame(partial)
+                              : make_ready_future(true);
+            }
+
             // OPT for OSPRay-KNL with external thread pool - compress directly
             // in caller thread.
-            auto segment = _imageSegmenter.createSingleSegment(image);
+            auto segment = _imageSegmenter.createSingleSegment(adjustedImage);
             // As we expect to encounter a lot of these small sends, be
             // optimistic and fulfill the promise already to reduce load in the
             // send thread (c.f. lock ops performance on KNL).
             sendWorker.enqueueFastRequest(task.send(std::move(segment)));
-            return finish ? sendFinishFrame() : make_ready_future(true);
+            return finish ? sendFinishFrame(partial) : make_ready_future(true);
         }
 
         return sendWorker.enqueueRequest(
-            task.sendUsingMTCompression(image, _imageSegmenter, finish));
+            task.sendUsingMTCompression(adjustedImage, _imageSegmenter,
+                                        _makeSegmentFilter(visibility,
+                                                           adjustedImage,
+                                                           finish && !partial,
+                                                           fullFrame),
+                                        finish, partial));
     }
     catch (...)
     {
@@ -211,15 +357,402 @@ Stream::Future StreamPrivate::sendImage(const ImageWrapper& image,
     }
 }
 
-Stream::Future StreamPrivate::sendFinishFrame()
+Stream::Future StreamPrivate::sendFinishFrame(const bool partial)
 {
+    try
+    {
+        if (partial)
+            _checkSupportsPartialFrames();
+    }
+    catch (...)
+    {
+        return make_exception_future<bool>(std::current_exception());
+    }
+
+    if (!partial)
+        _takeFullFrameRequest(true);
+
     _pendingFinish = true;
-    return sendWorker.enqueueRequest(task.finishFrame(), true);
+    return sendWorker.enqueueRequest(task.finishFrame(partial), true);
+}
+
+Stream::Future StreamPrivate::copyRect(const CopyRect& copy)
+{
+    try
+    {
+        if (_pendingFinish)
+            throw std::runtime_error("Pending finish, no copy allowed");
+
+        if (!supportsCopyRect())
+            throw std::runtime_error("Server does not support copying regions");
+
+        // The tracked segments no longer match the content of the frame
+        std::vector<Task> tasks;
+        tasks.emplace_back(_clearSegmentTracker());
+        tasks.emplace_back(task.send(_makeCopySegment(copy)));
+        return sendWorker.enqueueRequest(std::move(tasks));
+    }
+    catch (...)
+    {
+        return make_exception_future<bool>(std::current_exception());
+    }
+}
+
+bool StreamPrivate::supportsPartialFrames() const
+{
+    return socket.getServerProtocolVersion() >= PARTIAL_FRAME_PROTOCOL_VERSION;
+}
+
+bool StreamPrivate::supportsCopyRect() const
+{
+    return _copiesAccepted;
+}
+
+bool StreamPrivate::supportsSolidSegments() const
+{
+    return _solidSegmentsAccepted;
+}
+
+bool StreamPrivate::isFullFrameRequested() const
+{
+    return _fullFrameRequested;
+}
+
+void StreamPrivate::setProgressiveRefinement(const bool enabled)
+{
+    if (enabled)
+        _checkSupportsPartialFrames();
+
+    // Forget the segments tracked before or sent while it was disabled
+    if (_refinementEnabled.exchange(enabled) != enabled)
+        sendWorker.enqueueFastRequest(_clearSegmentTracker());
+}
+
+void StreamPrivate::_checkSupportsPartialFrames() const
+{
+    if (!supportsPartialFrames())
+        throw std::runtime_error("Server does not support partial frames");
 }
 
 bool StreamPrivate::_finishFrameDone()
 {
+    // Apply the visibility updates from the server to the next frame, even if
+    // the user does not receive the events. Never wait for a user blocked in
+    // waitForEvents(), which receives them anyway.
+    if (!isReceivingEventsAsync())
+    {
+        socket.tryReceiveAvailable([this](const MessageHeader& header,
+                                          const QByteArray& message) {
+            _queueEvents(header, message);
+        });
+    }
     _pendingFinish = false;
     return true;
 }
+
+bool StreamPrivate::_takeSkippedSegments()
+{
+    return _skippedSegments.exchange(false);
+}
+
+bool StreamPrivate::_takeFullFrameRequest(const bool finish)
+{
+    // The request is fulfilled once the full frame is finished
+    return finish ? _fullFrameRequested.exchange(false)
+                  : _fullFrameRequested.load();
+}
+
+Visibility StreamPrivate::_getVisibility() const
+{
+    std::lock_guard<std::mutex> lock(_visibilityMutex);
+    return _visibility;
+}
+
+ImageSegmenter::Filter StreamPrivate::_makeSegmentFilter(
+    const Visibility& visibility, const ImageWrapper& image,
+    const bool wholeFrame, const bool fullFrame)
+{
+    const auto track = _refinementEnabled &&
+                       image.compressionPolicy == COMPRESSION_ON &&
+                       image.view != View::side_by_side;
+    // Only the quality is raised, the subsampling is the same for the whole
+    // frame which the refined segments complete
+    const auto refine = image.compressionQuality < REFINED_QUALITY;
+
+    // Only the images which are a whole frame give its dimensions
+    const auto frameSize = wholeFrame ? _getFrameSize(image) : QSize();
+
+    return [this, visibility, image, track, refine, frameSize,
+            fullFrame](const SegmentParameters& params) {
+        if (track && frameSize.isValid())
+            _segmentTracker.setFrameSize(frameSize);
+
+        const QRect rect(params.x, params.y, params.width, params.height);
+        if (visibility.intersects(rect) &&
+            (!track || _segmentTracker.update(image, params, refine) ||
+             fullFrame))
+        {
+            return true;
+        }
+        _skippedSegments = true;
+        return false;
+    };
+}
+
+Task StreamPrivate::_clearSegmentTracker()
+{
+    return [this]() {
+        _segmentTracker.clear();
+        return true;
+    };
+}
+
+bool StreamPrivate::receiveEvents()
+{
+    return socket.receiveAvailable([this](const MessageHeader& header,
+                                          const QByteArray& message) {
+        _queueEvents(header, message);
+    }) > 0;
+}
+
+bool StreamPrivate::waitForEvents()
+{
+    MessageHeader header;
+    QByteArray message;
+    while (socket.receive(header, message))
+    {
+        const auto count = _queueEvents(header, message);
+        if (!_carriesNoEvents(header.type))
+            return count > 0;
+    }
+    return false;
+}
+
+void StreamPrivate::setEventCallback(std::function<void()> callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(_eventCallbackMutex);
+        _eventCallback = std::move(callback);
+    }
+    if (!_eventThread.joinable())
+        _eventThread = std::thread([this] { _receiveEventsLoop(); });
+}
+
+bool StreamPrivate::isReceivingEventsAsync() const
+{
+    return _eventThread.joinable();
+}
+
+size_t StreamPrivate::_queueEvents(const MessageHeader& header,
+                                   const QByteArray& message)
+{
+    if (header.type == MESSAGE_TYPE_QUIT)
+        return 0;
+
+    if (_isReply(header.type))
+    {
+        {
+            std::lock_guard<std::mutex> lock(_repliesMutex);
+            _replies[header.type] = message;
+        }
+        _replyReceived.notify_all();
+        return 0;
+    }
+
+    if (header.type == MESSAGE_TYPE_VISIBILITY)
+    {
+        try
+        {
+            auto visibility = deserializeVisibility(message);
+            std::lock_guard<std::mutex> lock(_visibilityMutex);
+            _visibility = std::move(visibility);
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << "deflect::Stream: " << e.what() << std::endl;
+        }
+        return 0;
+    }
+
+    if (header.type == MESSAGE_TYPE_REQUEST_FULL_FRAME)
+    {
+        _fullFrameRequested = true;
+        return 0;
+    }
+
+    if (header.type == MESSAGE_TYPE_TILE_FORMATS)
+    {
+        _acceptTileFormats(message);
+        return 0;
+    }
+
+    if (header.type == MESSAGE_TYPE_EVENTS)
+    {
+        try
+        {
+            const auto batch = deserializeEvents(message);
+            events.enqueue_bulk(batch.begin(), batch.size());
+            return batch.size();
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << "deflect::Stream: " << e.what() << std::endl;
+            return 0;
+        }
+    }
+
+    if (header.type != MESSAGE_TYPE_EVENT ||
+        size_t(message.size()) != Event::serializedSize)
+    {
+        std::cerr << "deflect::Stream: received unexpected message type ("
+                  << int(header.type) << ")" << std::endl;
+        return 0;
+    }
+
+    Event event;
+    {
+        QDataStream stream(message);
+        stream >> event;
+    }
+    events.enqueue(std::move(event));
+    return 1;
+}
+
+bool StreamPrivate::receiveReply(const MessageType type, QByteArray& reply)
+{
+    if (isReceivingEventsAsync())
+    {
+        std::unique_lock<std::mutex> lock(_repliesMutex);
+        if (!_replyReceived.wait_for(lock, REPLY_TIMEOUT, [&] {
+                return _replies.count(type) > 0;
+            }))
+        {
+            return false;
+        }
+        reply = _replies[type];
+        _replies.erase(type);
+        return true;
+    }
+
+    MessageHeader header;
+    while (socket.receive(header, reply))
+    {
+        if (header.type == type)
+            return true;
+        _queueEvents(header, reply);
+    }
+    return false;
+}
+
+void StreamPrivate::_acceptTileFormats(const QByteArray& message)
+{
+    for (const auto format : message)
+    {
+        if (Format(format) == Format::solid)
+        {
+            _solidSegmentsAccepted = true;
+            _imageSegmenter.setSolidSegmentsEnabled(true);
+        }
+        else if (Format(format) == Format::copy)
+            _copiesAccepted = true;
+    }
+}
+
+void StreamPrivate::_receiveEventsLoop()
+{
+    while (!_stopEventThread && socket.isConnected())
+    {
+        socket.waitForData();
+        if (!_stopEventThread && receiveEvents())
+            _notifyEvents();
+    }
+    if (!_stopEventThread)
+        _notifyEvents(); // let the user know about the disconnection
+}
+
+void StreamPrivate::_notifyEvents()
+{
+    std::lock_guard<std::mutex> lock(_eventCallbackMutex);
+    if (_eventCallback)
+        _eventCallback();
+}
+
+bool StreamPrivate::_canUseMulticast() const
+{
+    return socket.getServerProtocolVersion() >= MULTICAST_PROTOCOL_VERSION &&
+           qgetenv(STREAM_MULTICAST_ENV_VAR) != "0";
+}
+
+bool StreamPrivate::_openMulticast()
+{
+    if (!sendWorker.enqueueRequest(task.openMulticast()).get())
+        return false;
+
+    // The server replies with the address:port of its group, empty if none
+    QByteArray message;
+    if (!receiveReply(MESSAGE_TYPE_MULTICAST_REPLY, message) ||
+        message.isEmpty())
+    {
+        return false;
+    }
+
+    const auto group = QString::fromUtf8(message);
+    const auto separator = group.lastIndexOf(':');
+    bool ok = false;
+    const auto port = group.mid(separator + 1).toUShort(&ok);
+    if (separator < 0 || !ok)
+        return false;
+
+    try
+    {
+        const auto address = QHostAddress(group.left(separator));
+        sendWorker.setMulticast(std::unique_ptr<MulticastSender>(
+            new MulticastSender(address, port,
+                                [this] { _fullFrameRequested = true; })));
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << "deflect::Stream: not using multicast group "
+                  << group.toStdString() << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    // Announce the stream to the receivers of the group
+    sendWorker.enqueueRequest(task.openStream()).wait();
+    return true;
+}
+
+bool StreamPrivate::_canUseSharedMemory() const
+{
+    return socket.getServerProtocolVersion() >=
+               SHARED_MEMORY_PROTOCOL_VERSION &&
+           qgetenv(STREAM_SHM_ENV_VAR) != "0" && socket.isLocal();
+}
+
+void StreamPrivate::_openSharedMemory()
+{
+    std::unique_ptr<SharedMemoryRing> ring;
+    try
+    {
+        ring.reset(new SharedMemoryRing(id, _getSharedMemorySlots(),
+                                        SEGMENT_SIZE * SEGMENT_SIZE * 4));
+    }
+    catch (const std::exception&)
+    {
+        return; // continue with the socket only
+    }
+
+    if (!sendWorker.enqueueRequest(task.openSharedMemory(ring->getKey())).get())
+        return;
+
+    // The server replies after trying to attach to the shared memory
+    QByteArray message;
+    if (!receiveReply(MESSAGE_TYPE_SHARED_MEMORY_REPLY, message) ||
+        message.size() != sizeof(bool))
+    {
+        return;
+    }
+    if (*reinterpret_cast<const bool*>(message.constData()))
+        sendWorker.setSharedMemory(std::move(ring));
+}
 }
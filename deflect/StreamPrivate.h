@@ -43,12 +43,21 @@
 #define DEFLECT_STREAMPRIVATE_H
 
 #include "ImageSegmenter.h"   // member
+#include "MessageHeader.h"    // MessageType
+#include "SegmentTracker.h"   // member
 #include "Socket.h"           // member
 #include "StreamSendWorker.h" // member
 #include "TaskBuilder.h"      // member
+#include "Visibility.h"       // member
 
+#include "moodycamel/blockingconcurrentqueue.h"
+
+#include <condition_variable>
 #include <functional>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace deflect
 {
@@ -96,14 +105,115 @@ public:
     /** Remember a pending finishFrame where no sendImage() is allowed. */
     std::atomic_bool _pendingFinish{false};
 
+    /** The received events, waiting to be retrieved by the user. */
+    moodycamel::BlockingConcurrentQueue<Event> events;
+
+    /**
+     * Queue all the events already received by the socket, without blocking.
+     * @return true if new events were queued.
+     */
+    bool receiveEvents();
+
+    /**
+     * Wait for the next event message and queue its events.
+     * @return true if new events were queued, false on timeout or error.
+     */
+    bool waitForEvents();
+
+    /**
+     * Receive the events in a background thread from now on.
+     * @param callback called from the background thread when new events are
+     *        queued, or when the socket gets disconnected.
+     */
+    void setEventCallback(std::function<void()> callback);
+
+    /** @return true if the events are received by the background thread. */
+    bool isReceivingEventsAsync() const;
+
+    /**
+     * Wait for the reply to a request, queuing the other messages received
+     * meanwhile like events.
+     *
+     * When the events are received asynchronously, the reply is handed over
+     * by the background thread.
+     * @return true if the reply was received, false on timeout or error.
+     */
+    bool receiveReply(MessageType type, QByteArray& reply);
+
     Stream::Future bindEvents(bool exclusive);
     Stream::Future send(const SizeHints& hints);
     Stream::Future send(QByteArray&& data);
-    Stream::Future sendImage(const ImageWrapper& image, bool finish);
-    Stream::Future sendFinishFrame();
+    Stream::Future sendImage(const ImageWrapper& image, bool finish,
+                             bool partial = false);
+    Stream::Future sendFinishFrame(bool partial = false);
+    Stream::Future copyRect(const CopyRect& copy);
+
+    /** @return true if the server can receive partial frames. */
+    bool supportsPartialFrames() const;
+
+    /** @return true if the server accepts copies of its previous frame. */
+    bool supportsCopyRect() const;
+
+    /** @return true if the server accepts the segments in Format::solid. */
+    bool supportsSolidSegments() const;
+
+    /** @return true if the server asked for a full frame. */
+    bool isFullFrameRequested() const;
+
+    /**
+     * Skip the unchanged segments and refine the static ones in the idle time
+     * of the sendWorker.
+     * @throw std::runtime_error if !supportsPartialFrames()
+     */
+    void setProgressiveRefinement(bool enabled);
 
     /** @internal Called by StreamSendWorker when finishFrame was processed. */
     bool _finishFrameDone();
+
+    /**
+     * @internal Called by StreamSendWorker when finishing a frame.
+     * @return true if segments were skipped since the last finished frame.
+     */
+    bool _takeSkippedSegments();
+
+private:
+    std::thread _eventThread;
+    std::atomic_bool _stopEventThread{false};
+    std::function<void()> _eventCallback;
+    std::mutex _eventCallbackMutex;
+
+    std::map<MessageType, QByteArray> _replies;
+    std::mutex _repliesMutex;
+    std::condition_variable _replyReceived;
+
+    Visibility _visibility;
+    mutable std::mutex _visibilityMutex;
+    std::atomic_bool _skippedSegments{false};
+    std::atomic_bool _fullFrameRequested{false};
+
+    /** The formats beyond JPEG and raw which the server application accepts */
+    std::atomic_bool _solidSegmentsAccepted{false};
+    std::atomic_bool _copiesAccepted{false};
+
+    /** Only used from the sendWorker thread. */
+    SegmentTracker _segmentTracker;
+    std::atomic_bool _refinementEnabled{false};
+
+    bool _canUseMulticast() const;
+    bool _canUseSharedMemory() const;
+    void _checkSupportsPartialFrames() const;
+    Visibility _getVisibility() const;
+    ImageSegmenter::Filter _makeSegmentFilter(const Visibility& visibility,
+                                              const ImageWrapper& image,
+                                              bool wholeFrame, bool fullFrame);
+    bool _takeFullFrameRequest(bool finish);
+    Task _clearSegmentTracker();
+    bool _openMulticast();
+    void _openSharedMemory();
+    size_t _queueEvents(const MessageHeader& header, const QByteArray& message);
+    void _acceptTileFormats(const QByteArray& message);
+    void _receiveEventsLoop();
+    void _notifyEvents();
 };
 }
 #endif
@@ -40,14 +40,38 @@
 
 #include "StreamSendWorker.h"
 
+#include "MulticastSender.h"
 #include "NetworkProtocol.h"
 #include "Segment.h"
+#include "SharedMemoryRing.h"
 #include "SizeHints.h"
 
+#include <cstring>
 #include <iostream>
 
 namespace deflect
 {
+namespace
+{
+// Messages which the receivers of a multicast group need to compose frames
+bool _isMulticastMessage(const MessageType type)
+{
+    switch (type)
+    {
+    case MESSAGE_TYPE_PIXELSTREAM_OPEN:
+    case MESSAGE_TYPE_PIXELSTREAM:
+    case MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME:
+    case MESSAGE_TYPE_PIXELSTREAM_FINISH_PARTIAL_FRAME:
+    case MESSAGE_TYPE_IMAGE_VIEW:
+    case MESSAGE_TYPE_IMAGE_ROW_ORDER:
+    case MESSAGE_TYPE_IMAGE_CHANNEL:
+        return true;
+    default:
+        return false;
+    }
+}
+}
+
 StreamSendWorker::StreamSendWorker(Socket& socket, const std::string& id)
     : _socket(socket)
     , _id(id)
@@ -88,8 +112,7 @@ void StreamSendWorker::run()
 
         size_t count = 0;
         if (!_pendingFinish)
-            count = _requests.wait_dequeue_bulk(_dequeuedRequests.begin(),
-                                                _dequeuedRequests.size());
+            count = _dequeueRequests();
         else
         {
             // in case we encountered a finish request, get all remaining send
@@ -152,6 +175,30 @@ void StreamSendWorker::run()
             }
         }
     }
+
+    // Close the sockets of the multicast sender from the thread using them
+    _multicast.reset();
+}
+
+size_t StreamSendWorker::_dequeueRequests()
+{
+    const auto first = _dequeuedRequests.begin();
+    const auto max = _dequeuedRequests.size();
+
+    if (!_idleTask || _frameStarted)
+        return _requests.wait_dequeue_bulk(first, max);
+
+    const auto count = _requests.try_dequeue_bulk(first, max);
+    if (count > 0)
+        return count;
+
+    // Check the requests again after each execution of the idle task
+    const auto delay = _idleTask();
+    if (delay.count() == 0)
+        return 0;
+    if (delay.count() < 0)
+        return _requests.wait_dequeue_bulk(first, max);
+    return _requests.wait_dequeue_bulk_timed(first, max, delay);
 }
 
 Stream::Future StreamSendWorker::enqueueRequest(Task&& action, bool isFinish)
@@ -173,6 +220,21 @@ void StreamSendWorker::enqueueFastRequest(Task&& task)
     _requests.enqueue({nullptr, std::vector<Task>{std::move(task)}, false});
 }
 
+void StreamSendWorker::setSharedMemory(std::unique_ptr<SharedMemoryRing> ring)
+{
+    _sharedMemory = std::move(ring);
+}
+
+void StreamSendWorker::setMulticast(std::unique_ptr<MulticastSender> sender)
+{
+    _multicast = std::move(sender);
+}
+
+void StreamSendWorker::setIdleTask(IdleTask task)
+{
+    _idleTask = std::move(task);
+}
+
 bool StreamSendWorker::_sendOpenObserver()
 {
     return _send(MESSAGE_TYPE_OBSERVER_OPEN,
@@ -187,11 +249,30 @@ bool StreamSendWorker::_sendOpenStream()
 
 bool StreamSendWorker::_sendClose()
 {
+    // The receivers of the multicast group must also remove the source
+    if (_multicast)
+        _multicast->send(MessageHeader(MESSAGE_TYPE_QUIT, 0, _id), {});
     return _send(MESSAGE_TYPE_QUIT, {});
 }
 
+bool StreamSendWorker::_sendOpenSharedMemory(const std::string& key)
+{
+    return _send(MESSAGE_TYPE_SHARED_MEMORY_OPEN,
+                 QByteArray::fromStdString(key));
+}
+
+bool StreamSendWorker::_sendOpenMulticast()
+{
+    return _send(MESSAGE_TYPE_MULTICAST_OPEN, {});
+}
+
 bool StreamSendWorker::_sendSegment(const Segment& segment)
 {
+    // The receivers joining a multicast group need the state of each frame
+    if (_multicast && !_frameStarted && !_sendImageState(segment))
+        return false;
+
+    _frameStarted = true;
     if (segment.view != _currentView)
     {
         if (!_sendImageView(segment.view))
@@ -201,12 +282,56 @@ bool StreamSendWorker::_sendSegment(const Segment& segment)
     _sendRowOrderIfChanged(segment.rowOrder);
     _sendImageChannelIfChanged(segment.channel);
 
+    if (_canUseSharedMemory(segment))
+    {
+        // fall back to the socket if the server still holds all the slots
+        const auto slot = _sharedMemory->acquireSlot();
+        if (slot >= 0)
+            return _sendSharedMemorySegment(segment, slot);
+    }
+
     auto message = QByteArray{(const char*)(&segment.parameters),
                               sizeof(SegmentParameters)};
     message.append(segment.imageData);
     return _send(MESSAGE_TYPE_PIXELSTREAM, message, false);
 }
 
+bool StreamSendWorker::_canUseSharedMemory(const Segment& segment) const
+{
+    return _sharedMemory && segment.parameters.format == Format::rgba &&
+           uint32_t(segment.imageData.size()) <= _sharedMemory->getSlotSize();
+}
+
+bool StreamSendWorker::_sendSharedMemorySegment(const Segment& segment,
+                                                const uint32_t slot)
+{
+    SharedMemorySlot ref;
+    ref.index = slot;
+    ref.size = segment.imageData.size();
+    std::memcpy(_sharedMemory->getSlotData(slot), segment.imageData.constData(),
+                ref.size);
+    _sharedMemory->publishSlot(slot);
+
+    auto message = QByteArray{(const char*)(&segment.parameters),
+                              sizeof(SegmentParameters)};
+    message.append((const char*)(&ref), sizeof(SharedMemorySlot));
+    return _send(MESSAGE_TYPE_PIXELSTREAM_SHARED_MEMORY, message, false);
+}
+
+bool StreamSendWorker::_sendImageState(const Segment& segment)
+{
+    if (!_sendImageView(segment.view) ||
+        !_sendImageRowOrder(segment.rowOrder) ||
+        !_sendImageChannel(segment.channel))
+    {
+        return false;
+    }
+    _currentView = segment.view;
+    _currentRowOrder = segment.rowOrder;
+    _currentChannel = segment.channel;
+    return true;
+}
+
 bool StreamSendWorker::_sendImageView(const View view)
 {
     return _send(MESSAGE_TYPE_IMAGE_VIEW,
@@ -247,9 +372,12 @@ bool StreamSendWorker::_sendImageChannel(const uint8_t channel)
                  QByteArray{(const char*)(&channel), sizeof(uint8_t)});
 }
 
-bool StreamSendWorker::_sendFinish()
+bool StreamSendWorker::_sendFinish(const bool partial)
 {
-    return _send(MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME, {});
+    _frameStarted = false;
+    return _send(partial ? MESSAGE_TYPE_PIXELSTREAM_FINISH_PARTIAL_FRAME
+                         : MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME,
+                 {});
 }
 
 bool StreamSendWorker::_sendData(const QByteArray data)
@@ -273,7 +401,9 @@ bool StreamSendWorker::_sendBindEvents(const bool exclusive)
 bool StreamSendWorker::_send(const MessageType type, const QByteArray& message,
                              const bool waitForBytesWritten)
 {
-    return _socket.send(MessageHeader(type, message.size(), _id), message,
-                        waitForBytesWritten);
+    const MessageHeader header(type, message.size(), _id);
+    if (_multicast && _isMulticastMessage(type))
+        return _multicast->send(header, message);
+    return _socket.send(header, message, waitForBytesWritten);
 }
 }
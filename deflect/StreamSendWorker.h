@@ -56,10 +56,23 @@
 
 #include <QThread>
 
+#include <chrono>
+#include <functional>
+
 namespace deflect
 {
+class MulticastSender;
+class SharedMemoryRing;
+
 using Task = std::function<bool()>;
 
+/**
+ * Task executed when the worker is idle.
+ * @return the time after which to execute it again if the worker is still
+ *         idle, negative to wait for the next request.
+ */
+using IdleTask = std::function<std::chrono::milliseconds()>;
+
 /**
  * Worker thread class that sends images and messages through a Socket.
  *
@@ -73,21 +86,43 @@ class StreamSendWorker : public QThread
 {
 public:
     /** Create a new stream worker associated to an existing socket. */
-    StreamSendWorker(Socket& socket, const std::string& id);
+    DEFLECT_API StreamSendWorker(Socket& socket, const std::string& id);
 
     /** Stop and destroy the worker. */
-    ~StreamSendWorker();
+    DEFLECT_API ~StreamSendWorker();
 
     /** Enqueue a request to be send during the execution of run(). */
-    Stream::Future enqueueRequest(Task&& action, bool isFinish = false);
+    DEFLECT_API Stream::Future enqueueRequest(Task&& action,
+                                              bool isFinish = false);
 
     /** Enqueue a request to be send during the execution of run(). */
-    Stream::Future enqueueRequest(std::vector<Task>&& actions,
-                                  bool isFinish = false);
+    DEFLECT_API Stream::Future enqueueRequest(std::vector<Task>&& actions,
+                                              bool isFinish = false);
 
     /** Enqueue a request with no future to check for its completion. */
     void enqueueFastRequest(Task&& task);
 
+    /**
+     * Send the raw image segments through shared memory, once the server has
+     * attached to it. Must be called before sending images.
+     */
+    void setSharedMemory(std::unique_ptr<SharedMemoryRing> ring);
+
+    /**
+     * Send the pixel stream messages to a multicast group instead of the
+     * socket, once the server has provided it. Must be called before sending
+     * images.
+     */
+    void setMulticast(std::unique_ptr<MulticastSender> sender);
+
+    /**
+     * Set a task to execute when no request is queued and no frame is being
+     * sent, i.e. no segment was sent since the last finish. It must send its
+     * own complete frames and be short, as it delays the next request. Must be
+     * called before starting the worker.
+     */
+    DEFLECT_API void setIdleTask(IdleTask task);
+
 private:
     using Promise = std::promise<bool>;
     using PromisePtr = std::shared_ptr<Promise>;
@@ -112,25 +147,39 @@ private:
     bool _pendingFinish = false;
     Request _finishRequest;
 
+    IdleTask _idleTask;
+    bool _frameStarted = false;
+
+    std::unique_ptr<SharedMemoryRing> _sharedMemory;
+    std::unique_ptr<MulticastSender> _multicast;
+
     /** Stop the worker and clear any pending send tasks. */
     void stop();
 
     /** Main QThread loop doing asynchronous processing of queued tasks. */
     void run() final;
 
+    /** Dequeue the next requests, executing the idle task while waiting. */
+    size_t _dequeueRequests();
+
     friend class deflect::test::Application; // to send pre-compressed segments
     friend class TaskBuilder;
 
     bool _sendOpenObserver();
     bool _sendOpenStream();
     bool _sendClose();
+    bool _sendOpenSharedMemory(const std::string& key);
+    bool _sendOpenMulticast();
     bool _sendSegment(const Segment& segment);
+    bool _canUseSharedMemory(const Segment& segment) const;
+    bool _sendSharedMemorySegment(const Segment& segment, uint32_t slot);
+    bool _sendImageState(const Segment& segment);
     bool _sendImageView(View view);
     bool _sendRowOrderIfChanged(RowOrder rowOrder);
     bool _sendImageRowOrder(RowOrder rowOrder);
     bool _sendImageChannelIfChanged(uint8_t channel);
     bool _sendImageChannel(uint8_t channel);
-    bool _sendFinish();
+    bool _sendFinish(bool partial);
     bool _sendData(const QByteArray data);
     bool _sendSizeHints(const SizeHints& hints);
     bool _sendBindEvents(const bool exclusive);
@@ -40,9 +40,12 @@
 #include "TaskBuilder.h"
 
 #include "ImageSegmenter.h"
+#include "ImageWrapper.h"
 #include "SizeHints.h"
 #include "StreamPrivate.h"
 
+#include <iostream>
+
 namespace deflect
 {
 TaskBuilder::TaskBuilder(StreamSendWorker* worker, StreamPrivate* stream)
@@ -66,6 +69,16 @@ Task TaskBuilder::openObserver()
     return std::bind(&StreamSendWorker::_sendOpenObserver, _worker);
 }
 
+Task TaskBuilder::openSharedMemory(const std::string& key)
+{
+    return std::bind(&StreamSendWorker::_sendOpenSharedMemory, _worker, key);
+}
+
+Task TaskBuilder::openMulticast()
+{
+    return std::bind(&StreamSendWorker::_sendOpenMulticast, _worker);
+}
+
 Task TaskBuilder::bindEvents(const bool exclusive)
 {
     return std::bind(&StreamSendWorker::_sendBindEvents, _worker, exclusive);
@@ -83,39 +96,72 @@ Task TaskBuilder::send(const QByteArray& data)
 
 std::vector<Task> TaskBuilder::sendUsingMTCompression(
     const ImageWrapper& image, ImageSegmenter& imageSegmenter,
-    const bool finish)
+    ImageSegmenter::Filter filter, const bool finish, const bool partial)
 {
     std::vector<Task> tasks;
-    tasks.emplace_back(send(image, imageSegmenter));
+    tasks.emplace_back(send(image, imageSegmenter, std::move(filter)));
     if (finish)
     {
-        auto finishTasks = finishFrame();
+        auto finishTasks = finishFrame(partial);
         tasks.insert(tasks.end(), std::make_move_iterator(finishTasks.begin()),
                      std::make_move_iterator(finishTasks.end()));
     }
     return tasks;
 }
 
-std::vector<Task> TaskBuilder::finishFrame()
+std::vector<Task> TaskBuilder::finishFrame(const bool partial)
 {
     std::vector<Task> tasks;
-    tasks.emplace_back(std::bind(&StreamSendWorker::_sendFinish, _worker));
+    // Skipped invisible segments must not replace the ones of previous frames
+    auto worker = _worker;
+    auto stream = _stream;
+    tasks.emplace_back([worker, stream, partial]() {
+        return worker->_sendFinish(partial || stream->_takeSkippedSegments());
+    });
     tasks.emplace_back(std::bind(&StreamPrivate::_finishFrameDone, _stream));
     return tasks;
 }
 
+IdleTask TaskBuilder::refineSegments(SegmentTracker& tracker,
+                                     ImageSegmenter& imageSegmenter,
+                                     const unsigned int quality)
+{
+    // Each refined segment is sent as its own partial frame
+    auto worker = _worker;
+    return [worker, &tracker, &imageSegmenter, quality]() {
+        SegmentTracker::Refinement refinement;
+        if (!tracker.takeRefinement(refinement))
+            return tracker.getTimeToNextRefinement();
+
+        try
+        {
+            const auto image = refinement.makeImage(quality);
+            const auto segment = imageSegmenter.createSingleSegment(image);
+            if (worker->_sendSegment(segment))
+                worker->_sendFinish(true);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "deflect::Stream: segment refinement failed: "
+                      << e.what() << std::endl;
+        }
+        return std::chrono::milliseconds(0);
+    };
+}
+
 Task TaskBuilder::send(Segment&& segment)
 {
     return std::bind(&StreamSendWorker::_sendSegment, _worker, segment);
 }
 
 Task TaskBuilder::send(const ImageWrapper& image,
-                       ImageSegmenter& imageSegmenter)
+                       ImageSegmenter& imageSegmenter,
+                       ImageSegmenter::Filter filter)
 {
     auto sendFunc = std::bind(&StreamSendWorker::_sendSegment, _worker,
                               std::placeholders::_1);
-    return [&imageSegmenter, image, sendFunc]() {
-        return imageSegmenter.generate(image, sendFunc);
+    return [&imageSegmenter, image, sendFunc, filter]() {
+        return imageSegmenter.generate(image, sendFunc, filter);
     };
 }
 }
@@ -40,6 +40,8 @@
 #ifndef DEFLECT_TASKBUILDER_H
 #define DEFLECT_TASKBUILDER_H
 
+#include "ImageSegmenter.h"
+#include "SegmentTracker.h"
 #include "StreamSendWorker.h"
 #include "types.h"
 
@@ -55,22 +57,28 @@ public:
 
     Task openStream();
     Task openObserver();
+    Task openSharedMemory(const std::string& key);
+    Task openMulticast();
     Task bindEvents(bool exclusive);
     Task close();
 
     Task send(const SizeHints& hints);
     Task send(const QByteArray& data);
     Task send(Segment&& segment);
-    std::vector<Task> sendUsingMTCompression(const ImageWrapper& image,
-                                             ImageSegmenter& imageSegmenter,
-                                             bool finish);
-    std::vector<Task> finishFrame();
+    std::vector<Task> sendUsingMTCompression(
+        const ImageWrapper& image, ImageSegmenter& imageSegmenter,
+        ImageSegmenter::Filter filter, bool finish, bool partial);
+    std::vector<Task> finishFrame(bool partial);
+    IdleTask refineSegments(SegmentTracker& tracker,
+                            ImageSegmenter& imageSegmenter,
+                            unsigned int quality);
 
 private:
     StreamSendWorker* _worker = nullptr;
     StreamPrivate* _stream = nullptr;
 
-    Task send(const ImageWrapper& image, ImageSegmenter& imageSegmenter);
+    Task send(const ImageWrapper& image, ImageSegmenter& imageSegmenter,
+              ImageSegmenter::Filter filter);
 };
 }
 
@@ -0,0 +1,99 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "Visibility.h"
+
+#include <QDataStream>
+
+#include <stdexcept>
+
+namespace deflect
+{
+bool Visibility::intersects(const QRect& rect) const
+{
+    for (const auto& region : regions)
+    {
+        if (region.intersects(rect))
+            return true;
+    }
+    return false;
+}
+
+QByteArray serializeVisibility(const Visibility& visibility)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << quint32(visibility.regions.size());
+    for (const auto& region : visibility.regions)
+    {
+        stream << qint32(region.x()) << qint32(region.y())
+               << qint32(region.width()) << qint32(region.height());
+    }
+    stream << visibility.scale;
+    return data;
+}
+
+Visibility deserializeVisibility(const QByteArray& data)
+{
+    QDataStream stream(data);
+
+    quint32 count = 0;
+    stream >> count;
+    if (stream.status() != QDataStream::Ok ||
+        size_t(data.size()) < sizeof(quint32) + count * 4 * sizeof(qint32))
+    {
+        throw std::runtime_error("Corrupted visibility message");
+    }
+
+    Visibility visibility;
+    visibility.regions.clear();
+    visibility.regions.reserve(count);
+    for (quint32 i = 0; i < count; ++i)
+    {
+        qint32 x, y, width, height;
+        stream >> x >> y >> width >> height;
+        visibility.regions.emplace_back(x, y, width, height);
+    }
+    stream >> visibility.scale;
+
+    if (stream.status() != QDataStream::Ok)
+        throw std::runtime_error("Corrupted visibility message");
+    return visibility;
+}
+}
@@ -0,0 +1,86 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_VISIBILITY_H
+#define DEFLECT_VISIBILITY_H
+
+#include <deflect/api.h>
+
+#include <QByteArray>
+#include <QRect>
+
+#include <limits>
+#include <vector>
+
+namespace deflect
+{
+/**
+ * The parts of a stream's image which are currently displayed by the Server.
+ *
+ * Sent from the Server to the Stream, which uses it to skip the segments of
+ * its images which are not visible and to lower the quality of the images
+ * which are displayed at a reduced scale.
+ */
+struct Visibility
+{
+    /**
+     * The visible regions in pixel coordinates of the frame, none if the frame
+     * is not visible at all. By default the whole frame is visible.
+     */
+    std::vector<QRect> regions{QRect{0, 0, std::numeric_limits<int>::max(),
+                                     std::numeric_limits<int>::max()}};
+
+    /** The ratio between the displayed and the actual size of the frame. */
+    double scale = 1.0;
+
+    /** @return true if any part of the given rectangle is visible. */
+    DEFLECT_API bool intersects(const QRect& rect) const;
+};
+
+/** Serialize a Visibility for sending it in a network message. */
+DEFLECT_API QByteArray serializeVisibility(const Visibility& visibility);
+
+/**
+ * Deserialize a Visibility written by serializeVisibility().
+ * @throw std::runtime_error if the data is corrupted.
+ */
+DEFLECT_API Visibility deserializeVisibility(const QByteArray& data);
+}
+
+#endif
@@ -49,21 +49,19 @@ namespace qt
 EventReceiver::EventReceiver(Stream& stream)
     : QObject()
     , _stream(stream)
-    , _notifier(
-          new QSocketNotifier(_stream.getDescriptor(), QSocketNotifier::Read))
-    , _timer(new QTimer)
 {
-    connect(_notifier.get(), &QSocketNotifier::activated, this,
-            &EventReceiver::_onEvent);
-
-    // QSocketNotifier sometimes does not fire, help with a timer
-    connect(_timer.get(), &QTimer::timeout,
-            [this] { _onEvent(_stream.getDescriptor()); });
-    _timer->start(1);
+    // Called from the stream's event thread; a single queued call processes
+    // all the events which arrived in the meantime.
+    _stream.setEventCallback([this] {
+        if (!_processEventsPending.exchange(true))
+            QMetaObject::invokeMethod(this, "_processEvents",
+                                      Qt::QueuedConnection);
+    });
 }
 
 EventReceiver::~EventReceiver()
 {
+    _stream.setEventCallback(std::function<void()>());
 }
 
 inline QPointF _pos(const Event& deflectEvent)
@@ -71,15 +69,14 @@ inline QPointF _pos(const Event& deflectEvent)
     return QPointF{deflectEvent.mouseX, deflectEvent.mouseY};
 }
 
-void EventReceiver::_onEvent(const int socket)
+void EventReceiver::_processEvents()
 {
-    if (socket != _stream.getDescriptor())
+    _processEventsPending = false;
+    if (_stopped)
         return;
 
-    while (_stream.hasEvent())
+    for (const auto& deflectEvent : _stream.getEvents())
     {
-        const Event& deflectEvent = _stream.getEvent();
-
         switch (deflectEvent.type)
         {
         case Event::EVT_CLOSE:
@@ -141,8 +138,7 @@ void EventReceiver::_onEvent(const int socket)
 
 void EventReceiver::_stop()
 {
-    _notifier->setEnabled(false);
-    _timer->stop();
+    _stopped = true;
     emit closed();
 }
 }
@@ -44,11 +44,11 @@
 #include <QObject>
 #include <QPointF>
 #include <QSize>
-#include <QSocketNotifier>
-#include <QTimer>
 
 #include <deflect/Stream.h>
 
+#include <atomic>
+
 namespace deflect
 {
 namespace qt
@@ -81,12 +81,14 @@ signals:
     void touchPointUpdated(int id, QPointF position);
     void touchPointRemoved(int id, QPointF position);
 
+private slots:
+    void _processEvents();
+
 private:
     Stream& _stream;
-    std::unique_ptr<QSocketNotifier> _notifier;
-    std::unique_ptr<QTimer> _timer;
+    std::atomic_bool _processEventsPending{false};
+    bool _stopped = false;
 
-    void _onEvent(int socket);
     void _stop();
 };
 }
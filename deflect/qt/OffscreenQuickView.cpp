@@ -41,7 +41,9 @@
 #include "OffscreenQuickView.h"
 
 #include "QuickRenderer.h"
+#include "RenderContext.h"
 
+#include <QMetaMethod>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
 #include <QQmlComponent>
@@ -50,6 +52,8 @@
 #include <QQuickRenderControl>
 #include <QThread>
 
+#include <algorithm>
+
 namespace deflect
 {
 namespace qt
@@ -78,12 +82,22 @@ OffscreenQuickView::OffscreenQuickView(
             &OffscreenQuickView::_requestRender);
 }
 
+OffscreenQuickView::OffscreenQuickView(
+    std::unique_ptr<QQuickRenderControl> renderControl,
+    std::shared_ptr<RenderContext> renderContext)
+    : OffscreenQuickView{std::move(renderControl), RenderMode::MULTITHREADED}
+{
+    if (!renderContext)
+        throw std::invalid_argument("Invalid render context");
+    _renderContext = std::move(renderContext);
+}
+
 OffscreenQuickView::~OffscreenQuickView()
 {
     killTimer(_renderTimer);
     _renderTimer = 0;
-    killTimer(_stopRenderingDelayTimer);
-    _stopRenderingDelayTimer = 0;
+    killTimer(_flushTimer);
+    _flushTimer = 0;
 
     if (_quickRenderer)
         _quickRenderer->stop();
@@ -93,6 +107,14 @@ OffscreenQuickView::~OffscreenQuickView()
         _quickRendererThread->quit();
         _quickRendererThread->wait();
     }
+    else if (_renderContext && _quickRenderer)
+    {
+        // The shared render thread keeps running, delete the renderer there.
+        // The renderer does not own the context, so that the last reference
+        // is always released here: ~RenderContext must not run in the render
+        // thread which it stops, and it processes the deletion first.
+        _quickRenderer.release()->deleteLater();
+    }
 
     // delete first to free scenegraph resources for following destructions
     _renderControl.reset();
@@ -119,16 +141,77 @@ QQmlContext* OffscreenQuickView::getRootContext() const
     return _qmlEngine->rootContext();
 }
 
+void OffscreenQuickView::setMaxFrameRate(const unsigned int fps)
+{
+    _maxFrameRate = fps;
+}
+
+void OffscreenQuickView::holdRendering()
+{
+    _renderingHeld = true;
+}
+
+void OffscreenQuickView::resumeRendering()
+{
+    _renderingHeld = false;
+
+    if (_renderPending)
+    {
+        _renderPending = false;
+        _requestRender();
+    }
+}
+
 void OffscreenQuickView::timerEvent(QTimerEvent* e)
 {
     if (e->timerId() == _renderTimer)
-        _render();
-    else if (e->timerId() == _stopRenderingDelayTimer)
     {
         killTimer(_renderTimer);
-        killTimer(_stopRenderingDelayTimer);
         _renderTimer = 0;
-        _stopRenderingDelayTimer = 0;
+        if (_renderingHeld)
+            _renderPending = true;
+        else
+            _render();
+    }
+    else if (e->timerId() == _flushTimer)
+    {
+        killTimer(_flushTimer);
+        _flushTimer = 0;
+        _quickRenderer->flush();
+    }
+}
+
+void OffscreenQuickView::connectNotify(const QMetaMethod& signal)
+{
+    QQuickWindow::connectNotify(signal);
+
+    if (signal == QMetaMethod::fromSignal(&OffscreenQuickView::afterRender) ||
+        signal == QMetaMethod::fromSignal(&OffscreenQuickView::afterRenderRaw))
+    {
+        _connectRenderer();
+    }
+}
+
+void OffscreenQuickView::_connectRenderer()
+{
+    if (!_quickRenderer)
+        return;
+
+    // Called directly by the render thread. Only forward the signals which are
+    // used, as the renderer skips the readback formats which are not needed.
+    const auto type =
+        Qt::ConnectionType(Qt::DirectConnection | Qt::UniqueConnection);
+    if (isSignalConnected(
+            QMetaMethod::fromSignal(&OffscreenQuickView::afterRender)))
+    {
+        connect(_quickRenderer.get(), &QuickRenderer::frameReady, this,
+                &OffscreenQuickView::afterRender, type);
+    }
+    if (isSignalConnected(
+            QMetaMethod::fromSignal(&OffscreenQuickView::afterRenderRaw)))
+    {
+        connect(_quickRenderer.get(), &QuickRenderer::frameReadyRaw, this,
+                &OffscreenQuickView::afterRenderRaw, type);
     }
 }
 
@@ -180,11 +263,27 @@ void OffscreenQuickView::_setupRootItem()
 
 void OffscreenQuickView::_requestRender()
 {
-    killTimer(_stopRenderingDelayTimer);
-    _stopRenderingDelayTimer = 0;
+    if (_renderingHeld)
+    {
+        _renderPending = true;
+        return;
+    }
 
     if (_renderTimer == 0)
-        _renderTimer = startTimer(5, Qt::PreciseTimer);
+        _renderTimer = startTimer(_getRenderDelay(), Qt::PreciseTimer);
+}
+
+int OffscreenQuickView::_getRenderDelay() const
+{
+    // render once for all the changes happening within a few milliseconds
+    const int minDelay = 5;
+
+    if (_maxFrameRate == 0 || !_lastRenderTime.isValid())
+        return minDelay;
+
+    const auto frameInterval = 1000 / int(_maxFrameRate);
+    const auto elapsed = int(_lastRenderTime.elapsed());
+    return std::max(minDelay, frameInterval - elapsed);
 }
 
 void OffscreenQuickView::_initRenderer()
@@ -193,16 +292,25 @@ void OffscreenQuickView::_initRenderer()
     {
     case RenderMode::MULTITHREADED:
 #ifdef DEFLECTQT_MULTITHREADED
-        _quickRenderer.reset(
-            new QuickRenderer{*this, *_renderControl, true, RenderTarget::FBO});
-
-        _quickRendererThread.reset(new QThread);
-        _quickRendererThread->setObjectName("Render");
+    {
+        _quickRenderer.reset(new QuickRenderer{*this, *_renderControl, true,
+                                               RenderTarget::FBO,
+                                               _renderContext.get()});
+
+        auto thread = _renderContext ? _renderContext->getThread() : nullptr;
+        if (!thread)
+        {
+            _quickRendererThread.reset(new QThread);
+            _quickRendererThread->setObjectName("Render");
+            thread = _quickRendererThread.get();
+        }
 
         // Call required to make QtGraphicalEffects work in the initial scene.
-        _renderControl->prepareThread(_quickRendererThread.get());
-        _quickRenderer->moveToThread(_quickRendererThread.get());
-        _quickRendererThread->start();
+        _renderControl->prepareThread(thread);
+        _quickRenderer->moveToThread(thread);
+        if (_quickRendererThread)
+            _quickRendererThread->start();
+    }
 #else
         throw std::runtime_error(
             "This version of deflect does not support multithreaded rendering");
@@ -218,8 +326,7 @@ void OffscreenQuickView::_initRenderer()
         break;
     }
 
-    connect(_quickRenderer.get(), &QuickRenderer::afterRender, this,
-            &OffscreenQuickView::_afterRender, Qt::DirectConnection);
+    _connectRenderer();
 
     _quickRenderer->init();
 }
@@ -231,18 +338,14 @@ void OffscreenQuickView::_render()
     if (!_quickRenderer)
         _initRenderer();
 
+    _lastRenderTime.start();
     _renderControl->polishItems();
     _quickRenderer->render();
 
-    if (_stopRenderingDelayTimer == 0)
-        _stopRenderingDelayTimer = startTimer(5000 /*ms*/);
-}
-
-void OffscreenQuickView::_afterRender()
-{
-    // Called directly by the render thread just after the rendering is done.
-    // The fbo can be safely assumed to be valid when this function executes.
-    emit afterRender(_quickRenderer->fbo()->toImage());
+    // The (asynchronous) readback of a frame completes with the next render.
+    // Deliver the last frame if the scene stops changing.
+    killTimer(_flushTimer);
+    _flushTimer = startTimer(20 /*ms*/);
 }
 }
 }
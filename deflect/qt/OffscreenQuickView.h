@@ -41,6 +41,7 @@
 #ifndef DELFECT_QT_OFFSCREENQUICKVIEW_H
 #define DELFECT_QT_OFFSCREENQUICKVIEW_H
 
+#include <QElapsedTimer>
 #include <QQuickWindow>
 #include <future>
 
@@ -63,9 +64,13 @@ enum class RenderMode
 };
 
 class QuickRenderer;
+class RenderContext;
 
 /**
  * An offscreen Qt Quick window, similar to a QQuickView.
+ *
+ * The scene is only rendered when it changes, so a static scene does not
+ * produce any new frames.
  */
 class OffscreenQuickView : public QQuickWindow
 {
@@ -80,6 +85,15 @@ public:
     OffscreenQuickView(std::unique_ptr<QQuickRenderControl> control,
                        RenderMode mode = RenderMode::MULTITHREADED);
 
+    /**
+     * Create an offscreen qml view rendering in a shared render thread.
+     * @param control the render control that will be used by the view.
+     * @param renderContext the render thread and OpenGL context to use.
+     * @throw std::invalid_argument if renderContext is null.
+     */
+    OffscreenQuickView(std::unique_ptr<QQuickRenderControl> control,
+                       std::shared_ptr<RenderContext> renderContext);
+
     /** Close the view, stopping the rendering. */
     ~OffscreenQuickView();
 
@@ -99,9 +113,30 @@ public:
     /** @return the root qml context. */
     QQmlContext* getRootContext() const;
 
+    /**
+     * Limit the frequency at which the scene is rendered.
+     * @param fps the maximum number of frames per second, 0 for no limit
+     *        (default).
+     */
+    void setMaxFrameRate(unsigned int fps);
+
+    /**
+     * Do not render new frames until resumeRendering() is called.
+     *
+     * Used to pace the rendering on the consumer of the frames. The changes
+     * of the scene which happen in the meantime are rendered once resumed.
+     */
+    void holdRendering();
+
+    /** Resume the rendering after holdRendering(). */
+    void resumeRendering();
+
 signals:
     /**
-     * Notify that the scene has just finished rendering.
+     * Notify that the scene has finished rendering.
+     *
+     * When supported by the OpenGL context, the image is read back
+     * asynchronously and delivered once the following frame has rendered.
      *
      * @param image the newly rendered image.
      * @note this signal is emitted from the render thread. It is generally
@@ -109,6 +144,22 @@ signals:
      */
     void afterRender(QImage image);
 
+    /**
+     * Notify that the scene has finished rendering, with the raw pixels.
+     *
+     * Cheaper than afterRender(): the pixels are provided as read from OpenGL,
+     * without conversion to a QImage format nor vertical flip. The frames are
+     * only converted to QImage if afterRender() is connected too.
+     *
+     * @param pixels the RGBA pixels of the newly rendered image, bottom-up.
+     * @param size the size of the image in pixels.
+     * @note same threading as afterRender().
+     */
+    void afterRenderRaw(QByteArray pixels, QSize size);
+
+protected:
+    void connectNotify(const QMetaMethod& signal) override;
+
 private:
     std::unique_ptr<QQuickRenderControl> _renderControl;
     const RenderMode _mode;
@@ -117,21 +168,28 @@ private:
     std::unique_ptr<QQmlComponent> _qmlComponent;
     std::unique_ptr<QQuickItem> _rootItem;
 
+    std::shared_ptr<RenderContext> _renderContext;
     std::unique_ptr<QThread> _quickRendererThread;
     std::unique_ptr<QuickRenderer> _quickRenderer;
 
     std::promise<bool> _loadPromise;
 
     int _renderTimer = 0;
-    int _stopRenderingDelayTimer = 0;
+    int _flushTimer = 0;
+
+    unsigned int _maxFrameRate = 0;
+    QElapsedTimer _lastRenderTime;
+    bool _renderingHeld = false;
+    bool _renderPending = false;
 
     void timerEvent(QTimerEvent* e) final;
 
     void _setupRootItem();
     void _requestRender();
+    int _getRenderDelay() const;
     void _initRenderer();
     void _render();
-    void _afterRender();
+    void _connectRenderer();
 };
 }
 }
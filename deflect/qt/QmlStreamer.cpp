@@ -53,6 +53,14 @@ QmlStreamer::QmlStreamer(const QString& qmlFile, const std::string& streamHost,
     connect(_impl.get(), &Impl::streamClosed, this, &QmlStreamer::streamClosed);
 }
 
+QmlStreamer::QmlStreamer(const QString& qmlFile, const std::string& streamHost,
+                         const std::string& streamId,
+                         std::shared_ptr<RenderContext> renderContext)
+    : _impl(new Impl(qmlFile, streamHost, streamId, std::move(renderContext)))
+{
+    connect(_impl.get(), &Impl::streamClosed, this, &QmlStreamer::streamClosed);
+}
+
 QmlStreamer::~QmlStreamer()
 {
 }
@@ -62,6 +70,11 @@ void QmlStreamer::useAsyncSend(const bool async)
     _impl->useAsyncSend(async);
 }
 
+void QmlStreamer::setMaxFrameRate(const unsigned int fps)
+{
+    _impl->setMaxFrameRate(fps);
+}
+
 QQuickItem* QmlStreamer::getRootItem()
 {
     return _impl->getRootItem();
@@ -53,6 +53,8 @@ namespace deflect
 {
 namespace qt
 {
+class RenderContext;
+
 /** Based on http://doc.qt.io/qt-5/qtquick-rendercontrol-example.html
  *
  * This class renders the given QML file in an offscreen fashion and streams
@@ -89,11 +91,37 @@ public:
     QmlStreamer(const QString& qmlFile, const std::string& streamHost,
                 const std::string& streamId = std::string());
 
+    /**
+     * Construct a new qml streamer which renders in a shared render thread.
+     *
+     * Many streamers can share a single RenderContext instead of using one
+     * render thread and OpenGL context each.
+     *
+     * @param qmlFile URL to QML file to load.
+     * @param streamHost host where the Deflect server is running.
+     * @param streamId identifier for the Deflect stream.
+     * @param renderContext the render thread and OpenGL context to use.
+     */
+    QmlStreamer(const QString& qmlFile, const std::string& streamHost,
+                const std::string& streamId,
+                std::shared_ptr<RenderContext> renderContext);
+
     ~QmlStreamer();
 
     /** Use asynchronous send of images via Deflect stream. Default off. */
     void useAsyncSend(bool async);
 
+    /**
+     * Limit the frame rate of the rendering and streaming.
+     *
+     * In addition, with asynchronous send the rendering of a new frame waits
+     * for the previous frame to be sent.
+     *
+     * @param fps the maximum number of frames per second, 0 for no limit.
+     *        Default: 60.
+     */
+    void setMaxFrameRate(unsigned int fps);
+
     /** @return the QML root item, might be nullptr if not ready yet. */
     QQuickItem* getRootItem();
 
@@ -42,12 +42,17 @@
 
 #include "EventReceiver.h"
 #include "QmlGestures.h"
+#include "RenderContext.h"
 #include "TouchInjector.h"
 
 #include <QCoreApplication>
 #include <QQmlContext>
 #include <QQuickItem>
 #include <QQuickRenderControl>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <cstring>
 
 namespace
 {
@@ -56,11 +61,80 @@ const QString GESTURES_CONTEXT_PROPERTY("deflectgestures");
 const QString WEBENGINEVIEW_OBJECT_NAME("webengineview");
 const int TOUCH_TAPANDHOLD_DIST_PX = 20;
 const int TOUCH_TAPANDHOLD_TIMEOUT_MS = 200;
+const unsigned int DEFAULT_MAX_FPS = 60;
+// Size of the segments of the deflect::Stream. The damaged regions are aligned
+// on it for their tiles to replace the ones of the previous frame.
+const int SEGMENT_SIZE = 512;
 #ifdef DEFLECTQT_MULTITHREADED
 const auto renderMode = deflect::qt::RenderMode::MULTITHREADED;
 #else
 const auto renderMode = deflect::qt::RenderMode::SINGLETHREADED;
 #endif
+
+deflect::qt::OffscreenQuickView* _createView(
+    std::shared_ptr<deflect::qt::RenderContext> renderContext)
+{
+    auto control = std::make_unique<QQuickRenderControl>();
+    if (renderContext)
+    {
+        return new deflect::qt::OffscreenQuickView{std::move(control),
+                                                   std::move(renderContext)};
+    }
+    return new deflect::qt::OffscreenQuickView{std::move(control), renderMode};
+}
+
+bool _differ(const QByteArray& previous, const QByteArray& current,
+             const QRect& region, const int stride)
+{
+    const auto rowSize = size_t(region.width()) * 4;
+    for (int y = region.top(); y <= region.bottom(); ++y)
+    {
+        const auto offset = y * stride + region.x() * 4;
+        if (std::memcmp(previous.constData() + offset,
+                        current.constData() + offset, rowSize) != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/** @return the union of the segments where the two images differ. */
+QRect _findDamagedRegion(const QByteArray& previous, const QByteArray& current,
+                         const QSize& size)
+{
+    const auto stride = size.width() * 4;
+    QRect damage;
+    for (int y = 0; y < size.height(); y += SEGMENT_SIZE)
+    {
+        for (int x = 0; x < size.width(); x += SEGMENT_SIZE)
+        {
+            const QRect segment(x, y, std::min(SEGMENT_SIZE, size.width() - x),
+                                std::min(SEGMENT_SIZE, size.height() - y));
+            if (!damage.contains(segment) &&
+                _differ(previous, current, segment, stride))
+            {
+                damage |= segment;
+            }
+        }
+    }
+    return damage;
+}
+
+void _copyRegion(const QByteArray& pixels, const QSize& size,
+                 const QRect& region, QByteArray& output)
+{
+    const auto stride = size.width() * 4;
+    const auto rowSize = region.width() * 4;
+    output.resize(rowSize * region.height());
+    for (int y = 0; y < region.height(); ++y)
+    {
+        std::memcpy(output.data() + y * rowSize,
+                    pixels.constData() + (region.y() + y) * stride +
+                        region.x() * 4,
+                    size_t(rowSize));
+    }
+}
 }
 
 namespace deflect
@@ -68,9 +142,9 @@ namespace deflect
 namespace qt
 {
 QmlStreamer::Impl::Impl(const QString& qmlFile, const std::string& streamHost,
-                        const std::string& streamId)
-    : _quickView{new OffscreenQuickView{std::make_unique<QQuickRenderControl>(),
-                                        renderMode}}
+                        const std::string& streamId,
+                        std::shared_ptr<RenderContext> renderContext)
+    : _quickView{_createView(std::move(renderContext))}
     , _qmlGestures{new QmlGestures}
     , _touchInjector{TouchInjector::create(*_quickView)}
     , _streamHost{streamHost}
@@ -80,7 +154,15 @@ QmlStreamer::Impl::Impl(const QString& qmlFile, const std::string& streamHost,
     _setupMouseModeSwitcher();
     _setupSizeHintsConnections();
 
-    connect(_quickView.get(), &OffscreenQuickView::afterRender, this,
+    _quickView->setMaxFrameRate(DEFAULT_MAX_FPS);
+
+    // A dedicated thread compares the frames and waits for the sends, so that
+    // the GUI thread keeps rendering and the global pool keeps compressing.
+    _sendWaitPool.setMaxThreadCount(1);
+    connect(&_sendWatcher, &QFutureWatcher<void>::finished, this,
+            &QmlStreamer::Impl::_onSendFinished);
+
+    connect(_quickView.get(), &OffscreenQuickView::afterRenderRaw, this,
             &QmlStreamer::Impl::_afterRender);
 
     // Expose stream gestures to qml objects
@@ -97,13 +179,23 @@ QmlStreamer::Impl::Impl(const QString& qmlFile, const std::string& streamHost,
 
 QmlStreamer::Impl::~Impl()
 {
+    _sendWatcher.waitForFinished();
 }
 
-void QmlStreamer::Impl::_afterRender(const QImage image)
+void QmlStreamer::Impl::_afterRender(const QByteArray pixels, const QSize size)
 {
-    if (!_sendFuture.valid() || !_sendFuture.get())
+    // invalid after a failed send, which stops the streaming
+    if (!_sendFuture.valid())
         return;
 
+    // keep the latest frame for when the pending send completes
+    if (_sendPending)
+    {
+        _nextPixels = pixels;
+        _nextPixelsSize = size;
+        return;
+    }
+
     if (!_stream)
     {
         try
@@ -118,27 +210,117 @@ void QmlStreamer::Impl::_afterRender(const QImage image)
         }
     }
 
-    if (image.isNull())
+    if (pixels.isEmpty())
     {
         qDebug() << "Empty image not streamed";
         return;
     }
 
-    _image = image;
-    ImageWrapper imageWrapper(_image.constBits(), _image.width(),
-                              _image.height(), BGRA);
+    _sendWatcher.setFuture(
+        QtConcurrent::run(&_sendWaitPool, [this, pixels, size] {
+            _sendPixels(pixels, size);
+            _sendFuture.wait();
+        }));
+    if (!_asyncSend)
+    {
+        _sendWatcher.waitForFinished();
+        _finishSend();
+        return;
+    }
+
+    // pace the rendering on the completion of the send
+    _quickView->holdRendering();
+    _sendPending = true;
+}
+
+void QmlStreamer::Impl::_onSendFinished()
+{
+    if (!_sendPending)
+        return;
+
+    _sendPending = false;
+    _finishSend();
+    if (!_sendFuture.valid())
+        return;
+
+    _quickView->resumeRendering();
+
+    if (!_nextPixels.isEmpty())
+    {
+        const auto pixels = _nextPixels;
+        _nextPixels.clear();
+        _afterRender(pixels, _nextPixelsSize);
+    }
+}
+
+void QmlStreamer::Impl::_finishSend()
+{
+    bool success = false;
+    try
+    {
+        success = _sendFuture.get();
+    }
+    catch (const std::exception& e)
+    {
+        qWarning() << e.what();
+    }
+
+    if (!success)
+    {
+        qWarning() << "Failed to send frame, stop streaming";
+        return;
+    }
+    _sendFuture = make_ready_future(true);
+}
+
+void QmlStreamer::Impl::_sendPixels(const QByteArray& pixels, const QSize& size)
+{
+    // Only send the segments which changed since the previous frame
+    QRect damage(QPoint(), size);
+    if (size == _pixelsSize)
+    {
+        damage = _findDamagedRegion(_pixels, pixels, size);
+        if (damage.isEmpty())
+        {
+            _sendFuture = make_ready_future(true);
+            return;
+        }
+    }
+    _pixels = pixels;
+    _pixelsSize = size;
+
+    // Stream the pixels as read from OpenGL, the server handles the row order.
+    // The damaged region is thus in (bottom-up) OpenGL coordinates.
+    const bool partial = damage.size() != size &&
+                         _stream->supportsPartialFrames() &&
+                         !_stream->isFullFrameRequested();
+
+    const char* data = _pixels.constData();
+    if (partial)
+    {
+        _copyRegion(_pixels, size, damage, _damagedPixels);
+        data = _damagedPixels.constData();
+    }
+    else
+        damage = QRect(QPoint(), size);
+
+    ImageWrapper imageWrapper(data, damage.width(), damage.height(), RGBA,
+                              damage.x(), damage.y());
+    imageWrapper.rowOrder = RowOrder::bottom_up;
     imageWrapper.compressionPolicy = COMPRESSION_ON;
     imageWrapper.compressionQuality = 80;
 
-    _sendFuture = _stream->sendAndFinish(imageWrapper);
-    if (!_asyncSend)
-        _sendFuture.wait();
+    _sendFuture = partial ? _stream->sendAndFinishPartial(imageWrapper)
+                          : _stream->sendAndFinish(imageWrapper);
 }
 
 void QmlStreamer::Impl::_onStreamClosed()
 {
+    _sendWatcher.waitForFinished();
+    _sendPending = false;
+
     // Stop rendering
-    disconnect(_quickView.get(), &OffscreenQuickView::afterRender, this,
+    disconnect(_quickView.get(), &OffscreenQuickView::afterRenderRaw, this,
                &QmlStreamer::Impl::_afterRender);
     _quickView.reset();
 
@@ -41,9 +41,11 @@
 #ifndef DELFECT_QT_QMLSTREAMERIMPL_H
 #define DELFECT_QT_QMLSTREAMERIMPL_H
 
-#include <QImage>
+#include <QByteArray>
+#include <QFutureWatcher>
 #include <QObject>
 #include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 
 #include "../SizeHints.h"
@@ -69,10 +71,15 @@ class QmlStreamer::Impl : public QObject
 
 public:
     Impl(const QString& qmlFile, const std::string& streamHost,
-         const std::string& streamId);
+         const std::string& streamId,
+         std::shared_ptr<RenderContext> renderContext = nullptr);
     ~Impl();
 
     void useAsyncSend(const bool async) { _asyncSend = async; }
+    void setMaxFrameRate(const unsigned int fps)
+    {
+        _quickView->setMaxFrameRate(fps);
+    }
     QQuickItem* getRootItem() { return _quickView->getRootItem(); }
     QQmlEngine* getQmlEngine() { return _quickView->getEngine(); }
     Stream* getStream() { return _stream.get(); }
@@ -80,7 +87,8 @@ signals:
     void streamClosed();
 
 private slots:
-    void _afterRender(QImage image);
+    void _afterRender(QByteArray pixels, QSize size);
+    void _onSendFinished();
 
     void _onPressed(QPointF position);
     void _onReleased(QPointF position);
@@ -99,6 +107,9 @@ private:
     bool _sendToWebengineviewItems(QKeyEvent& keyEvent);
     std::string _getDeflectStreamIdentifier() const;
     void _setupDeflectStream();
+    /** Diff against the previous frame and send it, in the _sendWaitPool. */
+    void _sendPixels(const QByteArray& pixels, const QSize& size);
+    void _finishSend();
 
     void _connectTouchInjector();
     void _setupMouseModeSwitcher();
@@ -123,7 +134,14 @@ private:
 
     bool _asyncSend{false};
     Stream::Future _sendFuture;
-    QImage _image;
+    QByteArray _pixels;
+    QSize _pixelsSize;
+    QByteArray _damagedPixels;
+    QThreadPool _sendWaitPool;
+    QFutureWatcher<void> _sendWatcher;
+    bool _sendPending{false};
+    QByteArray _nextPixels;
+    QSize _nextPixelsSize;
 
     QTimer _mouseModeTimer;
     bool _mouseMode{false};
@@ -40,14 +40,27 @@
 
 #include "QuickRenderer.h"
 
+#include "RenderContext.h"
+
 #include <QCoreApplication>
 #include <QOffscreenSurface>
 #include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFramebufferObject>
 #include <QOpenGLFunctions>
 #include <QQuickRenderControl>
 #include <QQuickWindow>
 
+#include <cstring>
+#include <functional>
+
+#ifndef GL_BGRA
+#define GL_BGRA 0x80E1
+#endif
+#ifndef GL_UNSIGNED_INT_8_8_8_8_REV
+#define GL_UNSIGNED_INT_8_8_8_8_REV 0x8367
+#endif
+
 // Forward-declare the function defined in <QtGui/private/qopenglcontext_p.h> to
 // remove the need for private headers. This internal API should remain stable
 // because it is also used by QtWebengine for the same reason.
@@ -59,12 +72,161 @@ namespace deflect
 {
 namespace qt
 {
+namespace
+{
+const GLuint64 READBACK_TIMEOUT_NS = 1000000000;
+
+/** Copy OpenGL (bottom-up) pixels to a top-down ARGB32 image. */
+QImage _toImage(const uchar* data, const QSize& size, const bool bgra)
+{
+    QImage image(size, bgra ? QImage::Format_ARGB32_Premultiplied
+                            : QImage::Format_RGBA8888_Premultiplied);
+
+    const auto stride = size_t(size.width()) * 4;
+    const auto height = size.height();
+    for (int y = 0; y < height; ++y)
+        std::memcpy(image.scanLine(height - 1 - y), data + y * stride, stride);
+
+    if (bgra)
+        return image;
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+}
+
+/**
+ * Double-buffered asynchronous readback of an FBO using pixel buffer objects
+ * and fences. Must only be used with its context current.
+ */
+class QuickRenderer::AsyncReadback
+{
+public:
+    /** Called with the bottom-up pixels of a frame, RGBA or BGRA. */
+    using Handler =
+        std::function<void(const uchar* data, const QSize& size, bool bgra)>;
+
+    explicit AsyncReadback(QOpenGLContext& context)
+        : _gl(*context.extraFunctions())
+        , _bgraSupported{!context.isOpenGLES()}
+    {
+    }
+
+    static bool isSupported(const QOpenGLContext& context)
+    {
+        return context.format().majorVersion() >= 3;
+    }
+
+    /**
+     * Start the readback of the fbo and process the previous frame if its
+     * readback was pending.
+     *
+     * @param fbo the framebuffer to read.
+     * @param rgba read RGBA pixels instead of the native BGRA layout of QImage.
+     * @param handler called with the pixels of the previous frame.
+     */
+    void readback(QOpenGLFramebufferObject& fbo, const bool rgba,
+                  const Handler& handler)
+    {
+        _startReadback(_buffers[_next], fbo, rgba || !_bgraSupported);
+        _next = 1 - _next;
+        _finishReadback(_buffers[_next], handler);
+    }
+
+    /** Process the pending frame, if any. */
+    void flush(const Handler& handler)
+    {
+        _finishReadback(_buffers[1 - _next], handler);
+    }
+
+    /** Release the GL resources, dropping the pending frame. */
+    void release()
+    {
+        for (auto& buffer : _buffers)
+        {
+            if (buffer.fence)
+                _gl.glDeleteSync(buffer.fence);
+            if (buffer.pbo)
+                _gl.glDeleteBuffers(1, &buffer.pbo);
+            buffer = Buffer();
+        }
+    }
+
+private:
+    struct Buffer
+    {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        QSize size;
+        int capacity = 0;
+        bool bgra = false;
+    };
+
+    QOpenGLExtraFunctions& _gl;
+    const bool _bgraSupported;
+    Buffer _buffers[2];
+    int _next = 0;
+
+    void _startReadback(Buffer& buffer, QOpenGLFramebufferObject& fbo,
+                        const bool rgba)
+    {
+        buffer.size = fbo.size();
+        buffer.bgra = !rgba;
+        const auto bytes = buffer.size.width() * buffer.size.height() * 4;
+
+        if (!buffer.pbo)
+            _gl.glGenBuffers(1, &buffer.pbo);
+        _gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+        if (buffer.capacity != bytes)
+        {
+            _gl.glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr,
+                             GL_STREAM_READ);
+            buffer.capacity = bytes;
+        }
+
+        // BGRA matches the memory layout of QImage::Format_ARGB32
+        fbo.bind();
+        if (buffer.bgra)
+            _gl.glReadPixels(0, 0, buffer.size.width(), buffer.size.height(),
+                             GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+        else
+            _gl.glReadPixels(0, 0, buffer.size.width(), buffer.size.height(),
+                             GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        _gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        buffer.fence = _gl.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        _gl.glFlush();
+    }
+
+    void _finishReadback(Buffer& buffer, const Handler& handler)
+    {
+        if (!buffer.fence)
+            return;
+
+        _gl.glClientWaitSync(buffer.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                             READBACK_TIMEOUT_NS);
+        _gl.glDeleteSync(buffer.fence);
+        buffer.fence = nullptr;
+
+        _gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer.pbo);
+        const auto data = static_cast<const uchar*>(
+            _gl.glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, buffer.capacity,
+                                 GL_MAP_READ_BIT));
+        if (data)
+        {
+            handler(data, buffer.size, buffer.bgra);
+            _gl.glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        _gl.glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+};
+
 QuickRenderer::QuickRenderer(QQuickWindow& quickWindow,
                              QQuickRenderControl& renderControl,
                              const bool multithreaded,
-                             const RenderTarget target)
+                             const RenderTarget target,
+                             RenderContext* renderContext)
     : _quickWindow(quickWindow)
     , _renderControl(renderControl)
+    , _renderContext(renderContext)
     , _multithreaded(multithreaded)
     , _renderTarget(target)
 {
@@ -84,6 +246,11 @@ QOpenGLFramebufferObject* QuickRenderer::fbo()
     return _fbo.get();
 }
 
+void QuickRenderer::setAsyncReadbackEnabled(const bool enabled)
+{
+    _asyncReadbackEnabled = enabled;
+}
+
 void QuickRenderer::init()
 {
     if (_renderTarget == RenderTarget::NONE)
@@ -129,6 +296,13 @@ void QuickRenderer::render()
         _onRender();
 }
 
+void QuickRenderer::flush()
+{
+    QMetaObject::invokeMethod(this, "_onFlush",
+                              _multithreaded ? Qt::QueuedConnection
+                                             : Qt::DirectConnection);
+}
+
 void QuickRenderer::stop()
 {
     QMetaObject::invokeMethod(this, "_onStop", _connectionType());
@@ -165,9 +339,58 @@ void QuickRenderer::_onRender()
     }
 
     _renderControl.render();
-    _context->functions()->glFinish();
+
+    // The readback takes care of synchronization, avoid stalling the pipeline
+    const bool readback =
+        _renderTarget == RenderTarget::FBO && _hasFrameReadyReceivers();
+    if (!readback || !_asyncReadback)
+        _context->functions()->glFinish();
 
     emit afterRender();
+
+    if (readback)
+        _readback(false);
+}
+
+bool QuickRenderer::_hasFrameReadyReceivers() const
+{
+    return receivers(SIGNAL(frameReady(QImage))) > 0 ||
+           receivers(SIGNAL(frameReadyRaw(QByteArray, QSize))) > 0;
+}
+
+void QuickRenderer::_readback(const bool flush)
+{
+    const bool image = receivers(SIGNAL(frameReady(QImage))) > 0;
+    const bool raw = receivers(SIGNAL(frameReadyRaw(QByteArray, QSize))) > 0;
+
+    const auto handler = [&](const uchar* data, const QSize& size,
+                             const bool bgra) {
+        // a frame read for the image signal only can't be sent as raw RGBA
+        if (raw && !bgra)
+        {
+            const auto bytes = size.width() * size.height() * 4;
+            emit frameReadyRaw(QByteArray((const char*)data, bytes), size);
+        }
+        if (image)
+            emit frameReady(_toImage(data, size, bgra));
+    };
+
+    if (_asyncReadback)
+    {
+        if (flush)
+            _asyncReadback->flush(handler);
+        else
+            _asyncReadback->readback(*_fbo, raw, handler);
+        return;
+    }
+
+    const auto size = _fbo->size();
+    QByteArray pixels(size.width() * size.height() * 4, Qt::Uninitialized);
+    _fbo->bind();
+    _context->functions()->glReadPixels(0, 0, size.width(), size.height(),
+                                        GL_RGBA, GL_UNSIGNED_BYTE,
+                                        pixels.data());
+    handler((const uchar*)pixels.constData(), size, false);
 }
 
 void QuickRenderer::_ensureFBO()
@@ -196,6 +419,12 @@ Qt::ConnectionType QuickRenderer::_connectionType() const
 
 void QuickRenderer::_createGLContext()
 {
+    if (_renderContext)
+    {
+        _context = _renderContext->getGLContext(_quickWindow.screen());
+        return;
+    }
+
     // Qt Quick may need a depth and stencil buffer
     QSurfaceFormat format_;
     format_.setDepthBufferSize(16);
@@ -216,9 +445,25 @@ void QuickRenderer::_initRenderControl()
 {
     _context->makeCurrent(_getSurface());
     _renderControl.initialize(_context.get());
+
+    if (_renderTarget == RenderTarget::FBO && _asyncReadbackEnabled &&
+        AsyncReadback::isSupported(*_context))
+    {
+        _asyncReadback.reset(new AsyncReadback(*_context));
+    }
     _initialized = true;
 }
 
+void QuickRenderer::_onFlush()
+{
+    // only the asynchronous readback delays the delivery of the frames
+    if (!_initialized || !_asyncReadback || !_hasFrameReadyReceivers())
+        return;
+
+    _context->makeCurrent(_getSurface());
+    _readback(true);
+}
+
 void QuickRenderer::_onStop()
 {
     _initialized = false;
@@ -230,6 +475,11 @@ void QuickRenderer::_onStop()
 
     _renderControl.invalidate();
 
+    if (_asyncReadback)
+    {
+        _asyncReadback->release();
+        _asyncReadback.reset();
+    }
     _fbo.reset();
 
     if (_context)
@@ -237,7 +487,9 @@ void QuickRenderer::_onStop()
 
     _offscreenSurface.reset();
 
-    qt_gl_set_global_share_context(nullptr);
+    // a shared context is destroyed by its RenderContext
+    if (!_renderContext)
+        qt_gl_set_global_share_context(nullptr);
     _context.reset();
 }
 }
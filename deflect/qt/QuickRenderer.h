@@ -40,6 +40,7 @@
 #ifndef DELFECT_QT_QUICKRENDERER_H
 #define DELFECT_QT_QUICKRENDERER_H
 
+#include <QImage>
 #include <QMutex>
 #include <QObject>
 #include <QOpenGLFramebufferObject>
@@ -56,6 +57,8 @@ namespace deflect
 {
 namespace qt
 {
+class RenderContext;
+
 /**
  * The different targets for rendering.
  */
@@ -92,10 +95,15 @@ public:
      *                      fashion and should setup accordingly
      * @param target defines where the rendering should happen. An FBO is
      *               internally created to hold the rendered pixels if needed.
+     * @param renderContext optional OpenGL context to share with other
+     *                      renderers, instead of creating a new one. The object
+     *                      must then be moved to the thread of renderContext,
+     *                      and be destroyed there before renderContext.
      */
     QuickRenderer(QQuickWindow& quickWindow, QQuickRenderControl& renderControl,
                   bool multithreaded = true,
-                  RenderTarget target = RenderTarget::WINDOW);
+                  RenderTarget target = RenderTarget::WINDOW,
+                  RenderContext* renderContext = nullptr);
 
     /** Destructor. */
     ~QuickRenderer();
@@ -109,6 +117,12 @@ public:
      */
     QOpenGLFramebufferObject* fbo();
 
+    /**
+     * Use the asynchronous readback of the frames if the context supports it
+     * (default: true), see frameReady(). To be called before init().
+     */
+    void setAsyncReadbackEnabled(bool enabled);
+
     /**
      * To be called from GUI/main thread to initialize this object on render
      * thread. Blocks until operation on render thread is done.
@@ -122,6 +136,14 @@ public:
      */
     void render();
 
+    /**
+     * To be called from GUI/main thread to deliver the last rendered frame if
+     * its asynchronous readback is still pending, when no new render() follows.
+     *
+     * This call is not blocking, the frame is delivered by the render thread.
+     */
+    void flush();
+
     /**
      * To be called from GUI/main thread to stop using this object on the render
      * thread. Blocks until operation on render thread is done.
@@ -135,6 +157,30 @@ signals:
      */
     void afterRender();
 
+    /**
+     * Emitted with the content of the FBO after it has been read back.
+     *
+     * The readback is only done if this signal is connected. If the context
+     * supports it (OpenGL (ES) 3.0), it is asynchronous using pixel buffer
+     * objects: the frame rendered by a call to render() is delivered after the
+     * following render() or flush(), so that its transfer overlaps with the
+     * rendering of the next frame. Originates from render thread.
+     *
+     * @param image the rendered frame, in ARGB32_Premultiplied format.
+     */
+    void frameReady(QImage image);
+
+    /**
+     * Emitted with the raw content of the FBO after it has been read back.
+     *
+     * Same as frameReady(), but without any conversion: the pixels are in RGBA
+     * format with the bottom-up row order of OpenGL.
+     *
+     * @param pixels the RGBA pixels of the rendered frame, bottom-up.
+     * @param size the size of the frame in pixels.
+     */
+    void frameReadyRaw(QByteArray pixels, QSize size);
+
     /**
      * Emitted from the render thread during stop(). Can be used to do some last
      * cleanup operations while the GL context is bound.
@@ -142,16 +188,21 @@ signals:
     void stopping();
 
 private:
+    class AsyncReadback;
+
     QQuickWindow& _quickWindow;
     QQuickRenderControl& _renderControl;
 
-    std::unique_ptr<QOpenGLContext> _context;
+    RenderContext* _renderContext;
+    std::shared_ptr<QOpenGLContext> _context;
     std::unique_ptr<QOffscreenSurface> _offscreenSurface;
     std::unique_ptr<QOpenGLFramebufferObject> _fbo;
+    std::unique_ptr<AsyncReadback> _asyncReadback;
 
     const bool _multithreaded;
     const RenderTarget _renderTarget;
     bool _initialized{false};
+    bool _asyncReadbackEnabled{true};
 
     QMutex _mutex;
     QWaitCondition _cond;
@@ -160,6 +211,8 @@ private:
 
     void _onRender();
     void _ensureFBO();
+    bool _hasFrameReadyReceivers() const;
+    void _readback(bool flush);
     QSurface* _getSurface();
 
     Qt::ConnectionType _connectionType() const;
@@ -168,6 +221,7 @@ private slots:
     // Called in the render thread
     void _createGLContext();
     void _initRenderControl();
+    void _onFlush();
     void _onStop();
 };
 }
@@ -0,0 +1,108 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "RenderContext.h"
+
+#include <QCoreApplication>
+#include <QOpenGLContext>
+#include <QThread>
+
+// Forward-declare the function defined in <QtGui/private/qopenglcontext_p.h> to
+// remove the need for private headers (see QuickRenderer.cpp).
+QT_BEGIN_NAMESPACE
+Q_GUI_EXPORT void qt_gl_set_global_share_context(QOpenGLContext* context);
+QT_END_NAMESPACE
+
+namespace deflect
+{
+namespace qt
+{
+RenderContext::RenderContext()
+    : _thread{new QThread}
+{
+    _thread->setObjectName("Render");
+    moveToThread(_thread.get());
+    _thread->start();
+}
+
+RenderContext::~RenderContext()
+{
+    QMetaObject::invokeMethod(this, "_destroyGLContext",
+                              Qt::BlockingQueuedConnection);
+    _thread->quit();
+    _thread->wait();
+}
+
+QThread* RenderContext::getThread()
+{
+    return _thread.get();
+}
+
+std::shared_ptr<QOpenGLContext> RenderContext::getGLContext(QScreen* screen)
+{
+    if (_context)
+        return _context;
+
+    // Qt Quick may need a depth and stencil buffer
+    QSurfaceFormat format;
+    format.setDepthBufferSize(16);
+    format.setStencilBufferSize(8);
+
+    _context.reset(new QOpenGLContext);
+    _context->setFormat(format);
+    _context->setScreen(screen); // needed for multiple X display
+    _context->create();
+
+    // Setup global share context needed by the Qml WebEngineView
+    if (QCoreApplication::testAttribute(Qt::AA_ShareOpenGLContexts))
+        qt_gl_set_global_share_context(_context.get());
+
+    return _context;
+}
+
+void RenderContext::_destroyGLContext()
+{
+    if (!_context)
+        return;
+
+    qt_gl_set_global_share_context(nullptr);
+    _context.reset();
+}
+}
+}
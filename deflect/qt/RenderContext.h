@@ -0,0 +1,100 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DELFECT_QT_RENDERCONTEXT_H
+#define DELFECT_QT_RENDERCONTEXT_H
+
+#include <QObject>
+#include <memory>
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLContext)
+QT_FORWARD_DECLARE_CLASS(QScreen)
+QT_FORWARD_DECLARE_CLASS(QThread)
+
+namespace deflect
+{
+namespace qt
+{
+/**
+ * A render thread with an OpenGL context, which can be shared by multiple
+ * OffscreenQuickView (and QmlStreamer).
+ *
+ * The views render one after the other in the thread, each into its own FBO,
+ * instead of using one thread and one OpenGL context per view. Spread the
+ * views over several instances to use more than one render thread.
+ */
+class RenderContext : public QObject
+{
+    Q_OBJECT
+
+public:
+    /** Start the render thread. The OpenGL context is created on first use. */
+    RenderContext();
+
+    /**
+     * Destroy the OpenGL context and stop the render thread.
+     *
+     * Not to be called from the render thread, which it waits for.
+     */
+    ~RenderContext();
+
+    /** @return the render thread. */
+    QThread* getThread();
+
+    /**
+     * Get the OpenGL context, creating it on the first call.
+     *
+     * To be called from the render thread.
+     * @param screen the screen for which to create the context.
+     * @return the OpenGL context; lives in render thread.
+     */
+    std::shared_ptr<QOpenGLContext> getGLContext(QScreen* screen);
+
+private:
+    std::unique_ptr<QThread> _thread;
+    std::shared_ptr<QOpenGLContext> _context;
+
+private slots:
+    // Called in the render thread
+    void _destroyGLContext();
+};
+}
+}
+
+#endif
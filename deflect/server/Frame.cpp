@@ -45,7 +45,8 @@ namespace server
 {
 QSize Frame::computeDimensions(const uint8_t channel) const
 {
-    QSize size(0, 0);
+    const auto it = dimensions.find(channel);
+    QSize size = it != dimensions.end() ? it->second : QSize(0, 0);
 
     for (const auto& tile : tiles)
     {
@@ -77,7 +78,7 @@ RowOrder Frame::determineRowOrder() const
 
 std::map<uint8_t, QSize> Frame::computeChannelDimensions() const
 {
-    std::map<uint8_t, QSize> sizes;
+    auto sizes = dimensions;
     for (const auto& tile : tiles)
     {
         auto& size = sizes[tile.channel];
@@ -57,12 +57,30 @@ namespace server
  */
 struct Frame
 {
-    /** The full set of tiles for this frame. */
+    /**
+     * The full set of tiles for this frame.
+     *
+     * Tiles in Format::copy move regions of the previous frame and must be
+     * applied to it before the other tiles.
+     */
     Tiles tiles;
 
     /** The PixelStream uri to which this frame is associated. */
     QString uri;
 
+    /**
+     * The dimensions of the channels, if the tiles do not cover the full frame
+     * (e.g. only a region of interest was dispatched).
+     */
+    std::map<uint8_t, QSize> dimensions;
+
+    /**
+     * True if the tiles only update the previous frame of the stream, onto
+     * which they must be applied: the frame has copies, or the regions moved
+     * by the copies of a previous frame are missing from its tiles.
+     */
+    bool incremental = false;
+
     /** @return the total dimensions of the given channel of this frame. */
     DEFLECT_API QSize computeDimensions(const uint8_t channel = 0) const;
 
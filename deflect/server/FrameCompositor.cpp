@@ -0,0 +1,286 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "FrameCompositor.h"
+
+#include <QRect>
+#include <QtConcurrentMap>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace deflect
+{
+namespace server
+{
+namespace
+{
+const int BAND_HEIGHT = 64; // rows of the image composed by each task
+
+/** A plane of an image, subsampled by a power of two. */
+struct Plane
+{
+    int xShift;
+    int yShift;
+    int bytesPerPixel;
+};
+
+std::vector<Plane> _getPlanes(const Format format)
+{
+    switch (format)
+    {
+    case Format::rgba:
+        return {{0, 0, 4}};
+    case Format::yuv444:
+        return {{0, 0, 1}, {0, 0, 1}, {0, 0, 1}};
+    case Format::yuv422:
+        return {{0, 0, 1}, {1, 0, 1}, {1, 0, 1}};
+    case Format::yuv420:
+        return {{0, 0, 1}, {1, 1, 1}, {1, 1, 1}};
+    default:
+        throw std::runtime_error("FrameCompositor needs decoded tiles");
+    }
+}
+
+int _subsample(const int size, const int shift)
+{
+    return (size + (1 << shift) - 1) >> shift;
+}
+
+size_t _getStride(const int width, const Plane& plane)
+{
+    return size_t(_subsample(width, plane.xShift)) * plane.bytesPerPixel;
+}
+
+size_t _getPlaneSize(const QSize& size, const Plane& plane)
+{
+    return _getStride(size.width(), plane) *
+           _subsample(size.height(), plane.yShift);
+}
+
+size_t _getBufferSize(const QSize& size, const std::vector<Plane>& planes)
+{
+    size_t bufferSize = 0;
+    for (const auto& plane : planes)
+        bufferSize += _getPlaneSize(size, plane);
+    return bufferSize;
+}
+
+QSize _getSize(const Tile& tile)
+{
+    return QSize(int(tile.width), int(tile.height));
+}
+
+bool _isCopy(const Tile& tile)
+{
+    return tile.format == Format::copy;
+}
+
+Format _determineFormat(const Frame& frame)
+{
+    const auto& tiles = frame.tiles;
+    const auto first = std::find_if_not(tiles.begin(), tiles.end(), _isCopy);
+    if (first == tiles.end())
+        throw std::runtime_error("frame has no tiles");
+
+    const auto format = first->format;
+    const auto planes = _getPlanes(format);
+
+    for (const auto& tile : tiles)
+    {
+        if (_isCopy(tile))
+            continue;
+        if (tile.format != format)
+            throw std::runtime_error("frame has tiles of different formats");
+        if (tile.lod != 0)
+            throw std::runtime_error("frame has reduced resolution tiles");
+
+        const auto size = _getBufferSize(_getSize(tile), planes);
+        if (size_t(tile.imageData.size()) < size)
+            throw std::runtime_error("tile has not enough image data");
+    }
+    return format;
+}
+
+/** Move the region of a Format::copy tile within one plane of the image. */
+void _applyCopy(const Tile& tile, const Plane& plane, const QSize& size,
+                char* output)
+{
+    const QRect bounds(0, 0, _subsample(size.width(), plane.xShift),
+                       _subsample(size.height(), plane.yShift));
+    const QRect source(int(tile.sourceX) >> plane.xShift,
+                       int(tile.sourceY) >> plane.yShift,
+                       _subsample(int(tile.width), plane.xShift),
+                       _subsample(int(tile.height), plane.yShift));
+    const auto dx = (int(tile.x) >> plane.xShift) - source.x();
+    const auto dy = (int(tile.y) >> plane.yShift) - source.y();
+
+    const auto rect =
+        source.intersected(bounds).intersected(bounds.translated(-dx, -dy));
+    if (rect.isEmpty())
+        return;
+
+    const auto stride = _getStride(size.width(), plane);
+    const auto x = size_t(rect.x()) * plane.bytesPerPixel;
+    const auto destX = size_t(rect.x() + dx) * plane.bytesPerPixel;
+    const auto rowSize = size_t(rect.width()) * plane.bytesPerPixel;
+
+    // Start with the rows furthest in the direction of the move, so that the
+    // overlapping source rows are read before being overwritten.
+    for (int i = 0; i < rect.height(); ++i)
+    {
+        const auto y = dy > 0 ? rect.bottom() - i : rect.top() + i;
+        std::memmove(output + (y + dy) * stride + destX,
+                     output + y * stride + x, rowSize);
+    }
+}
+
+/** A range of rows of one plane of the image. */
+struct Band
+{
+    size_t plane;
+    int begin;
+    int end;
+};
+}
+
+FrameCompositor::FrameCompositor(const Frame& frame)
+    : _frame(frame)
+    , _sizes(frame.computeChannelDimensions())
+    , _format(_determineFormat(frame))
+{
+}
+
+Format FrameCompositor::getFormat() const
+{
+    return _format;
+}
+
+QSize FrameCompositor::getSize(const uint8_t channel) const
+{
+    const auto it = _sizes.find(channel);
+    return it != _sizes.end() ? it->second : QSize();
+}
+
+size_t FrameCompositor::getBufferSize(const uint8_t channel) const
+{
+    return _getBufferSize(getSize(channel), _getPlanes(_format));
+}
+
+void FrameCompositor::compose(char* buffer, const View view,
+                              const uint8_t channel) const
+{
+    const auto size = getSize(channel);
+    const auto planes = _getPlanes(_format);
+
+    std::vector<size_t> planeOffsets;
+    std::vector<Band> bands;
+    size_t offset = 0;
+    for (size_t i = 0; i < planes.size(); ++i)
+    {
+        planeOffsets.push_back(offset);
+        offset += _getPlaneSize(size, planes[i]);
+
+        const auto height = _subsample(size.height(), planes[i].yShift);
+        for (int y = 0; y < height; y += BAND_HEIGHT)
+            bands.push_back({i, y, std::min(y + BAND_HEIGHT, height)});
+    }
+
+    std::vector<const Tile*> tiles;
+    for (const auto& tile : _frame.tiles)
+    {
+        if (tile.view != view || tile.channel != channel)
+            continue;
+
+        if (!_isCopy(tile))
+        {
+            tiles.push_back(&tile);
+            continue;
+        }
+        for (size_t i = 0; i < planes.size(); ++i)
+            _applyCopy(tile, planes[i], size, buffer + planeOffsets[i]);
+    }
+
+    // Each band processes the tiles in order, so that overlapping tiles are
+    // composed like they were received.
+    QtConcurrent::blockingMap(bands, [&](const Band& band) {
+        const auto& plane = planes[band.plane];
+        const auto stride = _getStride(size.width(), plane);
+        const auto output = buffer + planeOffsets[band.plane];
+
+        for (const auto tile : tiles)
+        {
+            const auto tileSize = _getSize(*tile);
+            auto input = tile->imageData.constData();
+            for (size_t i = 0; i < band.plane; ++i)
+                input += _getPlaneSize(tileSize, planes[i]);
+
+            const auto tileStride = _getStride(tileSize.width(), plane);
+            const auto tileHeight = _subsample(tileSize.height(), plane.yShift);
+            const auto tileY = int(tile->y) >> plane.yShift;
+            const auto x =
+                size_t(tile->x >> plane.xShift) * plane.bytesPerPixel;
+            if (x >= stride)
+                continue;
+            const auto rowSize = std::min(tileStride, stride - x);
+
+            const auto begin = std::max(band.begin, tileY);
+            const auto end = std::min(band.end, tileY + tileHeight);
+            for (int y = begin; y < end; ++y)
+            {
+                auto row = y - tileY;
+                if (tile->rowOrder == RowOrder::bottom_up)
+                    row = tileHeight - 1 - row;
+                std::memcpy(output + y * stride + x, input + row * tileStride,
+                            rowSize);
+            }
+        }
+    });
+}
+
+QByteArray FrameCompositor::compose(const View view,
+                                    const uint8_t channel) const
+{
+    QByteArray image(int(getBufferSize(channel)), 0);
+    compose(image.data(), view, channel);
+    return image;
+}
+}
+}
@@ -0,0 +1,115 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_FRAMECOMPOSITOR_H
+#define DEFLECT_SERVER_FRAMECOMPOSITOR_H
+
+#include <deflect/api.h>
+#include <deflect/server/Frame.h>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Assemble the decoded tiles of a Frame into one contiguous image per view and
+ * channel.
+ *
+ * RGBA tiles produce an RGBA image, while YUV tiles (see
+ * TileDecoder::decodeToYUV()) produce a planar YUV image with the same chroma
+ * subsampling. The images are always top-down, regardless of the row order of
+ * the tiles. The rows of the image are copied in parallel.
+ */
+class FrameCompositor
+{
+public:
+    /**
+     * Prepare the composition of a frame.
+     *
+     * @param frame the frame to compose, which must remain valid for the
+     *        lifetime of the compositor.
+     * @throw std::runtime_error if the frame has no tiles besides copies, if
+     *        some tiles are not decoded (at full resolution) or if the tiles
+     *        have different formats.
+     */
+    DEFLECT_API explicit FrameCompositor(const Frame& frame);
+
+    /** @return the format of the composed images (rgba or yuv). */
+    DEFLECT_API Format getFormat() const;
+
+    /** @return the dimensions of the image of a channel. */
+    DEFLECT_API QSize getSize(uint8_t channel = 0) const;
+
+    /** @return the size in bytes of the image of a channel. */
+    DEFLECT_API size_t getBufferSize(uint8_t channel = 0) const;
+
+    /**
+     * Compose the image of a view and channel into a caller-supplied buffer.
+     *
+     * The regions of the buffer which are not covered by any tile are left
+     * untouched. The copies of the frame (Format::copy) are first applied in
+     * order to the buffer, which must then contain the previous frame (as for
+     * all Frame::incremental frames). Copies in subsampled YUV formats should
+     * be aligned on the chroma blocks.
+     * @param buffer the destination, of at least getBufferSize(channel) bytes.
+     * @param view the view of the tiles to compose.
+     * @param channel the channel of the tiles to compose.
+     */
+    DEFLECT_API void compose(char* buffer, View view = View::mono,
+                             uint8_t channel = 0) const;
+
+    /**
+     * Compose the image of a view and channel.
+     *
+     * @param view the view of the tiles to compose.
+     * @param channel the channel of the tiles to compose.
+     * @return the image, zero-filled where no tile covers it.
+     */
+    DEFLECT_API QByteArray compose(View view = View::mono,
+                                   uint8_t channel = 0) const;
+
+private:
+    const Frame& _frame;
+    const std::map<uint8_t, QSize> _sizes;
+    const Format _format;
+};
+}
+}
+
+#endif
@@ -42,6 +42,7 @@
 #include "Frame.h"
 #include "ReceiveBuffer.h"
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 #include <mutex>
@@ -55,7 +56,22 @@ class FrameDispatcher::Impl
 public:
     Impl() {}
 
-    FramePtr getLastCompletedFrame(const QString& uri, size_t sourceIndex)
+    struct Stream
+    {
+        ReceiveBuffer buffer;
+        size_t observers = 0;
+        std::map<uint8_t, QSize> dimensions; // of the last dispatched frame
+
+        // Region of the receiver's frame which holds the pixels of the stream
+        QRect validArea;
+        // Regions read by copies, added to the region of interest
+        QRect copySources;
+        // Until a full frame, as the regions of removed copies are outdated
+        bool needsFullFrame = false;
+    };
+
+    FramePtr getLastCompletedFrame(const QString& uri,
+                                   const size_t sourceIndex, const bool partial)
     {
         std::lock_guard<std::mutex> lock(mutex);
 
@@ -63,7 +79,10 @@ public:
             return {};
 
         auto& buffer = streams[uri].buffer;
-        buffer.finishFrameForSource(sourceIndex);
+        if (partial)
+            buffer.finishPartialFrameForSource(sourceIndex);
+        else
+            buffer.finishFrameForSource(sourceIndex);
 
         return consumeLatestFrame(uri);
     }
@@ -83,7 +102,8 @@ public:
 
     FramePtr consumeLatestFrame(const QString& uri)
     {
-        auto& buffer = streams[uri].buffer;
+        auto& stream = streams[uri];
+        auto& buffer = stream.buffer;
 
         if (!buffer.isAllowedToSend() || !buffer.hasCompleteFrame())
             return {};
@@ -91,14 +111,52 @@ public:
         auto frame = std::make_shared<Frame>();
         frame->uri = uri;
 
-        while (buffer.hasCompleteFrame())
+        // Frames which copy regions of their previous frame must not skip it,
+        // nor be skipped as the next frames do not include the copied regions.
+        // The first incomplete frame must not skip the last complete one.
+        do
+        {
+            frame->incremental = buffer.isNextFrameIncomplete();
             frame->tiles = buffer.popFrame();
+        } while (buffer.hasCompleteFrame() && !hasCopies(*frame) &&
+                 !buffer.isNextFrameCopying() &&
+                 (frame->incremental || !buffer.isNextFrameIncomplete()));
 
         assert(!frame->tiles.empty());
 
+        // The tiles of such frames usually only cover the updated regions
+        if (frame->incremental)
+            frame->dimensions = stream.dimensions;
+        stream.dimensions = frame->computeChannelDimensions();
+
         if (frame->determineRowOrder() == RowOrder::bottom_up)
             mirrorTilesPositionsVertically(*frame);
 
+        const auto roi = regionsOfInterest.find(uri);
+        if (roi != regionsOfInterest.end())
+        {
+            // Also keep the regions read by the copies of the next frames
+            const auto region = roi->second.united(stream.copySources);
+            removeTilesOutsideRegion(*frame, region);
+            if (removeInvalidCopies(*frame, stream))
+            {
+                stream.validArea = QRect();
+                stream.needsFullFrame = true;
+            }
+            if (frame->tiles.empty())
+                return {};
+
+            if (frame->incremental)
+                stream.validArea &= region;
+            else
+                stream.validArea = region;
+        }
+        else if (!frame->incremental)
+            stream.validArea = QRect(QPoint(), frame->computeDimensions());
+
+        if (!frame->incremental)
+            stream.needsFullFrame = false;
+
         // receiver will request a new frame once this frame was consumed
         buffer.setAllowedToSend(false);
 
@@ -109,7 +167,68 @@ public:
     {
         const auto sizes = frame.computeChannelDimensions();
         for (auto& tile : frame.tiles)
-            tile.y = sizes.at(tile.channel).height() - tile.y - tile.height;
+        {
+            const auto height = sizes.at(tile.channel).height();
+            tile.y = height - tile.y - tile.height;
+            if (tile.format == Format::copy)
+                tile.sourceY = height - tile.sourceY - tile.height;
+        }
+    }
+
+    bool needsFullFrame(const QString& uri, const size_t sourceIndex)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const auto it = streams.find(uri);
+        return it != streams.end() &&
+               (it->second.needsFullFrame ||
+                it->second.buffer.needsFullFrame(sourceIndex));
+    }
+
+    bool hasCopies(const Frame& frame) const
+    {
+        const auto& tiles = frame.tiles;
+        return std::any_of(tiles.begin(), tiles.end(), [](const Tile& tile) {
+            return tile.format == Format::copy;
+        });
+    }
+
+    void removeTilesOutsideRegion(Frame& frame, const QRect& region) const
+    {
+        frame.dimensions = frame.computeChannelDimensions();
+
+        const auto isOutside = [&region](const Tile& tile) {
+            const QRect rect(tile.x, tile.y, tile.width, tile.height);
+            return !region.intersects(rect);
+        };
+        auto& tiles = frame.tiles;
+        tiles.erase(std::remove_if(tiles.begin(), tiles.end(), isOutside),
+                    tiles.end());
+    }
+
+    // The copies which read pixels that the receiver did not get are removed,
+    // along with the ones which follow them. Their sources are added to the
+    // region of interest of the next frames.
+    bool removeInvalidCopies(Frame& frame, Stream& stream) const
+    {
+        bool removed = false;
+        const auto isInvalid = [&removed, &stream](const Tile& tile) {
+            if (tile.format != Format::copy)
+                return false;
+
+            const QRect source(tile.sourceX, tile.sourceY, tile.width,
+                               tile.height);
+            if (!removed && stream.validArea.contains(source))
+                return false;
+
+            stream.copySources |= source;
+            removed = true;
+            return true;
+        };
+        auto& tiles = frame.tiles;
+        tiles.erase(std::remove_if(tiles.begin(), tiles.end(), isInvalid),
+                    tiles.end());
+        return removed;
     }
 
     bool allConnectionsClosed(const QString& uri) const
@@ -118,12 +237,8 @@ public:
         return stream.buffer.getSourceCount() == 0 && stream.observers == 0;
     }
 
-    struct Stream
-    {
-        ReceiveBuffer buffer;
-        size_t observers = 0;
-    };
     std::map<QString, Stream> streams;
+    std::map<QString, QRect> regionsOfInterest;
     std::mutex mutex;
 };
 
@@ -208,8 +323,26 @@ void FrameDispatcher::processFrameFinished(const QString uri,
 {
     try
     {
-        if (auto frame = _impl->getLastCompletedFrame(uri, sourceIndex))
+        if (auto frame = _impl->getLastCompletedFrame(uri, sourceIndex, false))
+            emit sendFrame(frame);
+        if (_impl->needsFullFrame(uri, sourceIndex))
+            emit fullFrameRequested(uri, sourceIndex);
+    }
+    catch (const std::runtime_error& e)
+    {
+        emit pixelStreamError(uri, e.what());
+    }
+}
+
+void FrameDispatcher::processPartialFrameFinished(const QString uri,
+                                                  const size_t sourceIndex)
+{
+    try
+    {
+        if (auto frame = _impl->getLastCompletedFrame(uri, sourceIndex, true))
             emit sendFrame(frame);
+        if (_impl->needsFullFrame(uri, sourceIndex))
+            emit fullFrameRequested(uri, sourceIndex);
     }
     catch (const std::runtime_error& e)
     {
@@ -230,6 +363,21 @@ void FrameDispatcher::requestFrame(const QString uri)
     }
 }
 
+void FrameDispatcher::setRegionOfInterest(const QString uri,
+                                          const QRect region)
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+
+    if (region.isEmpty())
+        _impl->regionsOfInterest.erase(uri);
+    else
+        _impl->regionsOfInterest[uri] = region;
+
+    const auto stream = _impl->streams.find(uri);
+    if (stream != _impl->streams.end())
+        stream->second.copySources = QRect();
+}
+
 void FrameDispatcher::deleteStream(const QString uri)
 {
     _impl->streams.erase(uri);
@@ -44,6 +44,7 @@
 #include <deflect/server/Tile.h>
 
 #include <QObject>
+#include <QRect>
 #include <map>
 
 namespace deflect
@@ -115,6 +116,16 @@ public slots:
      */
     void processFrameFinished(QString uri, size_t sourceIndex);
 
+    /**
+     * The given source has finished sending Tiles which only update a part of
+     * its previous frame.
+     *
+     * @param uri Identifier for the stream
+     * @param sourceIndex Identifier for the source in the stream
+     * @see ReceiveBuffer::finishPartialFrameForSource()
+     */
+    void processPartialFrameFinished(QString uri, size_t sourceIndex);
+
     /**
      * Request the dispatching of a new frame for any stream (mono/stereo).
      *
@@ -124,10 +135,27 @@ public slots:
      * Stereo left/right frames will only be be dispatched together when both
      * are available to ensure that the two eye channels remain synchronized.
      *
+     * Only the latest complete frame is dispatched, except for the frames
+     * which copy regions of their previous frame (Format::copy) and the frames
+     * followed by such frames or by the first incremental frame, which are
+     * never skipped.
+     *
      * @param uri Identifier for the stream
      */
     void requestFrame(QString uri);
 
+    /**
+     * Only dispatch the tiles of a stream which intersect a region.
+     *
+     * The frames keep the dimensions of the full frame. Frames without any
+     * tile in the region are not dispatched.
+     *
+     * @param uri Identifier for the stream
+     * @param region the region of interest in pixel coordinates of the frame,
+     *        or an empty rectangle to dispatch all the tiles (default).
+     */
+    void setRegionOfInterest(QString uri, QRect region);
+
     /**
      * Delete all the buffers for a Stream.
      *
@@ -174,6 +202,16 @@ signals:
      */
     void pixelStreamClosed(QString uri);
 
+    /**
+     * Notify that a source sent frames which can not be completed, because its
+     * previous frame was not kept. The next frames are incremental until the
+     * source sends a full frame.
+     *
+     * @param uri Identifier for the stream
+     * @param sourceIndex Identifier for the source in the stream
+     */
+    void fullFrameRequested(QString uri, size_t sourceIndex);
+
     /**
      * Dispatch a full frame.
      *
@@ -44,6 +44,9 @@
 
 namespace
 {
+const int PIXEL_FORMAT = TJPF_RGBX; // Format for OpenGL texture (GL_RGBA)
+const int YUV_PAD = 1;              // no padding
+
 deflect::ChromaSubsampling _getSubsamp(const int tjJpegSubsamp)
 {
     switch (tjJpegSubsamp)
@@ -58,6 +61,12 @@ deflect::ChromaSubsampling _getSubsamp(const int tjJpegSubsamp)
         throw std::runtime_error("unsupported subsampling format");
     }
 }
+
+void _checkLod(const uint8_t lod)
+{
+    if (lod > deflect::server::MAX_JPEG_LOD)
+        throw std::invalid_argument("unsupported JPEG level of detail");
+}
 }
 
 namespace deflect
@@ -98,47 +107,73 @@ JpegHeader ImageJpegDecompressor::decompressHeader(const QByteArray& jpegData)
     return header;
 }
 
-QByteArray ImageJpegDecompressor::decompress(const QByteArray& jpegData)
+QByteArray ImageJpegDecompressor::decompress(const QByteArray& jpegData,
+                                             const uint8_t lod)
 {
+    _checkLod(lod);
+
     const auto header = decompressHeader(jpegData);
-    const int pixelFormat = TJPF_RGBX; // Format for OpenGL texture (GL_RGBA)
-    const int pitch = header.width * tjPixelSize[pixelFormat];
-    const int flags = TJ_FASTUPSAMPLE;
+    const int pitch = getLodSize(header.width, lod) * tjPixelSize[PIXEL_FORMAT];
+    const int height = getLodSize(header.height, lod);
 
-    QByteArray decodedData(header.height * pitch, Qt::Uninitialized);
+    QByteArray decodedData(height * pitch, Qt::Uninitialized);
+    decompress(jpegData, header, decodedData.data(), pitch, lod);
+    return decodedData;
+}
+
+void ImageJpegDecompressor::decompress(const QByteArray& jpegData,
+                                       const JpegHeader& header, char* buffer,
+                                       const int pitch, const uint8_t lod)
+{
+    _checkLod(lod);
+
+    // libjpeg-turbo selects the 1/2^lod scaling factor from these dimensions
+    const int width = getLodSize(header.width, lod);
+    const int height = getLodSize(header.height, lod);
+    const int flags = TJ_FASTUPSAMPLE;
 
     int err = tjDecompress2(_tjHandle, (unsigned char*)jpegData.data(),
                             (unsigned long)jpegData.size(),
-                            (unsigned char*)decodedData.data(), header.width,
-                            pitch, header.height, pixelFormat, flags);
+                            (unsigned char*)buffer, width, pitch, height,
+                            PIXEL_FORMAT, flags);
     if (err != 0)
         throw std::runtime_error("libjpeg-turbo image decompression failed");
-
-    return decodedData;
 }
 
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
 
 ImageJpegDecompressor::YUVData ImageJpegDecompressor::decompressToYUV(
-    const QByteArray& jpegData)
+    const QByteArray& jpegData, const uint8_t lod)
 {
+    _checkLod(lod);
+
     const auto header = decompressHeader(jpegData);
-    const int pad = 1; // no padding
-    const int flags = 0;
+    const int width = getLodSize(header.width, lod);
+    const int height = getLodSize(header.height, lod);
     const int jpegSubsamp = int(header.subsampling);
-    const auto decodedSize =
-        tjBufSizeYUV2(header.width, pad, header.height, jpegSubsamp);
+    const auto decodedSize = tjBufSizeYUV2(width, YUV_PAD, height, jpegSubsamp);
 
     auto decodedData = QByteArray(decodedSize, Qt::Uninitialized);
+    decompressToYUV(jpegData, header, decodedData.data(), lod);
+    return std::make_pair(std::move(decodedData), header.subsampling);
+}
+
+void ImageJpegDecompressor::decompressToYUV(const QByteArray& jpegData,
+                                            const JpegHeader& header,
+                                            char* buffer, const uint8_t lod)
+{
+    _checkLod(lod);
+
+    const int width = getLodSize(header.width, lod);
+    const int height = getLodSize(header.height, lod);
+    const int flags = 0;
 
     int err = tjDecompressToYUV2(_tjHandle, (unsigned char*)jpegData.data(),
                                  (unsigned long)jpegData.size(),
-                                 (unsigned char*)decodedData.data(),
-                                 header.width, pad, header.height, flags);
+                                 (unsigned char*)buffer, width, YUV_PAD, height,
+                                 flags);
     if (err != 0)
         throw std::runtime_error("libjpeg-turbo image decompression failed");
-
-    return std::make_pair(std::move(decodedData), header.subsampling);
 }
 
 #endif
@@ -62,6 +62,18 @@ struct JpegHeader
     ChromaSubsampling subsampling;
 };
 
+/** The highest level of detail supported by libjpeg-turbo's scaled IDCT. */
+const uint8_t MAX_JPEG_LOD = 3;
+
+/**
+ * @return the dimension of an image decoded at a given level of detail, where
+ *         each level halves the dimensions of the previous one (rounded up).
+ */
+inline int getLodSize(const int size, const uint8_t lod)
+{
+    return (size + (1 << lod) - 1) >> lod;
+}
+
 /**
  * Decompress Jpeg compressed data.
  */
@@ -83,11 +95,36 @@ public:
     /**
      * Decompress a Jpeg image.
      *
+     * Reduced levels of detail are decoded directly in the DCT domain, which
+     * is several times faster than decoding at full resolution.
+     *
      * @param jpegData The compressed Jpeg data
-     * @return The decompressed image data in (GL_)RGBA format
+     * @param lod The level of detail, from 0 (full resolution) to
+     *        MAX_JPEG_LOD (1/8th of the resolution).
+     * @return The decompressed image data in (GL_)RGBA format, of dimensions
+     *         getLodSize(header.width, lod) x getLodSize(header.height, lod)
      * @throw std::runtime_error if a decompression error occured
+     * @throw std::invalid_argument if lod > MAX_JPEG_LOD
      */
-    DEFLECT_API QByteArray decompress(const QByteArray& jpegData);
+    DEFLECT_API QByteArray decompress(const QByteArray& jpegData,
+                                      uint8_t lod = 0);
+
+    /**
+     * Decompress a Jpeg image into a caller-provided buffer.
+     *
+     * @param jpegData The compressed Jpeg data
+     * @param header The header of the Jpeg data, from decompressHeader()
+     * @param buffer The destination of the image data in (GL_)RGBA format,
+     *        large enough for the image at the given level of detail
+     * @param pitch The number of bytes per row of the destination buffer
+     * @param lod The level of detail, from 0 (full resolution) to
+     *        MAX_JPEG_LOD (1/8th of the resolution).
+     * @throw std::runtime_error if a decompression error occured
+     * @throw std::invalid_argument if lod > MAX_JPEG_LOD
+     */
+    DEFLECT_API void decompress(const QByteArray& jpegData,
+                                const JpegHeader& header, char* buffer,
+                                int pitch, uint8_t lod = 0);
 
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
 
@@ -97,10 +134,30 @@ public:
      * Decompress a Jpeg image to YUV, skipping the YUV -> RGBA conversion step.
      *
      * @param jpegData The compressed Jpeg data
+     * @param lod The level of detail, from 0 (full resolution) to
+     *        MAX_JPEG_LOD (1/8th of the resolution).
      * @return The decompressed image data in YUV format
      * @throw std::runtime_error if a decompression error occured
+     * @throw std::invalid_argument if lod > MAX_JPEG_LOD
+     */
+    DEFLECT_API YUVData decompressToYUV(const QByteArray& jpegData,
+                                        uint8_t lod = 0);
+
+    /**
+     * Decompress a Jpeg image to YUV into a caller-provided buffer.
+     *
+     * @param jpegData The compressed Jpeg data
+     * @param header The header of the Jpeg data, from decompressHeader()
+     * @param buffer The destination of the image data, which receives the
+     *        Y, U and V planes contiguously and without padding
+     * @param lod The level of detail, from 0 (full resolution) to
+     *        MAX_JPEG_LOD (1/8th of the resolution).
+     * @throw std::runtime_error if a decompression error occured
+     * @throw std::invalid_argument if lod > MAX_JPEG_LOD
      */
-    DEFLECT_API YUVData decompressToYUV(const QByteArray& jpegData);
+    DEFLECT_API void decompressToYUV(const QByteArray& jpegData,
+                                     const JpegHeader& header, char* buffer,
+                                     uint8_t lod = 0);
 
 #endif
 
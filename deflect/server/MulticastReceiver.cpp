@@ -0,0 +1,288 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "MulticastReceiver.h"
+
+#include <QTimer>
+#include <QtNetwork/QUdpSocket>
+
+#include <stdexcept>
+
+namespace
+{
+const int RECEIVE_BUFFER_SIZE = 16 * 1024 * 1024;
+const int SESSION_CHECK_INTERVAL_MS = 10;
+const std::chrono::seconds SESSION_TIMEOUT{5};
+}
+
+namespace deflect
+{
+namespace server
+{
+MulticastReceiver::MulticastReceiver(const QHostAddress& group,
+                                     const quint16 port)
+    : _socket{new QUdpSocket(this)} // children of *this* are moved along
+    , _timer{new QTimer(this)}      // with it to the receiver thread
+{
+    const auto ipv6 = group.protocol() == QAbstractSocket::IPv6Protocol;
+    const auto any = ipv6 ? QHostAddress::AnyIPv6 : QHostAddress::AnyIPv4;
+
+    // Several receivers on the same machine (e.g. one per GPU) share the port
+    if (!group.isMulticast() ||
+        !_socket->bind(any, port, QUdpSocket::ShareAddress |
+                                      QUdpSocket::ReuseAddressHint) ||
+        !_socket->joinMulticastGroup(group))
+    {
+        throw std::runtime_error("could not join multicast group " +
+                                 group.toString().toStdString() + ": " +
+                                 _socket->errorString().toStdString());
+    }
+
+    // The frames arrive in bursts which must be buffered until they are read
+    _socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption,
+                             RECEIVE_BUFFER_SIZE);
+
+    connect(_socket, &QUdpSocket::readyRead, this,
+            &MulticastReceiver::_readDatagrams);
+
+    _timer->setInterval(SESSION_CHECK_INTERVAL_MS);
+    connect(_timer, &QTimer::timeout, this,
+            &MulticastReceiver::_processSessions);
+}
+
+MulticastReceiver::~MulticastReceiver()
+{
+    for (auto& session : _sessions)
+        _closeSession(session.first, session.second);
+}
+
+void MulticastReceiver::start()
+{
+    _timer->start();
+}
+
+void MulticastReceiver::_readDatagrams()
+{
+    const auto now = Clock::now();
+    while (_socket->hasPendingDatagrams())
+    {
+        QByteArray datagram(int(_socket->pendingDatagramSize()),
+                            Qt::Uninitialized);
+        QHostAddress sender;
+        if (_socket->readDatagram(datagram.data(), datagram.size(), &sender) <
+            0)
+        {
+            break;
+        }
+
+        DatagramHeader header;
+        QByteArray payload;
+        if (!parseDatagram(datagram, header, payload) ||
+            (header.type != DatagramType::data &&
+             header.type != DatagramType::heartbeat))
+        {
+            continue;
+        }
+
+        auto& session = _sessions[header.session];
+        session.sender = sender;
+        session.repairPort = header.repairPort;
+        session.lastReceived = now;
+        const auto lostCount = session.assembler.getLostCount();
+        session.assembler.add(header, payload, now);
+        _takeMessages(header.session, session, lostCount);
+    }
+    _processSessions();
+}
+
+void MulticastReceiver::_processSessions()
+{
+    const auto now = Clock::now();
+    for (auto it = _sessions.begin(); it != _sessions.end();)
+    {
+        const auto id = it->first;
+        auto& session = it->second;
+
+        // The sender crashed or the stream was closed long ago
+        if (now - session.lastReceived > SESSION_TIMEOUT)
+        {
+            _closeSession(id, session);
+            it = _sessions.erase(it);
+            continue;
+        }
+        ++it;
+
+        if (session.closed)
+            continue;
+
+        const auto lostCount = session.assembler.getLostCount();
+        const auto ranges = session.assembler.getNack(now);
+        if (!ranges.empty())
+        {
+            _socket->writeDatagram(makeNack(id, ranges), session.sender,
+                                   session.repairPort);
+        }
+
+        // Giving up on a gap may have completed the following messages
+        _takeMessages(id, session, lostCount);
+    }
+}
+
+void MulticastReceiver::_takeMessages(const uint32_t id, Session& session,
+                                      const uint64_t lostCount)
+{
+    // The messages following a gap belong to an incomplete frame
+    const auto lost = session.assembler.getLostCount() - lostCount;
+    if (lost > 0 && !session.uri.isEmpty() && !session.closed)
+    {
+        _dropFrame(id, session);
+        emit connectionError(session.uri,
+                             QString("%1 datagrams lost, waiting for a full "
+                                     "frame")
+                                 .arg(lost));
+    }
+
+    MessageHeader header;
+    QByteArray message;
+    while (session.assembler.takeMessage(header, message))
+        _handleMessage(id, session, header, message);
+}
+
+void MulticastReceiver::_handleMessage(const uint32_t id, Session& session,
+                                       const MessageHeader& header,
+                                       const QByteArray& message)
+{
+    if (session.closed)
+        return;
+
+    if (session.uri.isEmpty())
+    {
+        session.uri = QString(header.uri);
+        if (session.uri.isEmpty())
+            return;
+        emit addStreamSource(session.uri, id);
+
+        // Joined after the opening, the previous frames are missing
+        if (header.type != MESSAGE_TYPE_PIXELSTREAM_OPEN)
+            _dropFrame(id, session);
+    }
+
+    switch (header.type)
+    {
+    case MESSAGE_TYPE_PIXELSTREAM:
+        try
+        {
+            auto tile = session.tileParser.parseTile(message);
+            session.frameHasCopies =
+                session.frameHasCopies || tile.format == Format::copy;
+            session.frameTiles.push_back(std::move(tile));
+        }
+        catch (const std::runtime_error& e)
+        {
+            emit connectionError(session.uri, e.what());
+        }
+        break;
+
+    case MESSAGE_TYPE_PIXELSTREAM_FINISH_FRAME:
+        _finishFrame(id, session, false);
+        break;
+
+    case MESSAGE_TYPE_PIXELSTREAM_FINISH_PARTIAL_FRAME:
+        _finishFrame(id, session, true);
+        break;
+
+    case MESSAGE_TYPE_QUIT:
+        _closeSession(id, session);
+        break;
+
+    default:
+        session.tileParser.parseImageState(header.type, message);
+        break;
+    }
+}
+
+void MulticastReceiver::_finishFrame(const uint32_t id, Session& session,
+                                     const bool partial)
+{
+    const auto tiles = std::move(session.frameTiles);
+    const auto full =
+        !partial && !session.frameHasCopies && !session.frameIsIncomplete;
+    session.frameTiles.clear();
+    session.frameHasCopies = false;
+    session.frameIsIncomplete = false;
+
+    if (session.waitForFullFrame && !full)
+    {
+        // The request itself may have been lost
+        _requestFullFrame(id, session);
+        return;
+    }
+    session.waitForFullFrame = false;
+
+    for (const auto& tile : tiles)
+        emit receivedTile(session.uri, id, tile);
+    if (partial)
+        emit receivedPartialFrameFinished(session.uri, id);
+    else
+        emit receivedFrameFinished(session.uri, id);
+}
+
+void MulticastReceiver::_dropFrame(const uint32_t id, Session& session)
+{
+    session.frameTiles.clear();
+    session.frameHasCopies = false;
+    session.frameIsIncomplete = true;
+    _requestFullFrame(id, session);
+}
+
+void MulticastReceiver::_requestFullFrame(const uint32_t id, Session& session)
+{
+    session.waitForFullFrame = true;
+    _socket->writeDatagram(makeFullFrameRequest(id), session.sender,
+                           session.repairPort);
+}
+
+void MulticastReceiver::_closeSession(const uint32_t id, Session& session)
+{
+    if (!session.uri.isEmpty() && !session.closed)
+        emit removeStreamSource(session.uri, id);
+    session.closed = true;
+}
+}
+}
@@ -0,0 +1,138 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_MULTICASTRECEIVER_H
+#define DEFLECT_SERVER_MULTICASTRECEIVER_H
+
+#include <deflect/MulticastProtocol.h>
+#include <deflect/server/Tile.h>
+#include <deflect/server/TileParser.h>
+
+#include <QObject>
+#include <QtNetwork/QHostAddress>
+
+#include <map>
+#include <vector>
+
+class QTimer;
+class QUdpSocket;
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Receive the pixel streams sent to a UDP multicast group.
+ *
+ * Each sending Stream is a source of the stream with the identifier that it
+ * announces. Missing datagrams are requested again from their sender, and a
+ * source which stops sending without closing is removed after a timeout.
+ *
+ * The tiles of a frame are only forwarded once it is finished. When datagrams
+ * could not be repaired, or when joining a session after its opening, the
+ * frames are dropped until a full frame, which is requested from the sender.
+ */
+class MulticastReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Join a multicast group.
+     *
+     * @param group the address of the multicast group.
+     * @param port the port of the multicast group.
+     * @throw std::runtime_error if the group could not be joined.
+     */
+    MulticastReceiver(const QHostAddress& group, quint16 port);
+
+    /** Remove the sources which are still open. */
+    ~MulticastReceiver();
+
+public slots:
+    void start();
+
+signals:
+    void addStreamSource(QString uri, size_t sourceIndex);
+    void removeStreamSource(QString uri, size_t sourceIndex);
+
+    void receivedTile(QString uri, size_t sourceIndex,
+                      deflect::server::Tile tile);
+    void receivedFrameFinished(QString uri, size_t sourceIndex);
+    void receivedPartialFrameFinished(QString uri, size_t sourceIndex);
+
+    void connectionError(QString uri, QString what);
+
+private:
+    using Clock = DatagramAssembler::Clock;
+
+    struct Session
+    {
+        QHostAddress sender;
+        quint16 repairPort = 0;
+        Clock::time_point lastReceived;
+        DatagramAssembler assembler;
+        TileParser tileParser;
+        QString uri;
+        bool closed = false;
+
+        std::vector<Tile> frameTiles; // of the frame being received
+        bool frameHasCopies = false;
+        bool frameIsIncomplete = false;
+        bool waitForFullFrame = false;
+    };
+
+    QUdpSocket* _socket = nullptr; // child QObject
+    QTimer* _timer = nullptr;      // child QObject
+    std::map<uint32_t, Session> _sessions;
+
+    void _readDatagrams();
+    void _processSessions();
+    void _takeMessages(uint32_t id, Session& session, uint64_t lostCount);
+    void _handleMessage(uint32_t id, Session& session,
+                        const MessageHeader& header, const QByteArray& message);
+    void _finishFrame(uint32_t id, Session& session, bool partial);
+    void _dropFrame(uint32_t id, Session& session);
+    void _requestFullFrame(uint32_t id, Session& session);
+    void _closeSession(uint32_t id, Session& session);
+};
+}
+}
+
+#endif
@@ -81,13 +81,18 @@ void ReceiveBuffer::insert(const Tile& tile, const size_t sourceIndex)
 
 void ReceiveBuffer::finishFrameForSource(const size_t sourceIndex)
 {
-    assert(_sourceBuffers.count(sourceIndex));
+    _getBufferToFinish(sourceIndex).push();
+}
 
-    auto& buffer = _sourceBuffers[sourceIndex];
-    if (buffer.getQueueSize() > MAX_QUEUE_SIZE)
-        throw std::runtime_error("maximum queue size exceeded");
+void ReceiveBuffer::finishPartialFrameForSource(const size_t sourceIndex)
+{
+    _getBufferToFinish(sourceIndex).pushPartial();
+}
 
-    buffer.push();
+bool ReceiveBuffer::needsFullFrame(const size_t sourceIndex) const
+{
+    const auto it = _sourceBuffers.find(sourceIndex);
+    return it != _sourceBuffers.end() && it->second.needsFullFrame();
 }
 
 bool ReceiveBuffer::hasCompleteFrame() const
@@ -102,6 +107,34 @@ bool ReceiveBuffer::hasCompleteFrame() const
     return !_sourceBuffers.empty();
 }
 
+bool ReceiveBuffer::isNextFrameCopying() const
+{
+    for (const auto& kv : _sourceBuffers)
+    {
+        const auto& buffer = kv.second;
+        if (buffer.getBackFrameIndex() > _lastFrameComplete &&
+            buffer.hasCopies())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ReceiveBuffer::isNextFrameIncomplete() const
+{
+    for (const auto& kv : _sourceBuffers)
+    {
+        const auto& buffer = kv.second;
+        if (buffer.getBackFrameIndex() > _lastFrameComplete &&
+            buffer.isIncomplete())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
 Tiles ReceiveBuffer::popFrame()
 {
     Tiles frame;
@@ -128,5 +161,16 @@ bool ReceiveBuffer::isAllowedToSend() const
 {
     return _allowedToSend;
 }
+
+SourceBuffer& ReceiveBuffer::_getBufferToFinish(const size_t sourceIndex)
+{
+    assert(_sourceBuffers.count(sourceIndex));
+
+    auto& buffer = _sourceBuffers[sourceIndex];
+    if (buffer.getQueueSize() > MAX_QUEUE_SIZE)
+        throw std::runtime_error("maximum queue size exceeded");
+
+    return buffer;
+}
 }
 }
@@ -90,9 +90,44 @@ public:
      */
     DEFLECT_API void finishFrameForSource(size_t sourceIndex);
 
+    /**
+     * Call when the source has finished sending tiles which only update a part
+     * of its previous frame.
+     *
+     * The tiles of the previous frame which are not fully covered by a new tile
+     * of the same view and channel are kept in the current frame. Shared memory
+     * tiles are only kept for the sources which already sent partial frames
+     * before, see needsFullFrame().
+     * @param sourceIndex Unique source identifier
+     * @throw std::runtime_error if the buffer exceeds its maximum size
+     */
+    DEFLECT_API void finishPartialFrameForSource(size_t sourceIndex);
+
+    /**
+     * @param sourceIndex Unique source identifier
+     * @return true if the frames of the source remain incomplete until it
+     *         sends a full frame.
+     * @see SourceBuffer::needsFullFrame()
+     */
+    DEFLECT_API bool needsFullFrame(size_t sourceIndex) const;
+
     /** Does the Buffer have a new complete frame (from all sources) */
     DEFLECT_API bool hasCompleteFrame() const;
 
+    /**
+     * @return true if the next frame copies regions of its previous frame (see
+     *         Format::copy), in which case the previous frame must not be
+     *         skipped.
+     */
+    DEFLECT_API bool isNextFrameCopying() const;
+
+    /**
+     * @return true if the next frame only updates its previous frame, because
+     *         it has copies or because some of the regions moved by earlier
+     *         copies are missing from its tiles.
+     */
+    DEFLECT_API bool isNextFrameIncomplete() const;
+
     /**
      * Get the finished frame.
      * @return A collection of tiles that form a frame
@@ -110,6 +145,8 @@ private:
     FrameIndex _lastFrameComplete = 0;
     std::map<size_t, SourceBuffer> _sourceBuffers;
     bool _allowedToSend = false;
+
+    SourceBuffer& _getBufferToFinish(size_t sourceIndex);
 };
 }
 }
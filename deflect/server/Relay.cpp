@@ -0,0 +1,510 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "Relay.h"
+
+#include "Frame.h"
+#include "Server.h"
+#include "deflect/NetworkProtocol.h"
+#include "deflect/RelayStream.h"
+#include "deflect/Segment.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace deflect
+{
+namespace server
+{
+namespace
+{
+/** Frames queued for a downstream server, older ones are dropped. */
+const size_t maxQueuedFrames = 2;
+
+/** Time after which a downstream server not receiving a frame is given up. */
+const auto sendTimeout = std::chrono::seconds(10);
+
+struct Downstream
+{
+    QString address;
+    std::string host;
+    unsigned short port;
+};
+
+Downstream _parseDownstream(const QString& address)
+{
+    if (address.startsWith(UNIX_SOCKET_HOST_PREFIX))
+        return {address, address.toStdString(), DEFAULT_PORT_NUMBER};
+
+    const auto separator = address.lastIndexOf(':');
+    if (separator < 0)
+        return {address, address.toStdString(), DEFAULT_PORT_NUMBER};
+
+    bool valid = false;
+    const auto port = address.mid(separator + 1).toUShort(&valid);
+    if (separator == 0 || !valid || port == 0)
+        throw std::runtime_error("Invalid downstream server address: " +
+                                 address.toStdString());
+    return {address, address.left(separator).toStdString(), port};
+}
+
+bool _hasCopies(const Frame& frame)
+{
+    return std::any_of(frame.tiles.begin(), frame.tiles.end(),
+                       [](const Tile& tile) {
+                           return tile.format == Format::copy;
+                       });
+}
+
+Segments _makeSegments(const Frame& frame)
+{
+    // Undo the mirroring of the tiles positions done by the FrameDispatcher
+    const bool mirror = frame.determineRowOrder() == RowOrder::bottom_up;
+    const auto sizes = frame.computeChannelDimensions();
+
+    Segments segments;
+    segments.reserve(frame.tiles.size());
+    for (const auto& tile : frame.tiles)
+    {
+        const auto height = uint32_t(sizes.at(tile.channel).height());
+        auto y = tile.y;
+        auto sourceY = tile.sourceY;
+        if (mirror)
+        {
+            y = height - tile.y - tile.height;
+            sourceY = height - tile.sourceY - tile.height;
+        }
+
+        Segment segment;
+        segment.parameters.x = tile.x;
+        segment.parameters.y = y;
+        segment.parameters.width = tile.width;
+        segment.parameters.height = tile.height;
+        segment.parameters.format = tile.format;
+        if (tile.format == Format::copy)
+        {
+            const uint32_t source[] = {tile.sourceX, sourceY};
+            segment.imageData = QByteArray((const char*)source, sizeof(source));
+        }
+        else
+            segment.imageData = tile.imageData;
+        segment.view = tile.view;
+        segment.rowOrder = tile.rowOrder;
+        segment.channel = tile.channel;
+        segments.push_back(std::move(segment));
+    }
+    return segments;
+}
+
+/**
+ * The connection of a relayed stream to a downstream server.
+ *
+ * The stream is opened and fed from the link's own thread, so that a slow
+ * downstream server does not hold back the server nor the other links.
+ */
+class Link : public QThread
+{
+public:
+    using Message = std::function<void(RelayStream&)>;
+    using ErrorHandler = std::function<void(QString)>;
+
+    Link(const QString& uri, const Downstream& downstream,
+         std::atomic<size_t>& droppedFrames, const ErrorHandler& onError)
+        : _uri{uri}
+        , _downstream(downstream)
+        , _droppedFrames(droppedFrames)
+        , _onError{onError}
+    {
+    }
+
+    ~Link()
+    {
+        stop();
+        wait();
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _condition.notify_one();
+    }
+
+    void push(FramePtr frame)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_failed)
+                return;
+
+            // The previous frame that this one updates is lost
+            if (_waitForFullFrame && frame->incremental)
+            {
+                ++_droppedFrames;
+                return;
+            }
+            _waitForFullFrame = false;
+            _frames.push_back(std::move(frame));
+            _dropStaleFrames();
+        }
+        _condition.notify_one();
+    }
+
+    void push(Message message)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_failed)
+                return;
+            _messages.push_back(std::move(message));
+        }
+        _condition.notify_one();
+    }
+
+protected:
+    void run() final
+    {
+        // Destroyed after the stream, which may still be sending the frame
+        std::vector<Message> messages;
+        FramePtr frame;
+
+        // The connection and the handshake are bounded by the socket timeouts
+        std::unique_ptr<RelayStream> stream;
+        try
+        {
+            stream.reset(new RelayStream(_uri.toStdString(), _downstream.host,
+                                         _downstream.port));
+        }
+        catch (const std::exception& e)
+        {
+            _fail(e.what());
+            return;
+        }
+        if (!stream->isConnected())
+        {
+            _fail("Could not connect to the downstream server");
+            return;
+        }
+
+        while (_waitForWork(messages, frame))
+        {
+            try
+            {
+                for (auto& message : messages)
+                    message(*stream);
+                if (frame && !_send(*stream, *frame))
+                    throw std::runtime_error("Could not send frame");
+            }
+            catch (const std::exception& e)
+            {
+                _fail(e.what());
+                return;
+            }
+            messages.clear();
+            frame.reset();
+
+            if (!stream->isConnected())
+            {
+                _fail("Connection to the downstream server lost");
+                return;
+            }
+        }
+    }
+
+private:
+    const QString _uri;
+    const Downstream _downstream;
+    std::atomic<size_t>& _droppedFrames;
+    const ErrorHandler _onError;
+
+    std::mutex _mutex;
+    std::condition_variable _condition;
+    std::deque<FramePtr> _frames;
+    std::vector<Message> _messages;
+    bool _waitForFullFrame = false;
+    bool _stopping = false;
+    bool _failed = false;
+
+    void _dropStaleFrames()
+    {
+        while (_frames.size() > maxQueuedFrames)
+        {
+            // Drop the oldest frame that the next ones can do without
+            size_t i = 0;
+            while (i + 1 < _frames.size() && !_canDrop(i))
+                ++i;
+
+            if (i + 1 == _frames.size())
+            {
+                _droppedFrames += _frames.size();
+                _frames.clear();
+                _waitForFullFrame = true;
+                return;
+            }
+            _frames.erase(_frames.begin() + i);
+            ++_droppedFrames;
+        }
+    }
+
+    bool _canDrop(const size_t i) const
+    {
+        // Frames which copy regions of their previous frame must not skip it,
+        // nor be skipped as the next frames do not include the copied regions.
+        // The first incremental frame must not skip the last complete one.
+        return !_hasCopies(*_frames[i]) && !_hasCopies(*_frames[i + 1]) &&
+               (_frames[i]->incremental || !_frames[i + 1]->incremental);
+    }
+
+    bool _waitForWork(std::vector<Message>& messages, FramePtr& frame)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _condition.wait(lock, [this] {
+            return _stopping || !_messages.empty() || !_frames.empty();
+        });
+        if (_stopping)
+            return false;
+
+        messages.swap(_messages);
+        if (!_frames.empty())
+        {
+            frame = std::move(_frames.front());
+            _frames.pop_front();
+        }
+        return true;
+    }
+
+    bool _send(RelayStream& stream, const Frame& frame)
+    {
+        // Incremental frames without copies are partial frames downstream
+        const bool partial = frame.incremental && !_hasCopies(frame);
+        bool supported = !partial || stream.supportsPartialFrames();
+        for (const auto& tile : frame.tiles)
+            supported = supported && stream.supportsFormat(tile.format);
+        if (!supported)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_droppedFrames;
+            _dropIncrementalFrames();
+            return true;
+        }
+        // The frame keeps the data of shared memory tiles valid until sent
+        auto sent = stream.sendFrame(_makeSegments(frame), partial);
+        if (sent.wait_for(sendTimeout) != std::future_status::ready)
+            throw std::runtime_error("Timeout sending frame");
+        return sent.get();
+    }
+
+    void _dropIncrementalFrames()
+    {
+        while (!_frames.empty() && _frames.front()->incremental)
+        {
+            _frames.pop_front();
+            ++_droppedFrames;
+        }
+        _waitForFullFrame = _frames.empty();
+    }
+
+    void _fail(const QString& what)
+    {
+        bool stopping = false;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _failed = true;
+            _frames.clear();
+            _messages.clear();
+            stopping = _stopping;
+        }
+        // The errors of the closed streams are not reported
+        if (!stopping)
+            _onError(what);
+    }
+};
+}
+
+class Relay::Impl
+{
+public:
+    Impl(Server& server_, const QStringList& addresses)
+        : server(server_)
+    {
+        for (const auto& address : addresses)
+            downstreams.push_back(_parseDownstream(address));
+    }
+
+    Server& server;
+    std::vector<Downstream> downstreams;
+    std::map<QString, std::vector<std::unique_ptr<Link>>> links;
+    std::vector<std::unique_ptr<Link>> closingLinks; // stopped, still running
+    std::atomic<size_t> droppedFrames{0};
+
+    template <typename T>
+    void push(const QString& uri, T item)
+    {
+        const auto it = links.find(uri);
+        if (it == links.end())
+            return;
+
+        for (auto& link : it->second)
+            link->push(item);
+    }
+
+    void stop(const std::vector<std::unique_ptr<Link>>& streamLinks)
+    {
+        // Stop all the links before waiting for any of them
+        for (auto& link : streamLinks)
+            link->stop();
+    }
+
+    void forget(const Link* link)
+    {
+        const auto isLink = [link](const std::unique_ptr<Link>& closing) {
+            return closing.get() == link;
+        };
+        closingLinks.erase(std::remove_if(closingLinks.begin(),
+                                          closingLinks.end(), isLink),
+                           closingLinks.end());
+    }
+};
+
+Relay::Relay(Server& server, const QStringList& downstreams, QObject* parent)
+    : QObject(parent)
+    , _impl(new Impl(server, downstreams))
+{
+    connect(&server, &Server::pixelStreamOpened, this, &Relay::_openStream);
+    connect(&server, &Server::pixelStreamClosed, this, &Relay::_closeStream);
+    connect(&server, &Server::receivedFrame, this, &Relay::_relayFrame);
+
+    connect(&server, &Server::receivedSizeHints, this,
+            [this](const QString uri, const SizeHints hints) {
+                _impl->push(uri, Link::Message([hints](RelayStream& stream) {
+                                stream.sendSizeHints(hints);
+                            }));
+            });
+    connect(&server, &Server::receivedData, this,
+            [this](const QString uri, const QByteArray data) {
+                _impl->push(uri, Link::Message([data](RelayStream& stream) {
+                                if (!stream.sendData(data.constData(),
+                                                     data.size()))
+                                {
+                                    throw std::runtime_error(
+                                        "Could not send data");
+                                }
+                            }));
+            });
+}
+
+Relay::~Relay()
+{
+    for (const auto& kv : _impl->links)
+        _impl->stop(kv.second);
+    _impl->links.clear();
+    _impl->closingLinks.clear();
+}
+
+size_t Relay::getDroppedFrames() const
+{
+    return _impl->droppedFrames;
+}
+
+void Relay::_openStream(const QString uri)
+{
+    auto& streamLinks = _impl->links[uri];
+    if (!streamLinks.empty())
+        return;
+
+    for (const auto& downstream : _impl->downstreams)
+    {
+        const auto address = downstream.address;
+        auto onError = [this, uri, address](const QString what) {
+            emit relayError(uri, address, what);
+        };
+        streamLinks.emplace_back(
+            new Link(uri, downstream, _impl->droppedFrames, onError));
+        streamLinks.back()->start();
+    }
+    _impl->server.requestFrame(uri);
+}
+
+void Relay::_closeStream(const QString uri)
+{
+    const auto it = _impl->links.find(uri);
+    if (it == _impl->links.end())
+        return;
+
+    // The links may be blocked by their downstream server, never wait for
+    // them in the thread of the server
+    _impl->stop(it->second);
+    for (auto& link : it->second)
+    {
+        const auto closing = link.get();
+        _impl->closingLinks.push_back(std::move(link));
+        connect(closing, &QThread::finished, this,
+                [this, closing] { _impl->forget(closing); });
+        if (closing->isFinished())
+            _impl->forget(closing);
+    }
+    _impl->links.erase(it);
+}
+
+void Relay::_relayFrame(const FramePtr frame)
+{
+    if (!_impl->links.count(frame->uri))
+        return;
+
+    _impl->push(frame->uri, frame);
+
+    // Not called directly, which would emit the next frame recursively
+    QMetaObject::invokeMethod(&_impl->server, "requestFrame",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, frame->uri));
+}
+}
+}
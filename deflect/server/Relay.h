@@ -0,0 +1,123 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_RELAY_H
+#define DEFLECT_SERVER_RELAY_H
+
+#include <deflect/api.h>
+#include <deflect/server/types.h>
+
+#include <QObject>
+#include <QStringList>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Relay the streams of a Server to other Servers.
+ *
+ * The compressed tiles of the received frames are forwarded as they are to
+ * each downstream server, without decoding them. Relays can be chained to
+ * distribute streams along a tree (e.g. lab -> wall cluster -> wall nodes).
+ *
+ * Each downstream server has its own connection thread and a short queue of
+ * frames. When a downstream server is too slow, the oldest queued frames are
+ * dropped in favor of the newer ones. Frames which copy regions of their
+ * previous frame are never dropped, nor the frame before them or before the
+ * first Frame::incremental one; if that is not possible, all the frames are
+ * dropped until the next one which is not Frame::incremental. A downstream
+ * server which does not receive a frame within 10 seconds is given up.
+ *
+ * The relay requests the frames of the streams from the server, which the
+ * application must not do itself. It can still observe the frames that the
+ * server emits, but must not modify them (i.e. decode them in place). Size
+ * hints and data are also relayed; events from the downstream servers are
+ * not sent back to the streams.
+ */
+class DEFLECT_API Relay : public QObject
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Relay the streams of a server.
+     *
+     * Must be created in the thread of the server.
+     *
+     * @param server the server receiving the streams to relay.
+     * @param downstreams the "host[:port]" of each server to relay the streams
+     *        to, or "unix:/path/to/socket" for servers on the same machine.
+     * @param parent the parent object.
+     * @throw std::runtime_error if a downstream address is invalid.
+     */
+    Relay(Server& server, const QStringList& downstreams,
+          QObject* parent = nullptr);
+
+    /** Close the relayed streams, waiting for their connection threads. */
+    ~Relay();
+
+    /**
+     * @return the number of frames dropped so far, because a downstream server
+     *         was too slow or could not receive their format.
+     */
+    size_t getDroppedFrames() const;
+
+signals:
+    /**
+     * Notify that a stream could no longer be relayed to a downstream server.
+     *
+     * @param uri Identifier for the stream
+     * @param downstream the address of the downstream server
+     * @param what The error message
+     */
+    void relayError(QString uri, QString downstream, QString what);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> _impl;
+
+    void _openStream(QString uri);
+    void _closeStream(QString uri);
+    void _relayFrame(FramePtr frame);
+};
+}
+}
+
+#endif
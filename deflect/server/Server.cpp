@@ -41,14 +41,21 @@
 #include "Server.h"
 
 #include "FrameDispatcher.h"
+#include "MulticastReceiver.h"
 #include "ServerWorker.h"
 #include "deflect/NetworkProtocol.h"
+#include "deflect/Visibility.h"
 
 #include <QThread>
+#include <QtNetwork/QLocalServer>
 #include <QtNetwork/QNetworkProxy>
 #include <QtNetwork/QTcpServer>
 
+#include <algorithm>
+#include <functional>
+
 #include <stdexcept>
+#include <vector>
 
 namespace deflect
 {
@@ -56,6 +63,52 @@ namespace server
 {
 const int Server::defaultPortNumber = DEFAULT_PORT_NUMBER;
 
+namespace
+{
+/**
+ * Accept connections on a unix socket path.
+ *
+ * The native descriptors of the connections are forwarded to the same
+ * QTcpSocket-based workers as the TCP connections.
+ */
+class UnixSocketServer : public QLocalServer
+{
+public:
+    using Handler = std::function<void(qintptr)>;
+
+    UnixSocketServer(const QString& path, const Handler& handler,
+                     QObject* parent_)
+        : QLocalServer(parent_)
+        , _handler{handler}
+    {
+#ifdef Q_OS_UNIX
+        QLocalServer::removeServer(path);
+        if (!listen(path))
+        {
+            const auto err =
+                QString("could not listen on unix socket: %1. QLocalServer: %2")
+                    .arg(path)
+                    .arg(errorString());
+            throw std::runtime_error(err.toStdString());
+        }
+#else
+        throw std::runtime_error("unix sockets are not supported, could not "
+                                 "listen on " +
+                                 path.toStdString());
+#endif
+    }
+
+protected:
+    void incomingConnection(const quintptr socketHandle) final
+    {
+        _handler(socketHandle);
+    }
+
+private:
+    Handler _handler;
+};
+}
+
 class Server::Impl : public QTcpServer
 {
 public:
@@ -87,25 +140,33 @@ public:
         }
     }
 
+    void listenUnixSocket(const QString& path)
+    {
+        unixSocketServer = new UnixSocketServer(
+            path,
+            [this](const qintptr socketHandle) {
+                incomingConnection(socketHandle);
+            },
+            this);
+    }
+
     /** Re-implemented handling of connections from QTCPSocket. */
     void incomingConnection(const qintptr socketHandle) final
     {
         try
         {
             auto worker = new ServerWorker(socketHandle);
-            auto workerThread = new QThread(this);
+            worker->setMulticastGroup(multicastGroup);
+            worker->setSolidAndCopyTilesEnabled(solidAndCopyTilesEnabled);
+            auto workerThread = getWorkerThread();
             worker->moveToThread(workerThread);
 
-            connect(workerThread, &QThread::started, worker,
-                    &ServerWorker::initConnection);
-            connect(worker, &ServerWorker::connectionClosed, workerThread,
-                    &QThread::quit);
+            connect(worker, &ServerWorker::connectionClosed, worker,
+                    &ServerWorker::deleteLater);
 
-            // Make sure the thread will be deleted
+            // Make sure the worker will be deleted with the thread
             connect(workerThread, &QThread::finished, worker,
                     &ServerWorker::deleteLater);
-            connect(workerThread, &QThread::finished, workerThread,
-                    &QThread::deleteLater);
 
             // public signals/slots, forwarding from/to worker
             connect(worker, &ServerWorker::registerToEvents, server,
@@ -118,6 +179,8 @@ public:
                     &Server::pixelStreamException);
             connect(server, &Server::_closePixelStream, worker,
                     &ServerWorker::closeConnections);
+            connect(server, &Server::_sendVisibility, worker,
+                    &ServerWorker::sendVisibility);
 
             // FrameDispatcher
             // direct connection to avoid race with receivedTile in early tiles
@@ -125,12 +188,18 @@ public:
                     &FrameDispatcher::addSource, Qt::DirectConnection);
             connect(frameDispatcher, &FrameDispatcher::sourceRejected, worker,
                     &ServerWorker::closeConnection);
+            connect(frameDispatcher, &FrameDispatcher::fullFrameRequested,
+                    worker, &ServerWorker::requestFullFrame);
             // direct connection for performance
             connect(worker, &ServerWorker::receivedTile, frameDispatcher,
                     &FrameDispatcher::processTile, Qt::DirectConnection);
             connect(worker, &ServerWorker::receivedFrameFinished,
                     frameDispatcher, &FrameDispatcher::processFrameFinished,
                     Qt::DirectConnection);
+            connect(worker, &ServerWorker::receivedPartialFrameFinished,
+                    frameDispatcher,
+                    &FrameDispatcher::processPartialFrameFinished,
+                    Qt::DirectConnection);
             connect(worker, &ServerWorker::removeStreamSource, frameDispatcher,
                     &FrameDispatcher::removeSource);
             connect(worker, &ServerWorker::addObserver, frameDispatcher,
@@ -138,7 +207,8 @@ public:
             connect(worker, &ServerWorker::removeObserver, frameDispatcher,
                     &FrameDispatcher::removeObserver);
 
-            workerThread->start();
+            QMetaObject::invokeMethod(worker, "initConnection",
+                                      Qt::QueuedConnection);
         }
         catch (const std::runtime_error& e)
         {
@@ -146,10 +216,75 @@ public:
         }
     }
 
+    void joinMulticastGroup(const QHostAddress& group, const quint16 port)
+    {
+        auto receiver = new MulticastReceiver(group, port);
+        auto receiverThread = new QThread(this);
+        receiver->moveToThread(receiverThread);
+
+        connect(receiverThread, &QThread::started, receiver,
+                &MulticastReceiver::start);
+        connect(receiverThread, &QThread::finished, receiver,
+                &MulticastReceiver::deleteLater);
+        connect(receiverThread, &QThread::finished, receiverThread,
+                &QThread::deleteLater);
+
+        connect(receiver, &MulticastReceiver::connectionError, server,
+                &Server::pixelStreamException);
+
+        // FrameDispatcher, same as for the ServerWorkers
+        connect(receiver, &MulticastReceiver::addStreamSource, frameDispatcher,
+                &FrameDispatcher::addSource, Qt::DirectConnection);
+        connect(receiver, &MulticastReceiver::receivedTile, frameDispatcher,
+                &FrameDispatcher::processTile, Qt::DirectConnection);
+        connect(receiver, &MulticastReceiver::receivedFrameFinished,
+                frameDispatcher, &FrameDispatcher::processFrameFinished,
+                Qt::DirectConnection);
+        connect(receiver, &MulticastReceiver::receivedPartialFrameFinished,
+                frameDispatcher, &FrameDispatcher::processPartialFrameFinished,
+                Qt::DirectConnection);
+        connect(receiver, &MulticastReceiver::removeStreamSource,
+                frameDispatcher, &FrameDispatcher::removeSource);
+
+        receiverThread->start();
+    }
+
+    /**
+     * Get the thread for a new ServerWorker.
+     *
+     * The workers share a pool of threads instead of having one each, which
+     * does not scale to the hundreds of connections of many-rank renderers.
+     * Workers process one message at a time, so the connections sharing a
+     * thread are served in turn.
+     */
+    QThread* getWorkerThread()
+    {
+        const auto maxThreads = std::max(QThread::idealThreadCount(), 1);
+        if (workerThreads.size() < size_t(maxThreads))
+        {
+            workerThreads.push_back(new QThread(this));
+            workerThreads.back()->start();
+            return workerThreads.back();
+        }
+        nextWorkerThread = (nextWorkerThread + 1) % workerThreads.size();
+        return workerThreads[nextWorkerThread];
+    }
+
     Server* server = nullptr;
     FrameDispatcher* frameDispatcher = nullptr; // owned by QObject's parent
+    QLocalServer* unixSocketServer = nullptr;   // owned by QObject's parent
+    QString multicastGroup; // address:port offered to the new connections
+    bool solidAndCopyTilesEnabled = false;
+    std::vector<QThread*> workerThreads; // owned by QObject's parent
+    size_t nextWorkerThread = 0;
 };
 
+Server::Server(const int port, const QString& unixSocketPath)
+    : Server(port)
+{
+    _impl->listenUnixSocket(unixSocketPath);
+}
+
 Server::Server(const int port)
     : _impl(new Impl(port, this))
 {
@@ -179,11 +314,50 @@ quint16 Server::getPort() const
     return _impl->serverPort();
 }
 
+QString Server::getUnixSocketPath() const
+{
+    if (!_impl->unixSocketServer)
+        return QString();
+    return _impl->unixSocketServer->fullServerName();
+}
+
+void Server::setMulticastGroup(const QString& address, const quint16 port)
+{
+    if (address.isEmpty())
+        _impl->multicastGroup.clear();
+    else
+        _impl->multicastGroup = QString("%1:%2").arg(address).arg(port);
+}
+
+void Server::setSolidAndCopyTilesEnabled(const bool enabled)
+{
+    _impl->solidAndCopyTilesEnabled = enabled;
+}
+
+void Server::joinMulticastGroup(const QString& address, const quint16 port)
+{
+    _impl->joinMulticastGroup(QHostAddress(address), port);
+}
+
 void Server::requestFrame(const QString uri)
 {
     _impl->frameDispatcher->requestFrame(uri);
 }
 
+void Server::setRegionOfInterest(const QString uri, const QRect region)
+{
+    _impl->frameDispatcher->setRegionOfInterest(uri, region);
+}
+
+void Server::sendVisibility(const QString uri, const QVector<QRect> regions,
+                            const double scale)
+{
+    Visibility visibility;
+    visibility.regions.assign(regions.begin(), regions.end());
+    visibility.scale = scale;
+    emit _sendVisibility(uri, serializeVisibility(visibility));
+}
+
 void Server::closePixelStream(const QString uri)
 {
     emit _closePixelStream(uri);
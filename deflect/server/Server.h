@@ -46,6 +46,8 @@
 #include <deflect/server/types.h>
 
 #include <QObject>
+#include <QRect>
+#include <QVector>
 
 namespace deflect
 {
@@ -75,12 +77,72 @@ public:
      */
     explicit Server(int port = defaultPortNumber);
 
+    /**
+     * Create a new server listening for Stream connections on both a TCP port
+     * and a unix socket path.
+     *
+     * Streams running on the same machine can connect to the unix socket with
+     * a "unix:/path/to/socket" host, bypassing the TCP stack. Any stale socket
+     * file left at the given path is removed. Only supported on unix systems.
+     *
+     * @param port The port to listen on. Must be available.
+     * @param unixSocketPath The path of the unix socket to listen on.
+     * @throw std::runtime_error if the server could not be started.
+     */
+    Server(int port, const QString& unixSocketPath);
+
     /** Stop the server and close all open pixel stream connections. */
     ~Server();
 
     /** @return the port on which the server is running. */
     quint16 getPort() const;
 
+    /** @return the unix socket path of the server, empty if not listening. */
+    QString getUnixSocketPath() const;
+
+    /**
+     * Make the Streams send their images to a UDP multicast group.
+     *
+     * The Servers which joined the group with joinMulticastGroup(), e.g. one
+     * in each process of a display wall, all receive the frames at once. The
+     * other messages and the events still go through the connection to this
+     * server, which no longer receives the frames of these streams.
+     * Only applies to the Streams which connect afterwards and support it; the
+     * others keep sending their frames to this server.
+     *
+     * @param address the address of the multicast group, empty to disable.
+     * @param port the port of the multicast group.
+     */
+    void setMulticastGroup(const QString& address, quint16 port);
+
+    /**
+     * Receive the frames that Streams send to a UDP multicast group.
+     *
+     * The Streams sending to the group are opened and closed like the ones
+     * which connect to this server, but they can't receive events from it.
+     * Lost datagrams are requested again from the Streams.
+     *
+     * @param address the address of the multicast group.
+     * @param port the port of the multicast group.
+     * @throw std::runtime_error if the group could not be joined.
+     */
+    void joinMulticastGroup(const QString& address, quint16 port);
+
+    /**
+     * Let the Streams send tiles in Format::solid and Format::copy.
+     *
+     * These formats save bandwidth for uniform and scrolling content, but the
+     * application must then decode the solid tiles (e.g. with a TileDecoder)
+     * and apply the copies to the previous frame (e.g. with a
+     * FrameCompositor). Otherwise the received frames only contain tiles in
+     * the Format of the images sent by the Streams.
+     * Only applies to the Streams which connect afterwards, including the ones
+     * sending their frames to a multicast group.
+     *
+     * @param enabled true to accept the solid and copy tiles (default: false).
+     */
+    void setSolidAndCopyTilesEnabled(bool enabled);
+
 public slots:
     /**
      * Request the dispatching of the next frame for a given pixel stream.
@@ -95,6 +157,36 @@ public slots:
      */
     void requestFrame(QString uri);
 
+    /**
+     * Only dispatch the tiles of a stream which intersect a region.
+     *
+     * Useful when the application only displays a part of a stream, to avoid
+     * receiving (and decoding) the other tiles. The received frames keep the
+     * dimensions of the full frame, and frames which have no tile in the
+     * region are not dispatched.
+     *
+     * @param uri Identifier for the stream
+     * @param region the region of interest in pixel coordinates of the frame,
+     *        or an empty rectangle to receive the full frames (default).
+     */
+    void setRegionOfInterest(QString uri, QRect region);
+
+    /**
+     * Tell a stream which parts of its frames are currently displayed.
+     *
+     * The Stream skips the segments of its next images which are outside of
+     * the visible regions and lowers the quality of the images displayed at a
+     * reduced scale. Streams are fully visible until this method is called,
+     * the visibility should be sent again when a stream is (re)opened.
+     * Ignored by streams using an older protocol version.
+     *
+     * @param uri Identifier for the stream
+     * @param regions the visible regions in pixel coordinates of the frame,
+     *        none if the stream is not visible at all (e.g. minimized).
+     * @param scale the ratio between the displayed and the actual frame size.
+     */
+    void sendVisibility(QString uri, QVector<QRect> regions, double scale);
+
     /**
      * Close a pixel stream, disconnecting the remote client.
      *
@@ -172,6 +264,9 @@ private:
 signals:
     /** @internal */
     void _closePixelStream(QString uri);
+
+    /** @internal */
+    void _sendVisibility(QString uri, QByteArray visibility);
 };
 }
 }
@@ -42,16 +42,17 @@
 
 #include "deflect/NetworkProtocol.h"
 #include "deflect/SegmentParameters.h"
+#include "deflect/SharedMemoryRing.h"
 
 #include <QDataStream>
+#include <QThread>
+#include <QtConcurrentRun>
 
 #include <cstdint>
 #include <stdexcept>
 
 namespace
 {
-const int RECEIVE_TIMEOUT_MS = 3000;
-
 class protocol_error : public std::runtime_error
 {
     using runtime_error::runtime_error;
@@ -72,7 +73,8 @@ ServerWorker::ServerWorker(const int socketDescriptor)
     : _tcpSocket{new QTcpSocket(this)} // Ensure that _tcpSocket parent is
                                        // *this* so it gets moved to thread
     , _sourceId{socketDescriptor}
-    , _clientProtocolVersion{NETWORK_PROTOCOL_VERSION}
+    , _clientProtocolVersion{MIN_NETWORK_PROTOCOL_VERSION}
+    , _bindWatcher{new QFutureWatcher<bool>(this)}
 {
     if (!_tcpSocket->setSocketDescriptor(socketDescriptor))
     {
@@ -87,10 +89,28 @@ ServerWorker::ServerWorker(const int socketDescriptor)
             &ServerWorker::_processMessages, Qt::QueuedConnection);
     connect(this, &ServerWorker::_dataAvailable, this,
             &ServerWorker::_processMessages, Qt::QueuedConnection);
+
+    // The answer of the application is awaited outside of the thread shared
+    // with the other workers
+    _bindWaitPool.setMaxThreadCount(1);
+    connect(_bindWatcher, &QFutureWatcher<bool>::finished, this,
+            &ServerWorker::_finishRegisteringForEvents);
 }
 
 ServerWorker::~ServerWorker()
 {
+    // Stop waiting for an application which did not answer the registration
+    if (_bindPromise)
+    {
+        try
+        {
+            _bindPromise->set_value(false);
+        }
+        catch (const std::future_error&)
+        {
+        }
+    }
+
     // If the sender crashed, we may not recieve the quit message.
     // We still want to remove this source so that the stream does not get stuck
     // if other senders are still active / resp. the window gets closed if no
@@ -98,13 +118,38 @@ ServerWorker::~ServerWorker()
     if (_isProtocolStarted())
         _notifyProtocolEnd();
 
-    if (_isConnected())
-        _sendQuit();
+    if (!_isConnected())
+        return;
+
+    _sendQuit();
+
+    // Let the socket send the remaining data and close in the background,
+    // unless the thread shared with the other workers is being stopped
+    if (thread()->isRunning())
+    {
+        _tcpSocket->setParent(nullptr);
+        connect(_tcpSocket, &QTcpSocket::disconnected, _tcpSocket,
+                &QTcpSocket::deleteLater);
+        connect(thread(), &QThread::finished, _tcpSocket,
+                &QTcpSocket::deleteLater);
+        _tcpSocket->disconnectFromHost();
+    }
+}
+
+void ServerWorker::setMulticastGroup(const QString& group)
+{
+    _multicastGroup = group;
+}
+
+void ServerWorker::setSolidAndCopyTilesEnabled(const bool enabled)
+{
+    _solidAndCopyTilesEnabled = enabled;
 }
 
 void ServerWorker::processEvent(const Event evt)
 {
-    _events.emplace_back(evt);
+    if (!_coalesce(evt))
+        _events.emplace_back(evt);
     emit _dataAvailable();
 }
 
@@ -125,6 +170,26 @@ void ServerWorker::closeConnection(const QString uri, const size_t sourceIndex)
         _terminateConnection();
 }
 
+void ServerWorker::sendVisibility(const QString uri,
+                                  const QByteArray visibility)
+{
+    if (uri == _streamId && !_observer &&
+        _clientProtocolVersion >= VISIBILITY_PROTOCOL_VERSION)
+    {
+        _sendVisibility(visibility);
+    }
+}
+
+void ServerWorker::requestFullFrame(const QString uri,
+                                    const size_t sourceIndex)
+{
+    if (uri == _streamId && sourceIndex == (size_t)_sourceId &&
+        _clientProtocolVersion >= FULL_FRAME_REQUEST_PROTOCOL_VERSION)
+    {
+        _sendFullFrameRequest();
+    }
+}
+
 void ServerWorker::_terminateConnection()
 {
     if (_registeredToEvents)
@@ -156,9 +221,9 @@ void ServerWorker::_receiveMessage()
 {
     try
     {
-        const auto messageHeader = _receiveMessageHeader();
-        const auto messageBody = _receiveMessageBody(messageHeader.size);
-        _handleMessage(messageHeader, messageBody);
+        _hasPendingHeader = false;
+        const auto messageBody = _tcpSocket->read(_pendingHeader.size);
+        _handleMessage(_pendingHeader, messageBody);
     }
     catch (const std::runtime_error& e)
     {
@@ -177,30 +242,21 @@ MessageHeader ServerWorker::_receiveMessageHeader()
     return messageHeader;
 }
 
-QByteArray ServerWorker::_receiveMessageBody(const int size)
+bool ServerWorker::_socketHasMessage()
 {
-    QByteArray messageData;
-
-    if (size > 0)
+    // Never wait for the rest of a message, which would block the connections
+    // sharing the thread: it is processed on a later readyRead instead.
+    if (!_hasPendingHeader)
     {
-        messageData = _tcpSocket->read(size);
-
-        while (messageData.size() < size)
+        if (_tcpSocket->bytesAvailable() <
+            (qint64)MessageHeader::serializedSize)
         {
-            if (!_tcpSocket->waitForReadyRead(RECEIVE_TIMEOUT_MS))
-                throw std::runtime_error("Timeout reading message data");
-
-            messageData.append(_tcpSocket->read(size - messageData.size()));
+            return false;
         }
+        _pendingHeader = _receiveMessageHeader();
+        _hasPendingHeader = true;
     }
-
-    return messageData;
-}
-
-bool ServerWorker::_socketHasMessage() const
-{
-    return _tcpSocket->bytesAvailable() >=
-           (qint64)MessageHeader::serializedSize;
+    return _tcpSocket->bytesAvailable() >= (qint64)_pendingHeader.size;
 }
 
 void ServerWorker::_handleMessage(const MessageHeader& messageHeader,
@@ -226,8 +282,27 @@ void ServerWorker::_handleMessage(const MessageHeader& messageHeader,
         emit receivedFrameFinished(_streamId, _sourceId);
         break;
 
+    case MESSAGE_TYPE_PIXELSTREAM_FINISH_PARTIAL_FRAME:
+        emit receivedPartialFrameFinished(_streamId, _sourceId);
+        break;
+
     case MESSAGE_TYPE_PIXELSTREAM:
-        emit receivedTile(_streamId, _sourceId, _parseTile(byteArray));
+        emit receivedTile(_streamId, _sourceId,
+                          _tileParser.parseTile(byteArray));
+        break;
+
+    case MESSAGE_TYPE_PIXELSTREAM_SHARED_MEMORY:
+        emit receivedTile(_streamId, _sourceId,
+                          _parseSharedMemoryTile(byteArray));
+        break;
+
+    case MESSAGE_TYPE_SHARED_MEMORY_OPEN:
+        _openSharedMemory(byteArray);
+        _sendSharedMemoryReply(_sharedMemory != nullptr);
+        break;
+
+    case MESSAGE_TYPE_MULTICAST_OPEN:
+        _sendMulticastReply();
         break;
 
     case MESSAGE_TYPE_SIZE_HINTS:
@@ -242,34 +317,16 @@ void ServerWorker::_handleMessage(const MessageHeader& messageHeader,
         break;
 
     case MESSAGE_TYPE_IMAGE_VIEW:
-    {
-        const auto view = reinterpret_cast<const View*>(byteArray.data());
-        if (*view >= View::mono && *view <= View::right_eye)
-            _activeView = *view;
-        break;
-    }
-
     case MESSAGE_TYPE_IMAGE_ROW_ORDER:
-    {
-        const auto order = reinterpret_cast<const RowOrder*>(byteArray.data());
-        if (*order >= RowOrder::top_down && *order <= RowOrder::bottom_up)
-            _activeRowOrder = *order;
-        break;
-    }
-
     case MESSAGE_TYPE_IMAGE_CHANNEL:
-    {
-        const auto channel = reinterpret_cast<const uint8_t*>(byteArray.data());
-        _activeChannel = *channel;
+        _tileParser.parseImageState(messageHeader.type, byteArray);
         break;
-    }
 
     case MESSAGE_TYPE_BIND_EVENTS:
     case MESSAGE_TYPE_BIND_EVENTS_EX:
     {
         const auto excl = messageHeader.type == MESSAGE_TYPE_BIND_EVENTS_EX;
-        _tryRegisteringForEvents(excl);
-        _sendBindReply(_registeredToEvents);
+        _tryRegisteringForEvents(excl); // replies once the application did
         break;
     }
 
@@ -305,6 +362,14 @@ void ServerWorker::_startProtocol(const QString& uri,
     _observer = observer;
     _parseClientProtocolVersion(byteArray);
 
+    // Sent before notifying the opening, for the stream to know the formats
+    // as soon as possible
+    if (!_observer && _solidAndCopyTilesEnabled &&
+        _clientProtocolVersion >= TILE_FORMATS_PROTOCOL_VERSION)
+    {
+        _sendTileFormats();
+    }
+
     if (_observer)
         emit addObserver(_streamId);
     else
@@ -347,41 +412,120 @@ void ServerWorker::_parseClientProtocolVersion(const QByteArray& message)
         _clientProtocolVersion = version;
 }
 
-Tile ServerWorker::_parseTile(const QByteArray& message) const
+Tile ServerWorker::_parseSharedMemoryTile(const QByteArray& message) const
 {
-    Tile tile;
+    if (!_sharedMemory)
+        throw protocol_error("Shared memory tile received before opening");
+
+    if (message.size() != sizeof(SegmentParameters) + sizeof(SharedMemorySlot))
+        throw protocol_error("Invalid shared memory tile message size");
 
     const auto data = message.data();
     const auto params = reinterpret_cast<const SegmentParameters*>(data);
-    tile.format = params->format;
-    tile.x = params->x;
-    tile.y = params->y;
-    tile.width = params->width;
-    tile.height = params->height;
-    tile.imageData = message.right(message.size() - sizeof(SegmentParameters));
-    tile.view = _activeView;
-    tile.rowOrder = _activeRowOrder;
-    tile.channel = _activeChannel;
+    const auto slot = reinterpret_cast<const SharedMemorySlot*>(
+        data + sizeof(SegmentParameters));
+
+    if (!_sharedMemory->isPublished(slot->index) ||
+        slot->size > _sharedMemory->getSlotSize())
+    {
+        throw protocol_error("Invalid shared memory slot");
+    }
 
+    // The tile data points directly to the shared memory, which is given back
+    // to the stream once the last copy of the tile is destroyed.
+    const auto ring = _sharedMemory;
+    const auto index = slot->index;
+    const auto slotData =
+        static_cast<const SharedMemoryRing&>(*ring).getSlotData(index);
+
+    auto tile = _tileParser.makeTile(*params);
+    tile.imageData = QByteArray::fromRawData(slotData, int(slot->size));
+    tile.imageDataOwner.reset(slotData, [ring, index](const void*) {
+        ring->releaseSlot(index);
+    });
     return tile;
 }
 
+void ServerWorker::_openSharedMemory(const QByteArray& key)
+{
+    if (_sharedMemory)
+        throw protocol_error("Shared memory was already opened");
+
+    try
+    {
+        _sharedMemory.reset(new SharedMemoryRing(key.toStdString()));
+    }
+    catch (const std::runtime_error&)
+    {
+        // e.g. the client is not on the same machine, keep using the socket
+    }
+}
+
 void ServerWorker::_tryRegisteringForEvents(const bool exclusive)
 {
-    if (_registeredToEvents)
+    if (_registeredToEvents || _bindPromise)
         throw protocol_error("The stream has already registered for events");
 
-    auto promise = std::make_shared<std::promise<bool>>();
-    auto future = promise->get_future();
+    _bindPromise = std::make_shared<std::promise<bool>>();
+    const auto future = _bindPromise->get_future().share();
 
-    emit registerToEvents(_streamId, exclusive, this, std::move(promise));
+    emit registerToEvents(_streamId, exclusive, this, _bindPromise);
 
-    try
-    {
-        _registeredToEvents = future.get();
-    }
-    catch (...)
+    _bindWatcher->setFuture(QtConcurrent::run(&_bindWaitPool, [future] {
+        try
+        {
+            return future.get();
+        }
+        catch (...)
+        {
+            return false;
+        }
+    }));
+}
+
+void ServerWorker::_finishRegisteringForEvents()
+{
+    _bindPromise.reset();
+    _registeredToEvents = _bindWatcher->result();
+    _sendBindReply(_registeredToEvents);
+}
+
+bool ServerWorker::_coalesce(const Event& evt)
+{
+    // Only events which are still pending are merged, so that slow clients
+    // receive the latest state instead of a growing backlog of positions.
+    // The deltas of merged events are accumulated so that none are lost.
+    switch (evt.type)
     {
+    case Event::EVT_MOVE:
+    case Event::EVT_PAN:
+    case Event::EVT_PINCH:
+        if (!_events.empty() && _events.back().type == evt.type &&
+            _events.back().key == evt.key)
+        {
+            auto& last = _events.back();
+            const auto dx = last.dx + evt.dx;
+            const auto dy = last.dy + evt.dy;
+            last = evt;
+            last.dx = dx;
+            last.dy = dy;
+            return true;
+        }
+        return false;
+    case Event::EVT_TOUCH_UPDATE:
+        // Updates of multiple touch points are interleaved
+        for (auto it = _events.rbegin();
+             it != _events.rend() && it->type == Event::EVT_TOUCH_UPDATE; ++it)
+        {
+            if (it->key == evt.key)
+            {
+                *it = evt;
+                return true;
+            }
+        }
+        return false;
+    default:
+        return false;
     }
 }
 
@@ -394,8 +538,16 @@ void ServerWorker::_sendProtocolVersion()
 
 void ServerWorker::_sendPendingEvents()
 {
-    for (const auto& evt : _events)
-        _send(evt);
+    if (_events.empty())
+        return;
+
+    if (_clientProtocolVersion >= EVENT_BATCH_PROTOCOL_VERSION)
+        _sendBatch(_events);
+    else
+    {
+        for (const auto& evt : _events)
+            _send(evt);
+    }
     _events.clear();
     _flushSocket();
 }
@@ -409,24 +561,55 @@ void ServerWorker::_sendBindReply(const bool successful)
     _flushSocket();
 }
 
+void ServerWorker::_sendSharedMemoryReply(const bool successful)
+{
+    MessageHeader mh(MESSAGE_TYPE_SHARED_MEMORY_REPLY, sizeof(bool));
+    _send(mh);
+
+    _tcpSocket->write((const char*)&successful, sizeof(bool));
+    _flushSocket();
+}
+
+void ServerWorker::_sendMulticastReply()
+{
+    const auto group = _multicastGroup.toUtf8();
+    MessageHeader mh(MESSAGE_TYPE_MULTICAST_REPLY, group.size());
+    _send(mh);
+
+    _tcpSocket->write(group);
+    _flushSocket();
+}
+
 void ServerWorker::_send(const Event& evt)
 {
     // send message header
     MessageHeader mh(MESSAGE_TYPE_EVENT, Event::serializedSize);
     _send(mh);
 
+    QDataStream stream(_tcpSocket);
+    stream << evt;
+}
+
+void ServerWorker::_sendBatch(const std::vector<Event>& events)
+{
+    const auto data = serializeEvents(events);
+
+    // header and events in a single write
+    QByteArray message;
     {
-        QDataStream stream(_tcpSocket);
-        stream << evt;
+        QDataStream stream(&message, QIODevice::WriteOnly);
+        stream << MessageHeader(MESSAGE_TYPE_EVENTS, data.size());
     }
-    _flushSocket();
+    message.append(data);
+    _tcpSocket->write(message);
 }
 
 void ServerWorker::_sendCloseEvent()
 {
     Event closeEvent;
     closeEvent.type = Event::EVT_CLOSE;
-    _send(closeEvent);
+    _events.push_back(closeEvent);
+    _sendPendingEvents();
 }
 
 void ServerWorker::_sendQuit()
@@ -436,6 +619,36 @@ void ServerWorker::_sendQuit()
     _flushSocket();
 }
 
+void ServerWorker::_sendVisibility(const QByteArray& visibility)
+{
+    // header and payload in a single write
+    QByteArray message;
+    {
+        QDataStream stream(&message, QIODevice::WriteOnly);
+        stream << MessageHeader(MESSAGE_TYPE_VISIBILITY, visibility.size());
+    }
+    message.append(visibility);
+    _tcpSocket->write(message);
+    _flushSocket();
+}
+
+void ServerWorker::_sendFullFrameRequest()
+{
+    MessageHeader mh(MESSAGE_TYPE_REQUEST_FULL_FRAME, 0);
+    _send(mh);
+    _flushSocket();
+}
+
+void ServerWorker::_sendTileFormats()
+{
+    const char formats[] = {char(Format::solid), char(Format::copy)};
+    MessageHeader mh(MESSAGE_TYPE_TILE_FORMATS, sizeof(formats));
+    _send(mh);
+
+    _tcpSocket->write(formats, sizeof(formats));
+    _flushSocket();
+}
+
 bool ServerWorker::_send(const MessageHeader& messageHeader)
 {
     QDataStream stream(_tcpSocket);
@@ -446,9 +659,9 @@ bool ServerWorker::_send(const MessageHeader& messageHeader)
 
 void ServerWorker::_flushSocket()
 {
+    // The data which can not be written without blocking is written by the
+    // event loop of the thread, which is shared with other connections
     _tcpSocket->flush();
-    while (_tcpSocket->bytesToWrite() > 0 && _isConnected())
-        _tcpSocket->waitForBytesWritten();
 }
 
 bool ServerWorker::_isConnected() const
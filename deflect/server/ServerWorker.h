@@ -46,11 +46,18 @@
 #include <deflect/SizeHints.h>
 #include <deflect/server/EventReceiver.h>
 #include <deflect/server/Tile.h>
+#include <deflect/server/TileParser.h>
 
+#include <QFutureWatcher>
+#include <QThreadPool>
 #include <QtNetwork/QTcpSocket>
 
+#include <memory>
+
 namespace deflect
 {
+class SharedMemoryRing;
+
 namespace server
 {
 class ServerWorker : public EventReceiver
@@ -61,12 +68,20 @@ public:
     explicit ServerWorker(int socketDescriptor);
     ~ServerWorker();
 
+    /** Set the address:port of the multicast group offered to the stream. */
+    void setMulticastGroup(const QString& group);
+
+    /** Let the stream send tiles in Format::solid and Format::copy. */
+    void setSolidAndCopyTilesEnabled(bool enabled);
+
 public slots:
     void processEvent(Event evt) final;
 
     void initConnection();
     void closeConnections(QString uri);
     void closeConnection(QString uri, size_t sourceIndex);
+    void sendVisibility(QString uri, QByteArray visibility);
+    void requestFullFrame(QString uri, size_t sourceIndex);
 
 signals:
     void addStreamSource(QString uri, size_t sourceIndex);
@@ -78,6 +93,7 @@ signals:
     void receivedTile(QString uri, size_t sourceIndex,
                       deflect::server::Tile tile);
     void receivedFrameFinished(QString uri, size_t sourceIndex);
+    void receivedPartialFrameFinished(QString uri, size_t sourceIndex);
     void registerToEvents(QString uri, bool exclusive,
                           deflect::server::EventReceiver* receiver,
                           deflect::server::BoolPromisePtr success);
@@ -94,6 +110,7 @@ signals:
 
 private slots:
     void _processMessages();
+    void _finishRegisteringForEvents();
 
 private:
     QTcpSocket* _tcpSocket = nullptr; // child QObject
@@ -104,21 +121,28 @@ private:
     bool _observer = false;
 
     bool _registeredToEvents = false;
+    BoolPromisePtr _bindPromise; // while waiting for registerToEvents()
+    QThreadPool _bindWaitPool;
+    QFutureWatcher<bool>* _bindWatcher = nullptr; // child QObject
     std::vector<Event> _events;
 
-    View _activeView = View::mono;
-    RowOrder _activeRowOrder = RowOrder::top_down;
-    uint8_t _activeChannel = 0;
+    TileParser _tileParser;
 
     bool _protocolEnded = false;
 
+    MessageHeader _pendingHeader;
+    bool _hasPendingHeader = false;
+
+    std::shared_ptr<SharedMemoryRing> _sharedMemory;
+    QString _multicastGroup;
+    bool _solidAndCopyTilesEnabled = false;
+
     void _terminateConnection();
 
     void _receiveMessage();
     MessageHeader _receiveMessageHeader();
-    QByteArray _receiveMessageBody(int size);
 
-    bool _socketHasMessage() const;
+    bool _socketHasMessage();
     void _handleMessage(const MessageHeader& messageHeader,
                         const QByteArray& message);
     void _validate(MessageType messageType) const;
@@ -129,16 +153,25 @@ private:
     bool _isProtocolStarted() const;
 
     void _parseClientProtocolVersion(const QByteArray& message);
-    Tile _parseTile(const QByteArray& message) const;
+    Tile _parseSharedMemoryTile(const QByteArray& message) const;
+
+    void _openSharedMemory(const QByteArray& key);
 
     void _tryRegisteringForEvents(bool exclusive);
+    bool _coalesce(const Event& evt);
 
     void _sendProtocolVersion();
     void _sendPendingEvents();
     void _sendBindReply(bool successful);
+    void _sendSharedMemoryReply(bool successful);
+    void _sendMulticastReply();
     void _send(const Event& evt);
+    void _sendBatch(const std::vector<Event>& events);
     void _sendCloseEvent();
     void _sendQuit();
+    void _sendVisibility(const QByteArray& visibility);
+    void _sendFullFrameRequest();
+    void _sendTileFormats();
     bool _send(const MessageHeader& messageHeader);
     void _flushSocket();
     bool _isConnected() const;
@@ -39,20 +39,101 @@
 
 #include "SourceBuffer.h"
 
+#include <algorithm>
 #include <exception>
 
+namespace
+{
+bool _covers(const deflect::server::Tile& tile,
+             const deflect::server::Tile& other)
+{
+    return tile.view == other.view && tile.channel == other.channel &&
+           tile.x <= other.x && tile.y <= other.y &&
+           tile.x + tile.width >= other.x + other.width &&
+           tile.y + tile.height >= other.y + other.height;
+}
+
+bool _intersects(const deflect::server::Tile& tile,
+                 const deflect::server::Tile& other)
+{
+    return tile.view == other.view && tile.channel == other.channel &&
+           tile.x < other.x + other.width && other.x < tile.x + tile.width &&
+           tile.y < other.y + other.height && other.y < tile.y + tile.height;
+}
+
+/** @return true if the tile is entirely inside the source of the copy. */
+bool _isCopied(const deflect::server::Tile& tile,
+               const deflect::server::Tile& copy)
+{
+    return tile.view == copy.view && tile.channel == copy.channel &&
+           copy.sourceX <= tile.x && copy.sourceY <= tile.y &&
+           copy.sourceX + copy.width >= tile.x + tile.width &&
+           copy.sourceY + copy.height >= tile.y + tile.height;
+}
+
+bool _isCopy(const deflect::server::Tile& tile)
+{
+    return tile.format == deflect::Format::copy;
+}
+
+bool _hasCopies(const deflect::server::Tiles& tiles)
+{
+    return std::any_of(tiles.begin(), tiles.end(), _isCopy);
+}
+
+/** @return the tiles after applying a copy to them. */
+deflect::server::Tiles _applyCopy(const deflect::server::Tiles& tiles,
+                                  const deflect::server::Tile& copy)
+{
+    deflect::server::Tiles result;
+    for (const auto& tile : tiles)
+    {
+        if (!_intersects(copy, tile))
+            result.push_back(tile);
+    }
+    // Only whole tiles can be moved, the others are lost in the destination
+    for (const auto& tile : tiles)
+    {
+        if (_isCopied(tile, copy))
+        {
+            auto moved = tile;
+            moved.x = tile.x - copy.sourceX + copy.x;
+            moved.y = tile.y - copy.sourceY + copy.y;
+            result.push_back(moved);
+        }
+    }
+    return result;
+}
+
+/** @return the tiles which are not fully covered by any of the new ones. */
+deflect::server::Tiles _getUncovered(const deflect::server::Tiles& tiles,
+                                     const deflect::server::Tiles& newTiles)
+{
+    deflect::server::Tiles result;
+    for (const auto& tile : tiles)
+    {
+        const auto covered = [&tile](const deflect::server::Tile& newTile) {
+            return _covers(newTile, tile);
+        };
+        if (std::none_of(newTiles.begin(), newTiles.end(), covered))
+            result.push_back(tile);
+    }
+    return result;
+}
+}
+
 namespace deflect
 {
 namespace server
 {
 SourceBuffer::SourceBuffer()
 {
-    _tiles.push(Tiles());
+    _frames.push(PendingFrame());
 }
 
 const Tiles& SourceBuffer::getTiles() const
 {
-    return _tiles.front();
+    return _frames.front().tiles;
 }
 
 FrameIndex SourceBuffer::getBackFrameIndex() const
@@ -62,28 +143,119 @@ FrameIndex SourceBuffer::getBackFrameIndex() const
 
 bool SourceBuffer::isBackFrameEmpty() const
 {
-    return _tiles.back().empty();
+    return _frames.back().tiles.empty();
+}
+
+bool SourceBuffer::hasCopies() const
+{
+    return _hasCopies(_frames.front().tiles);
+}
+
+bool SourceBuffer::isIncomplete() const
+{
+    return _frames.front().incomplete;
+}
+
+bool SourceBuffer::needsFullFrame() const
+{
+    return _needsFullFrame;
 }
 
 void SourceBuffer::pop()
 {
-    _tiles.pop();
+    _frames.pop();
 }
 
 void SourceBuffer::push()
 {
-    _tiles.push(Tiles());
-    ++_backFrameIndex;
+    auto& frame = _frames.back();
+    if (_hasCopies(frame.tiles))
+        _pushCopies();
+    else
+    {
+        _lastPushedTiles = frame.tiles;
+        _lastPushedIncomplete = false;
+        if (!_usesPartialFrames)
+        {
+            // Keeping the shared memory tiles would hold their slots until the
+            // next frame, only do it for sources which send partial frames.
+            const auto end =
+                std::remove_if(_lastPushedTiles.begin(), _lastPushedTiles.end(),
+                               [](const Tile& tile) {
+                                   return bool(tile.imageDataOwner);
+                               });
+            _lastPushedIncomplete = end != _lastPushedTiles.end();
+            _lastPushedTiles.erase(end, _lastPushedTiles.end());
+        }
+        _needsFullFrame = false;
+        _pushBack();
+    }
+}
+
+void SourceBuffer::pushPartial()
+{
+    auto& frame = _frames.back();
+    if (_hasCopies(frame.tiles))
+    {
+        _pushCopies();
+        return;
+    }
+
+    _trackPartialFrames();
+    const auto tiles = _getUncovered(_lastPushedTiles, frame.tiles);
+    frame.tiles.insert(frame.tiles.begin(), tiles.begin(), tiles.end());
+    frame.incomplete = _lastPushedIncomplete;
+    _lastPushedTiles = frame.tiles;
+    _pushBack();
 }
 
 void SourceBuffer::insert(const Tile& tile)
 {
-    _tiles.back().push_back(tile);
+    _frames.back().tiles.push_back(tile);
 }
 
 size_t SourceBuffer::getQueueSize() const
 {
-    return _tiles.size();
+    return _frames.size();
+}
+
+void SourceBuffer::_trackPartialFrames()
+{
+    if (_usesPartialFrames)
+        return;
+
+    _usesPartialFrames = true;
+    _needsFullFrame = _lastPushedIncomplete;
+}
+
+void SourceBuffer::_pushCopies()
+{
+    _trackPartialFrames();
+
+    // The frame is pushed as is, the copies apply to the previous frame
+    auto& frame = _frames.back();
+    frame.incomplete = true;
+
+    auto tiles = _lastPushedTiles;
+    Tiles newTiles;
+    for (const auto& tile : frame.tiles)
+    {
+        if (_isCopy(tile))
+            tiles = _applyCopy(tiles, tile);
+        else
+            newTiles.push_back(tile);
+    }
+    _lastPushedTiles = _getUncovered(tiles, newTiles);
+    _lastPushedTiles.insert(_lastPushedTiles.end(), newTiles.begin(),
+                            newTiles.end());
+    _lastPushedIncomplete = true;
+    _pushBack();
+}
+
+void SourceBuffer::_pushBack()
+{
+    _frames.push(PendingFrame());
+    ++_backFrameIndex;
 }
 }
 }
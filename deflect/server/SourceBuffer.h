@@ -69,12 +69,45 @@ public:
     /** @return true if the back frame has no tiles. */
     bool isBackFrameEmpty() const;
 
+    /** @return true if the front frame copies regions of its previous frame. */
+    bool hasCopies() const;
+
+    /**
+     * @return true if the front frame only updates its previous frame, because
+     *         it has copies or because some of the regions moved by earlier
+     *         copies are missing from its tiles.
+     */
+    bool isIncomplete() const;
+
     /** Insert a tile into the back frame. */
     void insert(const Tile& tile);
 
+    /**
+     * @return true if the source sent frames which only update its previous
+     *         frame while that frame was not kept, in which case they remain
+     *         incomplete until the source pushes a full frame again.
+     */
+    bool needsFullFrame() const;
+
     /** Push a new frame to the back. */
     void push();
 
+    /**
+     * Push a new frame to the back, after completing the back frame with the
+     * tiles of the previously pushed frame which are not covered by its own.
+     *
+     * The shared memory tiles of the previous frames are only kept once the
+     * source sends partial frames or copies, so the first of those frames may
+     * be incomplete (see needsFullFrame()).
+     *
+     * Frames which copy regions of their previous frame are pushed as is, as
+     * the previous tiles would overwrite the copied regions. The tiles which
+     * are entirely inside a copied region are moved with it to complete the
+     * next frames; the other regions overwritten by the copies are missing
+     * from the next frames until a full frame is pushed.
+     */
+    void pushPartial();
+
     /** Pop the front frame. */
     void pop();
 
@@ -82,11 +115,37 @@ public:
     size_t getQueueSize() const;
 
 private:
+    struct PendingFrame
+    {
+        Tiles tiles;
+        bool incomplete = false;
+    };
+
     /** The collections of tiles for each mono/left/right view. */
-    std::queue<Tiles> _tiles;
+    std::queue<PendingFrame> _frames;
+
+    /**
+     * The tiles of the last pushed frame with its copies applied, to complete
+     * partial frames.
+     */
+    Tiles _lastPushedTiles;
+
+    /**
+     * Some regions moved by copies, or shared memory tiles of a full frame,
+     * are missing from _lastPushedTiles.
+     */
+    bool _lastPushedIncomplete = false;
+
+    /** The source sends partial frames, so shared memory tiles are kept. */
+    bool _usesPartialFrames = false;
+    bool _needsFullFrame = false;
 
     /** The current indices of the mono/left/right frame for this source. */
     FrameIndex _backFrameIndex = 0u;
+
+    void _trackPartialFrames();
+    void _pushCopies();
+    void _pushBack();
 };
 }
 }
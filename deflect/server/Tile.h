@@ -68,10 +68,40 @@ struct Tile
     /** Image data. */
     QByteArray imageData;
 
+    /**
+     * Owner of the memory referenced by imageData, if it is not owned by
+     * imageData itself (e.g. data received through shared memory).
+     *
+     * The imageData is only guaranteed to remain valid as long as a copy of
+     * the Tile exists. Make a deep copy of it to keep it longer.
+     */
+    std::shared_ptr<const void> imageDataOwner;
+
     /** @name Image data parameters */
     //@{
     Format format = Format::jpeg; //!< Format in which the data is stored
     RowOrder rowOrder = RowOrder::top_down; //!< Row order of imageData
+
+    /**
+     * Level of detail of the decoded imageData, whose dimensions are the ones
+     * of the tile divided by 2^lod (rounded up).
+     */
+    uint8_t lod = 0;
+    //@}
+
+    /** @name Source position of a Format::copy tile in the previous frame */
+    //@{
+    uint32_t sourceX = 0u;
+    uint32_t sourceY = 0u;
+    //@}
+
+    /**
+     * @name JPEG header of imageData, cached by the TileDecoder
+     * Must be reset if the JPEG imageData is replaced.
+     */
+    //@{
+    bool jpegHeaderParsed = false; //!< The header below is valid
+    ChromaSubsampling jpegSubsampling = ChromaSubsampling::YUV444; //!< JPEG
     //@}
 
     /** @name Metadata */
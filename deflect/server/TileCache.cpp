@@ -0,0 +1,223 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "TileCache.h"
+
+#include "Tile.h"
+
+#include <QHash>
+
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace deflect
+{
+namespace server
+{
+namespace
+{
+struct Key
+{
+    uint hash;
+    uint32_t x;
+    uint32_t y;
+    uint32_t width;
+    uint32_t height;
+    uint8_t lod;
+    bool yuv;
+
+    bool operator==(const Key& other) const
+    {
+        return hash == other.hash && x == other.x && y == other.y &&
+               width == other.width && height == other.height &&
+               lod == other.lod && yuv == other.yuv;
+    }
+};
+
+struct KeyHash
+{
+    size_t operator()(const Key& key) const
+    {
+        size_t seed = key.hash;
+        for (const auto value : {key.x, key.y, key.width, key.height,
+                                 uint32_t(key.lod), uint32_t(key.yuv)})
+        {
+            seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+        return seed;
+    }
+};
+
+Key _makeKey(const QByteArray& jpegData, const Tile& tile, const bool yuv,
+             const uint8_t lod)
+{
+    return {qHashBits(jpegData.constData(), size_t(jpegData.size())),
+            tile.x,
+            tile.y,
+            tile.width,
+            tile.height,
+            lod,
+            yuv};
+}
+
+struct Entry
+{
+    Key key;
+    QByteArray jpegData; // to rule out hash collisions
+    QByteArray decodedData;
+    Format format;
+
+    size_t getSize() const
+    {
+        return size_t(jpegData.size() + decodedData.size());
+    }
+};
+}
+
+class TileCache::Impl
+{
+public:
+    explicit Impl(const size_t maxSize_)
+        : maxSize{maxSize_}
+    {
+    }
+
+    const size_t maxSize;
+    size_t size = 0;
+
+    // most recently used first
+    std::list<Entry> entries;
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index;
+    mutable std::mutex mutex;
+
+    void remove(const std::list<Entry>::iterator it)
+    {
+        size -= it->getSize();
+        index.erase(it->key);
+        entries.erase(it);
+    }
+};
+
+TileCache::TileCache(const size_t maxSize)
+    : _impl{new Impl(maxSize)}
+{
+}
+
+TileCache::~TileCache()
+{
+}
+
+size_t TileCache::getSize() const
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    return _impl->size;
+}
+
+size_t TileCache::getMaxSize() const
+{
+    return _impl->maxSize;
+}
+
+size_t TileCache::getCount() const
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    return _impl->entries.size();
+}
+
+void TileCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    _impl->entries.clear();
+    _impl->index.clear();
+    _impl->size = 0;
+}
+
+bool TileCache::retrieve(Tile& tile, const bool yuv, const uint8_t lod)
+{
+    if (tile.format != Format::jpeg)
+        return false;
+
+    const auto key = _makeKey(tile.imageData, tile, yuv, lod);
+
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+    const auto it = _impl->index.find(key);
+    if (it == _impl->index.end() || it->second->jpegData != tile.imageData)
+        return false;
+
+    // move to front as the most recently used
+    _impl->entries.splice(_impl->entries.begin(), _impl->entries, it->second);
+
+    const auto& entry = *it->second;
+    tile.imageData = entry.decodedData; // implicitly shared, not copied
+    tile.imageDataOwner.reset();
+    tile.format = entry.format;
+    tile.lod = lod;
+    return true;
+}
+
+void TileCache::insert(const QByteArray& jpegData, const Tile& tile,
+                       const bool yuv)
+{
+    Entry entry;
+    entry.key = _makeKey(jpegData, tile, yuv, tile.lod);
+    entry.jpegData = jpegData; // implicitly shared, not copied
+    entry.decodedData = tile.imageData;
+    entry.format = tile.format;
+
+    const auto entrySize = entry.getSize();
+    if (entrySize > _impl->maxSize)
+        return;
+
+    std::lock_guard<std::mutex> lock(_impl->mutex);
+
+    const auto it = _impl->index.find(entry.key);
+    if (it != _impl->index.end())
+        _impl->remove(it->second);
+
+    while (_impl->size + entrySize > _impl->maxSize)
+        _impl->remove(std::prev(_impl->entries.end()));
+
+    _impl->entries.push_front(std::move(entry));
+    _impl->index[_impl->entries.front().key] = _impl->entries.begin();
+    _impl->size += entrySize;
+}
+}
+}
@@ -0,0 +1,120 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#ifndef DEFLECT_SERVER_TILECACHE_H
+#define DEFLECT_SERVER_TILECACHE_H
+
+#include <deflect/api.h>
+#include <deflect/server/types.h>
+
+#include <QByteArray>
+
+#include <memory>
+
+namespace deflect
+{
+namespace server
+{
+/**
+ * Cache of decoded tiles, shared by TileDecoders.
+ *
+ * The tiles are identified by a hash of their compressed data and their
+ * geometry. Tiles which are resent with identical JPEG data, such as the
+ * static regions of desktop streams, are then only decoded once. The least
+ * recently used tiles are evicted when the cache is full.
+ *
+ * @threadsafe
+ */
+class TileCache
+{
+public:
+    /**
+     * Create a cache.
+     *
+     * @param maxSize the maximum number of bytes of the compressed and decoded
+     *        data of the cached tiles.
+     */
+    DEFLECT_API explicit TileCache(size_t maxSize);
+
+    /** Destruct the cache. */
+    DEFLECT_API ~TileCache();
+
+    /** @return the number of bytes of the cached tiles. */
+    DEFLECT_API size_t getSize() const;
+
+    /** @return the maximum number of bytes of the cached tiles. */
+    DEFLECT_API size_t getMaxSize() const;
+
+    /** @return the number of cached tiles. */
+    DEFLECT_API size_t getCount() const;
+
+    /** Remove all the tiles from the cache. */
+    DEFLECT_API void clear();
+
+    /**
+     * Replace the JPEG data of a tile with its cached decoded data.
+     *
+     * @param tile the JPEG tile to look for.
+     * @param yuv true to look for the YUV decoded data, false for RGBA.
+     * @param lod the level of detail of the decoded data.
+     * @return true if the tile was found and its data replaced.
+     */
+    DEFLECT_API bool retrieve(Tile& tile, bool yuv, uint8_t lod);
+
+    /**
+     * Add a decoded tile to the cache.
+     *
+     * @param jpegData the JPEG data from which the tile was decoded.
+     * @param tile the decoded tile, whose imageData must own its memory.
+     * @param yuv true if the tile was decoded to YUV, false for RGBA.
+     */
+    DEFLECT_API void insert(const QByteArray& jpegData, const Tile& tile,
+                            bool yuv);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> _impl;
+
+    TileCache(const TileCache&) = delete;
+    TileCache& operator=(const TileCache&) = delete;
+};
+}
+}
+
+#endif
@@ -41,11 +41,16 @@
 
 #include "ImageJpegDecompressor.h"
 #include "Tile.h"
+#include "TileCache.h"
 
 #include <QFuture>
 #include <QtConcurrentRun>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 
 namespace deflect
 {
@@ -58,6 +63,9 @@ public:
     /** The decompressor instance */
     ImageJpegDecompressor decompressor;
 
+    /** The optional cache of decoded tiles */
+    std::shared_ptr<TileCache> cache;
+
     /** Async image decoding future */
     QFuture<void> decodingFuture;
 };
@@ -71,17 +79,16 @@ TileDecoder::~TileDecoder()
 {
 }
 
-ChromaSubsampling TileDecoder::decodeType(const Tile& tile)
+namespace
 {
-    if (tile.format != Format::jpeg)
-        throw std::runtime_error("Tile is not in JPEG format");
-
-    return _impl->decompressor.decompressHeader(tile.imageData).subsampling;
-}
-
-size_t _getExpectedSize(const Format format, const Tile& tile)
+size_t _getExpectedSize(const Format format, const Tile& tile,
+                        const uint8_t lod)
 {
-    const size_t imageSize = tile.height * tile.width;
+    const size_t width = getLodSize(tile.width, lod);
+    const size_t height = getLodSize(tile.height, lod);
+    const size_t imageSize = width * height;
+    // chroma planes are rounded up for odd dimensions, like libjpeg-turbo
+    const size_t halfWidth = (width + 1) / 2;
     switch (format)
     {
     case Format::rgba:
@@ -89,76 +96,225 @@ size_t _getExpectedSize(const Format format, const Tile& tile)
     case Format::yuv444:
         return imageSize * 3;
     case Format::yuv422:
-        return imageSize * 2;
+        return imageSize + 2 * halfWidth * height;
     case Format::yuv420:
-        return imageSize + (imageSize >> 1);
+        return imageSize + 2 * halfWidth * ((height + 1) / 2);
     default:
         return 0;
     };
 }
 
-void _decodeTile(ImageJpegDecompressor* decompressor, Tile* tile,
-                 const bool skipRgbConversion)
+Format _getYUVFormat(const ChromaSubsampling subsampling)
 {
-    if (tile->format != Format::jpeg)
-        return;
+    switch (subsampling)
+    {
+    case ChromaSubsampling::YUV444:
+        return Format::yuv444;
+    case ChromaSubsampling::YUV422:
+        return Format::yuv422;
+    case ChromaSubsampling::YUV420:
+        return Format::yuv420;
+    default:
+        throw std::runtime_error("unexpected ChromaSubsampling mode");
+    };
+}
 
-    QByteArray decodedData;
-    Format format;
-    try
+bool _isEncoded(const Tile& tile)
+{
+    return tile.format == Format::jpeg || tile.format == Format::solid;
+}
+
+void _checkIsEncoded(const Tile& tile)
+{
+    if (!_isEncoded(tile))
+        throw std::runtime_error("Tile is not in JPEG or solid format");
+}
+
+ChromaSubsampling _getSolidSubsampling(const Tile& tile)
+{
+    if (tile.imageData.size() < 4 ||
+        uint8_t(tile.imageData[3]) > uint8_t(ChromaSubsampling::YUV420))
     {
-#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
-        if (skipRgbConversion)
-        {
-            const auto yuv = decompressor->decompressToYUV(tile->imageData);
-            decodedData = yuv.first;
-            switch (yuv.second)
-            {
-            case ChromaSubsampling::YUV444:
-                format = Format::yuv444;
-                break;
-            case ChromaSubsampling::YUV422:
-                format = Format::yuv422;
-                break;
-            case ChromaSubsampling::YUV420:
-                format = Format::yuv420;
-                break;
-            default:
-                throw std::runtime_error("unexpected ChromaSubsampling mode");
-            };
-        }
-        else
-#else
-        Q_UNUSED(skipRgbConversion);
-#endif
+        throw std::runtime_error("invalid solid tile");
+    }
+    return ChromaSubsampling(tile.imageData[3]);
+}
+
+char _toByte(const double value)
+{
+    return char(uint8_t(std::min(255.0, std::max(0.0, std::round(value)))));
+}
+
+Format _fillSolid(const Tile& tile, const bool yuv, char* buffer,
+                  const size_t pitch, const uint8_t lod)
+{
+    const auto subsampling = _getSolidSubsampling(tile);
+    const auto data = reinterpret_cast<const uint8_t*>(tile.imageData.data());
+    const double r = data[0], g = data[1], b = data[2];
+    const size_t width = getLodSize(tile.width, lod);
+    const size_t height = getLodSize(tile.height, lod);
+
+    if (!yuv)
+    {
+        const char pixel[4] = {char(data[0]), char(data[1]), char(data[2]),
+                               char(255)};
+        for (size_t x = 0; x < width; ++x)
+            std::memcpy(buffer + x * 4, pixel, 4);
+        for (size_t y = 1; y < height; ++y)
+            std::memcpy(buffer + y * pitch, buffer, width * 4);
+        return Format::rgba;
+    }
+
+    // JFIF full-range YCbCr, as used by libjpeg-turbo
+    const auto format = _getYUVFormat(subsampling);
+    const auto lumaSize = width * height;
+    const auto chromaSize =
+        (_getExpectedSize(format, tile, lod) - lumaSize) / 2;
+    const auto y = _toByte(0.299 * r + 0.587 * g + 0.114 * b);
+    const auto u = _toByte(-0.168736 * r - 0.331264 * g + 0.5 * b + 128.0);
+    const auto v = _toByte(0.5 * r - 0.418688 * g - 0.081312 * b + 128.0);
+    std::memset(buffer, y, lumaSize);
+    std::memset(buffer + lumaSize, u, chromaSize);
+    std::memset(buffer + lumaSize + chromaSize, v, chromaSize);
+    return format;
+}
+
+JpegHeader _getHeader(ImageJpegDecompressor& decompressor, Tile& tile)
+{
+    if (!tile.jpegHeaderParsed)
+    {
+        const auto header = decompressor.decompressHeader(tile.imageData);
+        if (header.width != int(tile.width) ||
+            header.height != int(tile.height))
         {
-            decodedData = decompressor->decompress(tile->imageData);
-            format = Format::rgba;
+            throw std::runtime_error("unexpected tile size");
         }
+        tile.jpegSubsampling = header.subsampling;
+        tile.jpegHeaderParsed = true;
     }
-    catch (const std::runtime_error&)
+
+    JpegHeader header;
+    header.width = int(tile.width);
+    header.height = int(tile.height);
+    header.subsampling = tile.jpegSubsampling;
+    return header;
+}
+
+ChromaSubsampling _getSubsampling(ImageJpegDecompressor& decompressor,
+                                  Tile& tile)
+{
+    if (tile.format == Format::solid)
+        return _getSolidSubsampling(tile);
+    return _getHeader(decompressor, tile).subsampling;
+}
+
+Format _decodeInto(ImageJpegDecompressor& decompressor, Tile& tile,
+                   const bool skipRgbConversion, char* buffer,
+                   const size_t pitch, const uint8_t lod)
+{
+    if (tile.format == Format::solid)
+        return _fillSolid(tile, skipRgbConversion, buffer, pitch, lod);
+
+    const auto header = _getHeader(decompressor, tile);
+#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
+    if (skipRgbConversion)
     {
-        throw;
+        decompressor.decompressToYUV(tile.imageData, header, buffer, lod);
+        return _getYUVFormat(header.subsampling);
     }
+#else
+    Q_UNUSED(skipRgbConversion);
+#endif
+    decompressor.decompress(tile.imageData, header, buffer, int(pitch), lod);
+    return Format::rgba;
+}
 
-    const auto expectedSize = _getExpectedSize(format, *tile);
-    if (size_t(decodedData.size()) != expectedSize)
-        throw std::runtime_error("unexpected tile size");
+void _decodeTile(ImageJpegDecompressor* decompressor, TileCache* cache,
+                 Tile* tile, const bool skipRgbConversion, const uint8_t lod)
+{
+    if (!_isEncoded(*tile))
+        return;
+
+    // solid tiles are cheaper to decode than to look up
+    if (tile->format != Format::jpeg)
+        cache = nullptr;
+
+    if (cache && cache->retrieve(*tile, skipRgbConversion, lod))
+        return;
+    const auto jpegData = tile->imageData;
+
+    const auto format =
+        skipRgbConversion
+            ? _getYUVFormat(_getSubsampling(*decompressor, *tile))
+            : Format::rgba;
+    const size_t pitch = getLodSize(tile->width, lod) * 4;
+
+    QByteArray decodedData(_getExpectedSize(format, *tile, lod),
+                           Qt::Uninitialized);
+    _decodeInto(*decompressor, *tile, skipRgbConversion, decodedData.data(),
+                pitch, lod);
 
     tile->imageData = decodedData;
     tile->format = format;
+    tile->lod = lod;
+
+    if (cache)
+        cache->insert(jpegData, *tile, skipRgbConversion);
+}
 }
 
-void TileDecoder::decode(Tile& tile)
+ChromaSubsampling TileDecoder::decodeType(const Tile& tile)
 {
-    _decodeTile(&_impl->decompressor, &tile, false);
+    _checkIsEncoded(tile);
+
+    if (tile.format == Format::solid)
+        return _getSolidSubsampling(tile);
+    if (tile.jpegHeaderParsed)
+        return tile.jpegSubsampling;
+    return _impl->decompressor.decompressHeader(tile.imageData).subsampling;
+}
+
+ChromaSubsampling TileDecoder::decodeType(Tile& tile)
+{
+    _checkIsEncoded(tile);
+    return _getSubsampling(_impl->decompressor, tile);
+}
+
+size_t TileDecoder::getDecodedSize(const Tile& tile, const Format format,
+                                   const uint8_t lod)
+{
+    return _getExpectedSize(format, tile, lod);
+}
+
+void TileDecoder::setCache(std::shared_ptr<TileCache> cache)
+{
+    _impl->cache = std::move(cache);
+}
+
+void TileDecoder::decode(Tile& tile, const uint8_t lod)
+{
+    _decodeTile(&_impl->decompressor, _impl->cache.get(), &tile, false, lod);
+}
+
+void TileDecoder::decodeInto(Tile& tile, char* buffer, const size_t pitch,
+                             const uint8_t lod)
+{
+    _checkIsEncoded(tile);
+    _decodeInto(_impl->decompressor, tile, false, buffer, pitch, lod);
 }
 
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
 
-void TileDecoder::decodeToYUV(Tile& tile)
+void TileDecoder::decodeToYUV(Tile& tile, const uint8_t lod)
+{
+    _decodeTile(&_impl->decompressor, _impl->cache.get(), &tile, true, lod);
+}
+
+Format TileDecoder::decodeToYUVInto(Tile& tile, char* buffer,
+                                    const uint8_t lod)
 {
-    _decodeTile(&_impl->decompressor, &tile, true);
+    _checkIsEncoded(tile);
+    return _decodeInto(_impl->decompressor, tile, true, buffer, 0, lod);
 }
 
 #endif
@@ -170,7 +326,8 @@ void TileDecoder::startDecoding(Tile& tile)
         return;
 
     _impl->decodingFuture =
-        QtConcurrent::run(_decodeTile, &_impl->decompressor, &tile, false);
+        QtConcurrent::run(_decodeTile, &_impl->decompressor,
+                          _impl->cache.get(), &tile, false, uint8_t(0));
 }
 
 void TileDecoder::waitDecoding()
@@ -50,6 +50,9 @@ namespace server
 {
 /**
  * Decode a Tile's image asynchronously.
+ *
+ * Tiles in Format::solid are decoded like JPEG tiles, expanding their single
+ * color to the requested format.
  */
 class TileDecoder
 {
@@ -60,6 +63,17 @@ public:
     /** Destruct a Decoder */
     DEFLECT_API ~TileDecoder();
 
+    /**
+     * Use a cache of decoded tiles, which may be shared with other decoders.
+     *
+     * The decode(), decodeToYUV() and startDecoding() methods then reuse the
+     * decoded data of tiles which were already decoded from identical JPEG
+     * data. Must not be called while decoding.
+     *
+     * @param cache the cache to use, or nullptr to disable caching (default).
+     */
+    DEFLECT_API void setCache(std::shared_ptr<TileCache> cache);
+
     /**
      * Decode the data type of a JPEG tile.
      *
@@ -68,15 +82,53 @@ public:
      */
     DEFLECT_API ChromaSubsampling decodeType(const Tile& tile);
 
+    /**
+     * Decode the data type of a JPEG tile, caching its JPEG header in the tile
+     * so that decoding it does not parse the header again.
+     *
+     * @param tile The tile to decode.
+     * @throw std::runtime_error if a decompression error occured
+     */
+    DEFLECT_API ChromaSubsampling decodeType(Tile& tile);
+
+    /**
+     * @return the size of the data of a tile decoded to the given format, at
+     *         the given level of detail, without padding.
+     */
+    DEFLECT_API static size_t getDecodedSize(const Tile& tile, Format format,
+                                             uint8_t lod = 0);
+
     /**
      * Decode a JPEG tile to RGB.
      *
      * @param tile The tile to decode. Upon success, its imageData member
      *        will hold the decompressed RGB image and its "format" flag will
      *        be set to Format::rgba.
+     * @param lod The level of detail at which to decode the tile, from 0 (full
+     *        resolution) to MAX_JPEG_LOD. Upon success, the tile's "lod"
+     *        member is set to this value.
+     * @throw std::runtime_error if a decompression error occured
+     * @throw std::invalid_argument if lod > MAX_JPEG_LOD
+     */
+    DEFLECT_API void decode(Tile& tile, uint8_t lod = 0);
+
+    /**
+     * Decode a JPEG tile to RGBA into a caller-provided buffer.
+     *
+     * Avoids allocating the decoded image, e.g. to decode directly into a
+     * persistent staging buffer or a mapped texture upload buffer.
+     *
+     * @param tile The tile to decode. Its image data is left unchanged, only
+     *        its JPEG header is cached.
+     * @param buffer The destination, of at least pitch * tile height bytes
+     *        at the given level of detail.
+     * @param pitch The number of bytes per row of the destination buffer.
+     * @param lod The level of detail at which to decode the tile.
      * @throw std::runtime_error if a decompression error occured
+     * @throw std::invalid_argument if lod > MAX_JPEG_LOD
      */
-    DEFLECT_API void decode(Tile& tile);
+    DEFLECT_API void decodeInto(Tile& tile, char* buffer, size_t pitch,
+                                uint8_t lod = 0);
 
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
 
@@ -86,9 +138,28 @@ public:
      * @param tile The tile to decode. Upon success, its imageData member
      *        will hold the decompressed YUV image and its "format" flag will
      *        be set to the matching Format::yuv4**.
+     * @param lod The level of detail at which to decode the tile, from 0 (full
+     *        resolution) to MAX_JPEG_LOD. Upon success, the tile's "lod"
+     *        member is set to this value.
+     * @throw std::runtime_error if a decompression error occured
+     * @throw std::invalid_argument if lod > MAX_JPEG_LOD
+     */
+    DEFLECT_API void decodeToYUV(Tile& tile, uint8_t lod = 0);
+
+    /**
+     * Decode a JPEG tile to YUV into a caller-provided buffer.
+     *
+     * @param tile The tile to decode. Its image data is left unchanged, only
+     *        its JPEG header is cached.
+     * @param buffer The destination of the contiguous Y, U and V planes, of
+     *        at least getDecodedSize() bytes for the returned format.
+     * @param lod The level of detail at which to decode the tile.
+     * @return the Format::yuv4** of the decoded data.
      * @throw std::runtime_error if a decompression error occured
+     * @throw std::invalid_argument if lod > MAX_JPEG_LOD
      */
-    DEFLECT_API void decodeToYUV(Tile& tile);
+    DEFLECT_API Format decodeToYUVInto(Tile& tile, char* buffer,
+                                       uint8_t lod = 0);
 
 #endif
 
@@ -0,0 +1,125 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "TileParser.h"
+
+#include "deflect/SegmentParameters.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace deflect
+{
+namespace server
+{
+bool TileParser::parseImageState(const MessageType type,
+                                 const QByteArray& message)
+{
+    switch (type)
+    {
+    case MESSAGE_TYPE_IMAGE_VIEW:
+    {
+        if (size_t(message.size()) < sizeof(View))
+            return true;
+        const auto view = reinterpret_cast<const View*>(message.data());
+        if (*view >= View::mono && *view <= View::right_eye)
+            _view = *view;
+        return true;
+    }
+    case MESSAGE_TYPE_IMAGE_ROW_ORDER:
+    {
+        if (size_t(message.size()) < sizeof(RowOrder))
+            return true;
+        const auto order = reinterpret_cast<const RowOrder*>(message.data());
+        if (*order >= RowOrder::top_down && *order <= RowOrder::bottom_up)
+            _rowOrder = *order;
+        return true;
+    }
+    case MESSAGE_TYPE_IMAGE_CHANNEL:
+    {
+        if (message.isEmpty())
+            return true;
+        _channel = *reinterpret_cast<const uint8_t*>(message.data());
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+Tile TileParser::parseTile(const QByteArray& message) const
+{
+    if (size_t(message.size()) < sizeof(SegmentParameters))
+        throw std::runtime_error("Invalid tile message size");
+
+    const auto data = message.data();
+    const auto params = reinterpret_cast<const SegmentParameters*>(data);
+
+    auto tile = makeTile(*params);
+    tile.imageData = message.right(message.size() - sizeof(SegmentParameters));
+
+    if (tile.format == Format::copy)
+    {
+        uint32_t source[2];
+        if (size_t(tile.imageData.size()) != sizeof(source))
+            throw std::runtime_error("Invalid copy tile message size");
+
+        std::memcpy(source, tile.imageData.constData(), sizeof(source));
+        tile.sourceX = source[0];
+        tile.sourceY = source[1];
+        tile.imageData.clear();
+    }
+    return tile;
+}
+
+Tile TileParser::makeTile(const SegmentParameters& params) const
+{
+    Tile tile;
+    tile.format = params.format;
+    tile.x = params.x;
+    tile.y = params.y;
+    tile.width = params.width;
+    tile.height = params.height;
+    tile.view = _view;
+    tile.rowOrder = _rowOrder;
+    tile.channel = _channel;
+    return tile;
+}
+}
+}
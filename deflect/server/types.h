@@ -48,6 +48,8 @@ namespace server
 {
 class EventReceiver;
 class FrameDispatcher;
+class Relay;
+class TileCache;
 class TileDecoder;
 class Server;
 
@@ -78,7 +78,19 @@ enum class Format : std::uint8_t
     jpeg = 1,
     yuv444,
     yuv422,
-    yuv420
+    yuv420,
+    /**
+     * Uniform image of a single color, stored in 4 bytes: the R, G, B
+     * components and the ChromaSubsampling of the JPEG images it replaces.
+     * Decoded like a jpeg image.
+     */
+    solid,
+    /**
+     * Region of the previous frame copied to the position of the segment,
+     * stored in 8 bytes: the x and y position (uint32_t) of the source region.
+     * It has no pixels to decode.
+     */
+    copy
 };
 
 /** Cast an enum class value to its underlying type. */
@@ -116,6 +128,7 @@ std::future<T> make_exception_future(Exception&& e)
 class ImageSegmenter;
 class Stream;
 
+struct CopyRect;
 struct Event;
 struct ImageWrapper;
 struct MessageHeader;
@@ -0,0 +1,263 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE FrameCompositorTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "FrameUtils.h"
+
+#include <deflect/server/FrameCompositor.h>
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+#include <deflect/ImageSegmenter.h>
+#include <deflect/SegmentTracker.h>
+#include <deflect/server/TileDecoder.h>
+#endif
+
+#include <algorithm>
+#include <numeric>
+
+namespace
+{
+void _fillRgbaTiles(deflect::server::Frame& frame)
+{
+    char value = 0;
+    for (auto& tile : frame.tiles)
+    {
+        tile.format = deflect::Format::rgba;
+        tile.imageData = QByteArray(int(tile.width * tile.height * 4), ++value);
+    }
+}
+}
+
+BOOST_AUTO_TEST_CASE(compose_rgba_frame)
+{
+    auto frame = makeTestFrame(10, 6, 4);
+    _fillRgbaTiles(frame);
+
+    const deflect::server::FrameCompositor compositor(frame);
+    BOOST_CHECK(compositor.getFormat() == deflect::Format::rgba);
+    BOOST_CHECK_EQUAL(compositor.getSize(), QSize(10, 6));
+    BOOST_CHECK_EQUAL(compositor.getBufferSize(), 10 * 6 * 4);
+    BOOST_CHECK_EQUAL(compositor.getSize(1), QSize());
+
+    const auto image = compositor.compose();
+    BOOST_REQUIRE_EQUAL(image.size(), 10 * 6 * 4);
+    for (const auto& tile : frame.tiles)
+    {
+        for (auto y = tile.y; y < tile.y + tile.height; ++y)
+        {
+            for (auto x = tile.x; x < tile.x + tile.width; ++x)
+            {
+                const auto pixel = image.constData() + (y * 10 + x) * 4;
+                BOOST_CHECK_EQUAL(int(pixel[0]), int(tile.imageData[0]));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(compose_into_caller_supplied_buffer)
+{
+    auto frame = makeTestFrame(8, 8, 4);
+    _fillRgbaTiles(frame);
+    for (auto& tile : frame.tiles)
+        tile.view = deflect::View::left_eye;
+
+    const deflect::server::FrameCompositor compositor(frame);
+    std::vector<char> buffer(compositor.getBufferSize(), 42);
+
+    // tiles of other views are ignored
+    compositor.compose(buffer.data(), deflect::View::right_eye);
+    BOOST_CHECK(std::all_of(buffer.begin(), buffer.end(),
+                            [](const char value) { return value == 42; }));
+
+    compositor.compose(buffer.data(), deflect::View::left_eye);
+    BOOST_CHECK_EQUAL(int(buffer.front()), 1);
+    BOOST_CHECK_EQUAL(int(buffer.back()), 4);
+}
+
+BOOST_AUTO_TEST_CASE(compose_bottom_up_tiles_top_down)
+{
+    deflect::server::Frame frame;
+    deflect::server::Tile tile;
+    tile.width = 1;
+    tile.height = 2;
+    tile.format = deflect::Format::rgba;
+    tile.rowOrder = deflect::RowOrder::bottom_up;
+    tile.imageData = QByteArray("bbbbtttt");
+    frame.tiles.push_back(tile);
+
+    const auto image = deflect::server::FrameCompositor(frame).compose();
+    BOOST_CHECK_EQUAL(image.toStdString(), "ttttbbbb");
+}
+
+BOOST_AUTO_TEST_CASE(compose_yuv420_frame)
+{
+    auto frame = makeTestFrame(6, 4, 4);
+    char value = 0;
+    for (auto& tile : frame.tiles)
+    {
+        const auto lumaSize = int(tile.width * tile.height);
+        const auto chromaSize = int((tile.width + 1) / 2 * (tile.height / 2));
+        ++value;
+        tile.format = deflect::Format::yuv420;
+        tile.imageData = QByteArray(lumaSize, value) +
+                         QByteArray(chromaSize, value * 10) +
+                         QByteArray(chromaSize, value * 20);
+    }
+
+    const deflect::server::FrameCompositor compositor(frame);
+    BOOST_REQUIRE_EQUAL(compositor.getBufferSize(), 6 * 4 + 2 * 3 * 2);
+
+    const auto image = compositor.compose();
+    const auto expected = std::string("\1\1\1\1\2\2"
+                                      "\1\1\1\1\2\2"
+                                      "\1\1\1\1\2\2"
+                                      "\1\1\1\1\2\2"
+                                      "\12\12\24"
+                                      "\12\12\24"
+                                      "\24\24\50"
+                                      "\24\24\50",
+                                      36);
+    BOOST_CHECK_EQUAL(image.toStdString(), expected);
+}
+
+BOOST_AUTO_TEST_CASE(compose_applies_copies_before_tiles)
+{
+    deflect::server::Tile copy;
+    copy.format = deflect::Format::copy;
+    copy.width = 1;
+    copy.height = 3;
+    copy.sourceY = 1;
+
+    deflect::server::Tile tile;
+    tile.y = 3;
+    tile.width = 1;
+    tile.height = 1;
+    tile.format = deflect::Format::rgba;
+    tile.imageData = QByteArray("eeee");
+
+    // scroll up by one row, the order of the tiles does not matter
+    deflect::server::Frame frame;
+    frame.tiles = {tile, copy};
+    QByteArray image("aaaabbbbccccdddd");
+    deflect::server::FrameCompositor(frame).compose(image.data());
+    BOOST_CHECK_EQUAL(image.toStdString(), "bbbbccccddddeeee");
+
+    // scroll down by one row
+    copy.y = 1;
+    copy.sourceY = 0;
+    tile.y = 0;
+    tile.imageData = QByteArray("ffff");
+    frame.tiles = {copy, tile};
+    image = QByteArray("aaaabbbbccccdddd");
+    deflect::server::FrameCompositor(frame).compose(image.data());
+    BOOST_CHECK_EQUAL(image.toStdString(), "ffffaaaabbbbcccc");
+}
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
+BOOST_AUTO_TEST_CASE(compose_refined_yuv420_frame)
+{
+    std::vector<char> pixels(128 * 64 * 4);
+    std::iota(pixels.begin(), pixels.end(), 0);
+    deflect::ImageWrapper image(pixels.data(), 128, 64, deflect::RGBA);
+    image.compressionQuality = 50;
+    image.subsampling = deflect::ChromaSubsampling::YUV420;
+
+    deflect::ImageSegmenter segmenter;
+    segmenter.setNominalSegmentDimensions(64, 64);
+    deflect::SegmentTracker tracker{std::chrono::milliseconds(0)};
+
+    deflect::server::Frame frame;
+    segmenter.generate(image, [&](const deflect::Segment& segment) {
+        tracker.update(image, segment.parameters, true);
+        deflect::server::Tile tile;
+        tile.x = segment.parameters.x;
+        tile.y = segment.parameters.y;
+        tile.width = segment.parameters.width;
+        tile.height = segment.parameters.height;
+        tile.imageData = segment.imageData;
+        frame.tiles.push_back(tile);
+        return true;
+    });
+    BOOST_REQUIRE_EQUAL(frame.tiles.size(), 2);
+
+    // the refined segment replaces its tile in the next (partial) frame
+    deflect::SegmentTracker::Refinement refinement;
+    BOOST_REQUIRE(tracker.takeRefinement(refinement));
+    const auto refined =
+        segmenter.createSingleSegment(refinement.makeImage(100));
+    for (auto& tile : frame.tiles)
+    {
+        if (tile.x == refined.parameters.x && tile.y == refined.parameters.y)
+            tile.imageData = refined.imageData;
+    }
+
+    deflect::server::TileDecoder decoder;
+    for (auto& tile : frame.tiles)
+    {
+        BOOST_CHECK(decoder.decodeType(tile) ==
+                    deflect::ChromaSubsampling::YUV420);
+        decoder.decodeToYUV(tile);
+    }
+
+    const deflect::server::FrameCompositor compositor(frame);
+    BOOST_CHECK(compositor.getFormat() == deflect::Format::yuv420);
+    BOOST_CHECK_EQUAL(compositor.compose().size(), 128 * 64 + 2 * 64 * 32);
+}
+#endif
+#endif
+
+BOOST_AUTO_TEST_CASE(compose_requires_decoded_tiles)
+{
+    auto frame = makeTestFrame(8, 8, 4);
+    BOOST_CHECK_THROW(deflect::server::FrameCompositor{frame},
+                      std::runtime_error);
+
+    _fillRgbaTiles(frame);
+    frame.tiles[0].format = deflect::Format::yuv444;
+    BOOST_CHECK_THROW(deflect::server::FrameCompositor{frame},
+                      std::runtime_error);
+
+    frame.tiles.clear();
+    BOOST_CHECK_THROW(deflect::server::FrameCompositor{frame},
+                      std::runtime_error);
+}
@@ -115,6 +115,210 @@ BOOST_FIXTURE_TEST_CASE(dispatch_frame_bottom_up, FixtureFrame)
     compare(frame, *receivedFrame);
 }
 
+BOOST_FIXTURE_TEST_CASE(frame_followed_by_copies_is_not_skipped, FixtureFrame)
+{
+    const auto frame = makeTestFrame(640, 480, 64);
+    for (auto& tile : frame.tiles)
+        dispatcher.processTile(streamId, sourceIndex, tile);
+    dispatcher.processFrameFinished(streamId, sourceIndex);
+
+    deflect::server::Tile copy;
+    copy.format = deflect::Format::copy;
+    copy.width = 64;
+    copy.height = 64;
+    copy.sourceY = 64;
+    auto exposed = frame.tiles[0];
+    exposed.y = 64;
+    dispatcher.processTile(streamId, sourceIndex, copy);
+    dispatcher.processTile(streamId, sourceIndex, exposed);
+    dispatcher.processPartialFrameFinished(streamId, sourceIndex);
+
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    compare(frame, *receivedFrame);
+
+    // the frame keeps the dimensions of the previous one
+    receivedFrame = nullptr;
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_CHECK_EQUAL(receivedFrame->tiles.size(), 2);
+    BOOST_CHECK(receivedFrame->incremental);
+    BOOST_CHECK_EQUAL(receivedFrame->computeDimensions(), QSize(640, 480));
+}
+
+BOOST_FIXTURE_TEST_CASE(frame_with_copies_is_not_skipped, FixtureFrame)
+{
+    const auto frame = makeTestFrame(640, 480, 64);
+    for (auto& tile : frame.tiles)
+        dispatcher.processTile(streamId, sourceIndex, tile);
+    dispatcher.processFrameFinished(streamId, sourceIndex);
+
+    deflect::server::Tile copy;
+    copy.format = deflect::Format::copy;
+    copy.width = 64;
+    copy.height = 64;
+    copy.sourceY = 64;
+    dispatcher.processTile(streamId, sourceIndex, copy);
+    dispatcher.processTile(streamId, sourceIndex, frame.tiles[0]);
+    dispatcher.processPartialFrameFinished(streamId, sourceIndex);
+
+    // a normal frame follows the copies before the next request
+    for (auto& tile : frame.tiles)
+        dispatcher.processTile(streamId, sourceIndex, tile);
+    dispatcher.processFrameFinished(streamId, sourceIndex);
+
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    compare(frame, *receivedFrame);
+
+    // the copies reach the receiver before the normal frame
+    receivedFrame = nullptr;
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_REQUIRE_EQUAL(receivedFrame->tiles.size(), 2);
+    BOOST_CHECK(receivedFrame->tiles[0].format == deflect::Format::copy);
+
+    receivedFrame = nullptr;
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    compare(frame, *receivedFrame);
+}
+
+BOOST_FIXTURE_TEST_CASE(full_frame_is_requested_for_first_partial_frame,
+                        FixtureFrame)
+{
+    size_t requests = 0;
+    QObject::connect(&dispatcher,
+                     &deflect::server::FrameDispatcher::fullFrameRequested,
+                     [&requests](const QString uri, const size_t index) {
+                         BOOST_CHECK_EQUAL(uri.toStdString(), streamId);
+                         BOOST_CHECK_EQUAL(index, sourceIndex);
+                         ++requests;
+                     });
+
+    const auto frame = makeTestFrame(640, 480, 64);
+    for (auto tile : frame.tiles)
+    {
+        tile.imageDataOwner = std::make_shared<int>(0); // as shared memory
+        dispatcher.processTile(streamId, sourceIndex, tile);
+    }
+    dispatcher.processFrameFinished(streamId, sourceIndex);
+    BOOST_CHECK_EQUAL(requests, 0);
+
+    // the shared memory tiles were not kept to complete the partial frame
+    dispatcher.processTile(streamId, sourceIndex, frame.tiles[0]);
+    dispatcher.processPartialFrameFinished(streamId, sourceIndex);
+    BOOST_CHECK_EQUAL(requests, 1);
+
+    // which thus does not skip the last complete frame
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    compare(frame, *receivedFrame);
+
+    receivedFrame = nullptr;
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_CHECK_EQUAL(receivedFrame->tiles.size(), 1);
+    BOOST_CHECK(receivedFrame->incremental);
+    BOOST_CHECK_EQUAL(receivedFrame->computeDimensions(), QSize(640, 480));
+
+    // the next full frame is kept to complete the partial frames
+    dispatch(frame);
+    receivedFrame = nullptr;
+    dispatcher.processTile(streamId, sourceIndex, frame.tiles[0]);
+    dispatcher.processPartialFrameFinished(streamId, sourceIndex);
+    dispatcher.requestFrame(streamId);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_CHECK(!receivedFrame->incremental);
+    BOOST_CHECK_EQUAL(receivedFrame->tiles.size(), frame.tiles.size());
+    BOOST_CHECK_EQUAL(requests, 1);
+}
+
+BOOST_FIXTURE_TEST_CASE(dispatch_region_of_interest, FixtureFrame)
+{
+    const auto frame = makeTestFrame(640, 480, 64);
+
+    dispatcher.setRegionOfInterest(streamId, QRect(100, 100, 80, 50));
+    dispatch(frame);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_CHECK_EQUAL(receivedFrame->tiles.size(), 4);
+    BOOST_CHECK_EQUAL(receivedFrame->computeDimensions(), QSize(640, 480));
+    for (const auto& tile : receivedFrame->tiles)
+    {
+        BOOST_CHECK(tile.x == 64 || tile.x == 128);
+        BOOST_CHECK(tile.y == 64 || tile.y == 128);
+    }
+
+    // frames without tiles in the region are not dispatched
+    receivedFrame = nullptr;
+    dispatcher.setRegionOfInterest(streamId, QRect(1000, 1000, 10, 10));
+    dispatch(frame);
+    BOOST_CHECK(!receivedFrame);
+
+    dispatcher.setRegionOfInterest(streamId, QRect());
+    dispatch(frame);
+    BOOST_REQUIRE(receivedFrame);
+    compare(frame, *receivedFrame);
+}
+
+BOOST_FIXTURE_TEST_CASE(copy_from_outside_region_of_interest_is_removed,
+                        FixtureFrame)
+{
+    size_t requests = 0;
+    QObject::connect(&dispatcher,
+                     &deflect::server::FrameDispatcher::fullFrameRequested,
+                     [&requests](const QString, const size_t) { ++requests; });
+
+    const auto frame = makeTestFrame(640, 480, 64);
+    dispatcher.setRegionOfInterest(streamId, QRect(0, 0, 128, 128));
+    dispatch(frame);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_CHECK_EQUAL(receivedFrame->tiles.size(), 4);
+
+    // the previous frames are kept once the source sends partial frames
+    dispatcher.processTile(streamId, sourceIndex, frame.tiles[0]);
+    dispatcher.processPartialFrameFinished(streamId, sourceIndex);
+    dispatch(frame);
+    requests = 0;
+
+    // the receiver never got the source of the copy, only its exposed tile
+    deflect::server::Tile copy;
+    copy.format = deflect::Format::copy;
+    copy.width = 64;
+    copy.height = 64;
+    copy.y = 64;
+    copy.sourceY = 256;
+    receivedFrame = nullptr;
+    dispatcher.requestFrame(streamId);
+    dispatcher.processTile(streamId, sourceIndex, copy);
+    dispatcher.processTile(streamId, sourceIndex, frame.tiles[0]);
+    dispatcher.processPartialFrameFinished(streamId, sourceIndex);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_REQUIRE_EQUAL(receivedFrame->tiles.size(), 1);
+    BOOST_CHECK(receivedFrame->tiles[0].format != deflect::Format::copy);
+    BOOST_CHECK(receivedFrame->incremental);
+    BOOST_CHECK_EQUAL(requests, 1);
+
+    // the full frame also covers the source of the copy
+    receivedFrame = nullptr;
+    dispatch(frame);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_CHECK(!receivedFrame->incremental);
+    BOOST_CHECK_EQUAL(receivedFrame->tiles.size(), 10);
+
+    // so the copy is now kept
+    requests = 0;
+    receivedFrame = nullptr;
+    dispatcher.requestFrame(streamId);
+    dispatcher.processTile(streamId, sourceIndex, copy);
+    dispatcher.processTile(streamId, sourceIndex, frame.tiles[0]);
+    dispatcher.processPartialFrameFinished(streamId, sourceIndex);
+    BOOST_REQUIRE(receivedFrame);
+    BOOST_REQUIRE_EQUAL(receivedFrame->tiles.size(), 2);
+    BOOST_CHECK(receivedFrame->tiles[0].format == deflect::Format::copy);
+    BOOST_CHECK_EQUAL(requests, 0);
+}
+
 BOOST_FIXTURE_TEST_CASE(dispatch_frame_with_inconsistent_row_order,
                         FixtureFrame)
 {
@@ -44,9 +44,14 @@ namespace ut = boost::unit_test;
 #include <deflect/ImageSegmenter.h>
 #include <deflect/ImageWrapper.h>
 #include <deflect/Segment.h>
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+#include <deflect/server/ImageJpegDecompressor.h>
+#endif
 
 #include <QMutex>
 
+#include <algorithm>
+
 static bool append(deflect::Segments& segments, const deflect::Segment& segment)
 {
     static QMutex lock;
@@ -323,3 +328,113 @@ BOOST_AUTO_TEST_CASE(testImageSegmenterNonUniformSegmentationData)
                                       dataOut + segment.imageData.size());
     }
 }
+
+BOOST_AUTO_TEST_CASE(testImageSegmenterFilteredSegmentationData)
+{
+    // clang-format off
+    char dataIn[] =
+    {
+        1,1,1, 2,2,2, 3,3,3, 4,4,4,
+        5,5,5, 6,6,6, 7,7,7, 8,8,8,
+
+        5,5,5, 6,6,6, 7,7,7, 8,8,8,
+        1,1,1, 2,2,2, 3,3,3, 4,4,4
+    };
+    char dataSegmented[2][12] =
+    {
+        {
+        3,3,3, 4,4,4,
+        7,7,7, 8,8,8
+        },
+        {
+        7,7,7, 8,8,8,
+        3,3,3, 4,4,4
+        }
+    };
+    // clang-format on
+
+    deflect::ImageWrapper imageWrapper(dataIn, 4, 4, deflect::RGB);
+    imageWrapper.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    deflect::ImageSegmenter segmenter;
+    deflect::Segments segments;
+    const auto appendFunc =
+        std::bind(&append, std::ref(segments), std::placeholders::_1);
+    const auto rightColumn = [](const deflect::SegmentParameters& params) {
+        return params.x >= 2;
+    };
+
+    segmenter.setNominalSegmentDimensions(2, 2);
+    BOOST_CHECK(segmenter.generate(imageWrapper, appendFunc, rightColumn));
+    BOOST_REQUIRE_EQUAL(segments.size(), 2);
+
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        const auto& segment = segments[i];
+        BOOST_CHECK_EQUAL(segment.parameters.x, 2);
+        BOOST_CHECK_EQUAL(segment.parameters.y, i * 2);
+
+        const char* dataOut = segment.imageData.constData();
+        BOOST_CHECK_EQUAL_COLLECTIONS(dataSegmented[i], dataSegmented[i] + 12,
+                                      dataOut,
+                                      dataOut + segment.imageData.size());
+    }
+}
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+namespace
+{
+deflect::Segments _generateSortedSegments(const deflect::ImageWrapper& image)
+{
+    deflect::Segments segments;
+    deflect::ImageSegmenter segmenter;
+    segmenter.setNominalSegmentDimensions(8, 8);
+    segmenter.generate(image, std::bind(&append, std::ref(segments),
+                                        std::placeholders::_1));
+    std::sort(segments.begin(), segments.end(),
+              [](const deflect::Segment& a, const deflect::Segment& b) {
+                  return a.parameters.x < b.parameters.x;
+              });
+    return segments;
+}
+}
+
+BOOST_AUTO_TEST_CASE(testContentAdaptiveCompression)
+{
+    // left half: sharp stripes, right half: smooth gradient
+    std::vector<char> data;
+    for (int y = 0; y < 8; ++y)
+    {
+        for (int x = 0; x < 16; ++x)
+        {
+            const char value =
+                x < 8 ? ((x / 3) % 2 ? 255 : 0) : 100 + 3 * x + y;
+            data.insert(data.end(), {value, value, value, char(-1)});
+        }
+    }
+    deflect::ImageWrapper imageWrapper(data.data(), 16, 8, deflect::RGBA);
+    imageWrapper.compressionPolicy = deflect::COMPRESSION_ON;
+    imageWrapper.compressionQuality = 50;
+    imageWrapper.subsampling = deflect::ChromaSubsampling::YUV420;
+
+    const auto reference = _generateSortedSegments(imageWrapper);
+    BOOST_REQUIRE_EQUAL(reference.size(), 2);
+
+    imageWrapper.contentAdaptiveCompression = true;
+    const auto segments = _generateSortedSegments(imageWrapper);
+    BOOST_REQUIRE_EQUAL(segments.size(), 2);
+
+    // only the quality of the sharp segment is raised
+    BOOST_CHECK_GT(segments[0].imageData.size(),
+                   reference[0].imageData.size());
+    BOOST_CHECK(segments[1].imageData == reference[1].imageData);
+
+    // all the segments of a frame keep the same chroma subsampling
+    deflect::server::ImageJpegDecompressor decompressor;
+    for (const auto& segment : segments)
+    {
+        const auto header = decompressor.decompressHeader(segment.imageData);
+        BOOST_CHECK(header.subsampling == deflect::ChromaSubsampling::YUV420);
+    }
+}
+#endif
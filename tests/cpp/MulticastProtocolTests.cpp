@@ -0,0 +1,239 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE MulticastProtocolTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/MulticastProtocol.h>
+
+#include <vector>
+
+namespace
+{
+using Clock = deflect::DatagramAssembler::Clock;
+
+const uint32_t session = 42;
+const uint16_t repairPort = 1234;
+const auto start = Clock::now();
+
+Clock::time_point _after(const int seconds)
+{
+    return start + std::chrono::seconds(seconds);
+}
+
+void _add(deflect::DatagramAssembler& assembler, const QByteArray& datagram,
+          const Clock::time_point now = start)
+{
+    deflect::DatagramHeader header;
+    QByteArray payload;
+    BOOST_REQUIRE(deflect::parseDatagram(datagram, header, payload));
+    BOOST_REQUIRE_EQUAL(header.session, session);
+    assembler.add(header, payload, now);
+}
+
+QByteArray _makePayload(const int size)
+{
+    QByteArray payload(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i)
+        payload[i] = char(i % 251);
+    return payload;
+}
+
+void _checkMessage(deflect::DatagramAssembler& assembler,
+                   const QByteArray& expectedPayload)
+{
+    deflect::MessageHeader header;
+    QByteArray payload;
+    BOOST_REQUIRE(assembler.takeMessage(header, payload));
+    BOOST_CHECK_EQUAL(header.type, deflect::MESSAGE_TYPE_PIXELSTREAM);
+    BOOST_CHECK_EQUAL(std::string(header.uri), "stream");
+    BOOST_CHECK_EQUAL(header.size, uint32_t(expectedPayload.size()));
+    BOOST_CHECK(payload == expectedPayload);
+}
+
+deflect::MessageHeader _makeHeader(const QByteArray& payload)
+{
+    return deflect::MessageHeader(deflect::MESSAGE_TYPE_PIXELSTREAM,
+                                  payload.size(), "stream");
+}
+}
+
+BOOST_AUTO_TEST_CASE(testMessagesAreSplitIntoDatagramsAndReassembled)
+{
+    deflect::DatagramHistory history(session, repairPort, 16);
+    const auto small = _makePayload(10);
+    const auto large = _makePayload(5000);
+
+    const auto smallDatagrams = history.add(_makeHeader(small), small);
+    const auto largeDatagrams = history.add(_makeHeader(large), large);
+    BOOST_CHECK_EQUAL(smallDatagrams.size(), 1u);
+    BOOST_CHECK_EQUAL(largeDatagrams.size(), 4u);
+    BOOST_CHECK_EQUAL(history.getNextSequence(), 5u);
+
+    deflect::DatagramAssembler assembler;
+    for (const auto& datagram : smallDatagrams)
+        _add(assembler, datagram);
+    _checkMessage(assembler, small);
+
+    for (const auto& datagram : largeDatagrams)
+        _add(assembler, datagram);
+    _checkMessage(assembler, large);
+
+    deflect::MessageHeader header;
+    QByteArray payload;
+    BOOST_CHECK(!assembler.takeMessage(header, payload));
+    BOOST_CHECK(assembler.getNack(_after(1)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(testLostDatagramsAreRequestedAndRepaired)
+{
+    deflect::DatagramHistory history(session, repairPort, 16);
+    const auto message = _makePayload(5000);
+    const auto datagrams = history.add(_makeHeader(message), message);
+    BOOST_REQUIRE_EQUAL(datagrams.size(), 4u);
+
+    deflect::DatagramAssembler assembler;
+    _add(assembler, datagrams[0]);
+    _add(assembler, datagrams[2]);
+    _add(assembler, datagrams[3]);
+
+    deflect::MessageHeader header;
+    QByteArray payload;
+    BOOST_CHECK(!assembler.takeMessage(header, payload));
+
+    // requests are not repeated before an interval
+    const auto ranges = assembler.getNack(_after(1));
+    BOOST_REQUIRE_EQUAL(ranges.size(), 1u);
+    BOOST_CHECK_EQUAL(ranges[0].first, 1u);
+    BOOST_CHECK_EQUAL(ranges[0].count, 1u);
+    BOOST_CHECK(assembler.getNack(_after(1)).empty());
+
+    const auto nack = deflect::makeNack(session, ranges);
+    deflect::DatagramHeader nackHeader;
+    QByteArray nackPayload;
+    BOOST_REQUIRE(deflect::parseDatagram(nack, nackHeader, nackPayload));
+    BOOST_CHECK(nackHeader.type == deflect::DatagramType::nack);
+
+    const auto repairs = history.getRepairs(deflect::parseNack(nackPayload));
+    BOOST_REQUIRE_EQUAL(repairs.size(), 1u);
+    BOOST_CHECK(repairs[0] == datagrams[1]);
+
+    _add(assembler, repairs[0], _after(1));
+    _checkMessage(assembler, message);
+    BOOST_CHECK(assembler.getNack(_after(2)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(testHeartbeatRevealsTheLossOfTheLastDatagrams)
+{
+    deflect::DatagramHistory history(session, repairPort, 16);
+    const auto message = _makePayload(2000);
+    const auto datagrams = history.add(_makeHeader(message), message);
+    BOOST_REQUIRE_EQUAL(datagrams.size(), 2u);
+
+    deflect::DatagramAssembler assembler;
+    _add(assembler, datagrams[0]);
+    BOOST_CHECK(assembler.getNack(_after(1)).empty());
+
+    _add(assembler, history.makeHeartbeat(), _after(1));
+    const auto ranges = assembler.getNack(_after(2));
+    BOOST_REQUIRE_EQUAL(ranges.size(), 1u);
+    BOOST_CHECK_EQUAL(ranges[0].first, 1u);
+    BOOST_CHECK_EQUAL(ranges[0].count, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(testGapsWhichAreNotRepairedAreSkipped)
+{
+    // the history no longer has the first message
+    deflect::DatagramHistory history(session, repairPort, 1);
+    const auto first = _makePayload(2000);
+    const auto second = _makePayload(100);
+    const auto firstDatagrams = history.add(_makeHeader(first), first);
+    const auto secondDatagrams = history.add(_makeHeader(second), second);
+    BOOST_REQUIRE_EQUAL(firstDatagrams.size(), 2u);
+    BOOST_REQUIRE_EQUAL(secondDatagrams.size(), 1u);
+
+    deflect::DatagramAssembler assembler;
+    _add(assembler, firstDatagrams[0]);
+    _add(assembler, secondDatagrams[0]);
+
+    int seconds = 0;
+    std::vector<deflect::SequenceRange> ranges;
+    while (!(ranges = assembler.getNack(_after(++seconds))).empty())
+    {
+        BOOST_REQUIRE_LT(seconds, 10);
+        BOOST_CHECK(history.getRepairs(ranges).empty());
+    }
+    BOOST_CHECK_GT(seconds, 1);
+    BOOST_CHECK_EQUAL(assembler.getLostCount(), 1u);
+
+    _checkMessage(assembler, second);
+    deflect::MessageHeader header;
+    QByteArray payload;
+    BOOST_CHECK(!assembler.takeMessage(header, payload));
+}
+
+BOOST_AUTO_TEST_CASE(testReceiverJoiningLateStartsAtTheNextMessage)
+{
+    deflect::DatagramHistory history(session, repairPort, 16);
+    const auto first = _makePayload(2000);
+    const auto second = _makePayload(100);
+    const auto firstDatagrams = history.add(_makeHeader(first), first);
+    const auto secondDatagrams = history.add(_makeHeader(second), second);
+
+    deflect::DatagramAssembler assembler;
+    _add(assembler, firstDatagrams[1]);
+    _add(assembler, secondDatagrams[0]);
+
+    _checkMessage(assembler, second);
+    BOOST_CHECK(assembler.getNack(_after(1)).empty());
+    BOOST_CHECK_EQUAL(assembler.getLostCount(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(testFullFrameRequestIsParsed)
+{
+    const auto request = deflect::makeFullFrameRequest(session);
+    deflect::DatagramHeader header;
+    QByteArray payload;
+    BOOST_REQUIRE(deflect::parseDatagram(request, header, payload));
+    BOOST_CHECK(header.type == deflect::DatagramType::fullFrame);
+    BOOST_CHECK_EQUAL(header.session, session);
+    BOOST_CHECK(payload.isEmpty());
+}
@@ -43,6 +43,7 @@ namespace ut = boost::unit_test;
 
 #include <deflect/Event.h>
 #include <deflect/MessageHeader.h>
+#include <deflect/Visibility.h>
 
 #include <QByteArray>
 #include <QDataStream>
@@ -103,3 +104,88 @@ BOOST_AUTO_TEST_CASE(testEventSerialization)
     BOOST_CHECK_EQUAL(eventDeserialized.key, event.key);
     BOOST_CHECK_EQUAL(eventDeserialized.modifiers, event.modifiers);
 }
+
+BOOST_AUTO_TEST_CASE(testCompactEventsSerialization)
+{
+    std::vector<deflect::Event> events(3);
+
+    events[0].type = deflect::Event::EVT_TOUCH_UPDATE;
+    events[0].mouseX = 0.1234567890123;
+    events[0].mouseY = 1.0 / 3.0;
+    events[0].key = 7;
+
+    events[1].type = deflect::Event::EVT_KEY_PRESS;
+    events[1].key = 'Y';
+    events[1].modifiers = Qt::ControlModifier;
+    events[1].text[0] = 'Y';
+    events[1].text[1] = '\0';
+
+    events[2].type = deflect::Event::EVT_PAN;
+    events[2].dx = -0.6;
+    events[2].dy = 0.2;
+    events[2].mouseLeft = true;
+    events[2].mouseMiddle = true;
+
+    const auto data = deflect::serializeEvents(events);
+    BOOST_CHECK_LT(size_t(data.size()),
+                   events.size() * deflect::Event::serializedSize);
+
+    const auto deserialized = deflect::deserializeEvents(data);
+    BOOST_REQUIRE_EQUAL(deserialized.size(), events.size());
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(deserialized[i].type, events[i].type);
+        BOOST_CHECK_EQUAL(deserialized[i].mouseX, events[i].mouseX);
+        BOOST_CHECK_EQUAL(deserialized[i].mouseY, events[i].mouseY);
+        BOOST_CHECK_EQUAL(deserialized[i].dx, events[i].dx);
+        BOOST_CHECK_EQUAL(deserialized[i].dy, events[i].dy);
+        BOOST_CHECK_EQUAL(deserialized[i].mouseLeft, events[i].mouseLeft);
+        BOOST_CHECK_EQUAL(deserialized[i].mouseRight, events[i].mouseRight);
+        BOOST_CHECK_EQUAL(deserialized[i].mouseMiddle, events[i].mouseMiddle);
+        BOOST_CHECK_EQUAL(deserialized[i].key, events[i].key);
+        BOOST_CHECK_EQUAL(deserialized[i].modifiers, events[i].modifiers);
+    }
+    BOOST_CHECK_EQUAL(std::string(deserialized[1].text), "Y");
+}
+
+BOOST_AUTO_TEST_CASE(testCompactEventsDeserializationOfTruncatedData)
+{
+    std::vector<deflect::Event> events(1);
+    events[0].type = deflect::Event::EVT_MOVE;
+    events[0].mouseX = 0.5;
+
+    const auto data = deflect::serializeEvents(events);
+    BOOST_CHECK_THROW(deflect::deserializeEvents(data.left(data.size() - 1)),
+                      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(testVisibilitySerialization)
+{
+    deflect::Visibility visibility;
+    visibility.regions = {QRect(0, 0, 512, 256), QRect(1024, 512, 100, 50)};
+    visibility.scale = 0.25;
+
+    const auto data = deflect::serializeVisibility(visibility);
+    const auto deserialized = deflect::deserializeVisibility(data);
+
+    BOOST_CHECK(deserialized.regions == visibility.regions);
+    BOOST_CHECK_EQUAL(deserialized.scale, visibility.scale);
+    BOOST_CHECK(deserialized.intersects(QRect(500, 200, 64, 64)));
+    BOOST_CHECK(!deserialized.intersects(QRect(512, 0, 512, 512)));
+
+    BOOST_CHECK_THROW(deflect::deserializeVisibility(data.left(20)),
+                      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(testNotVisibleSerialization)
+{
+    BOOST_CHECK(deflect::Visibility().intersects(QRect(0, 0, 4096, 4096)));
+
+    deflect::Visibility hidden;
+    hidden.regions.clear();
+
+    const auto deserialized =
+        deflect::deserializeVisibility(deflect::serializeVisibility(hidden));
+    BOOST_CHECK(deserialized.regions.empty());
+    BOOST_CHECK(!deserialized.intersects(QRect(0, 0, 4096, 4096)));
+}
@@ -0,0 +1,263 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE QuickRendererTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/qt/QuickRenderer.h>
+
+#include <QGuiApplication>
+#include <QOpenGLContext>
+#include <QQmlComponent>
+#include <QQmlEngine>
+#include <QQuickItem>
+#include <QQuickRenderControl>
+#include <QQuickWindow>
+
+#include <memory>
+#include <vector>
+
+namespace
+{
+const QSize FRAME_SIZE(64, 32);
+// Fills the top half of the frame, the bottom half shows the window color
+const QByteArray QML_RECTANGLE("import QtQuick 2.0\nRectangle {}");
+
+bool _hasOpenGL()
+{
+    QOpenGLContext context;
+    return context.create();
+}
+
+void _checkImage(const QImage& image, const QColor& color)
+{
+    BOOST_REQUIRE(image.size() == FRAME_SIZE);
+    const auto bottom = FRAME_SIZE.height() - 1;
+    BOOST_CHECK_EQUAL(image.pixel(0, 0), color.rgba());
+    BOOST_CHECK_EQUAL(image.pixel(FRAME_SIZE.width() - 1, 0), color.rgba());
+    BOOST_CHECK_EQUAL(image.pixel(0, bottom), QColor(Qt::white).rgba());
+}
+
+void _checkPixel(const QByteArray& pixels, const int row, const QColor& color)
+{
+    const auto pixel = pixels.constData() + row * FRAME_SIZE.width() * 4;
+    BOOST_CHECK_EQUAL(int(uchar(pixel[0])), color.red());
+    BOOST_CHECK_EQUAL(int(uchar(pixel[1])), color.green());
+    BOOST_CHECK_EQUAL(int(uchar(pixel[2])), color.blue());
+    BOOST_CHECK_EQUAL(int(uchar(pixel[3])), 255);
+}
+
+void _checkRawFrame(const QByteArray& pixels, const QColor& color)
+{
+    BOOST_REQUIRE_EQUAL(pixels.size(), FRAME_SIZE.width() *
+                                           FRAME_SIZE.height() * 4);
+    // bottom-up, as read from OpenGL
+    _checkPixel(pixels, 0, Qt::white);
+    _checkPixel(pixels, FRAME_SIZE.height() - 1, color);
+}
+}
+
+// QQuickRenderControl needs a QGuiApplication; without a display, the frames
+// are rendered with the offscreen platform (e.g. on Mesa).
+struct GlobalQtGuiApp
+{
+    GlobalQtGuiApp()
+    {
+        if (qgetenv("QT_QPA_PLATFORM").isEmpty())
+            qputenv("QT_QPA_PLATFORM", "offscreen");
+        auto& testSuite = ut::framework::master_test_suite();
+        app.reset(new QGuiApplication(testSuite.argc, testSuite.argv));
+    }
+    std::unique_ptr<QGuiApplication> app;
+};
+
+BOOST_GLOBAL_FIXTURE(GlobalQtGuiApp);
+
+struct Fixture
+{
+    Fixture()
+    {
+        window.resize(FRAME_SIZE);
+        window.setColor(Qt::white);
+        component.setData(QML_RECTANGLE, QUrl());
+        rectangle.reset(qobject_cast<QQuickItem*>(component.create()));
+        BOOST_REQUIRE(rectangle);
+        rectangle->setSize(QSizeF(FRAME_SIZE.width(), FRAME_SIZE.height() / 2));
+        rectangle->setParentItem(window.contentItem());
+    }
+
+    ~Fixture()
+    {
+        if (renderer)
+            renderer->stop();
+    }
+
+    // Single-threaded, the frames are delivered during render() and flush()
+    void init(const bool asyncReadback, const bool raw)
+    {
+        renderer.reset(new deflect::qt::QuickRenderer(
+            window, control, false, deflect::qt::RenderTarget::FBO));
+        renderer->setAsyncReadbackEnabled(asyncReadback);
+
+        QObject::connect(renderer.get(),
+                         &deflect::qt::QuickRenderer::frameReady,
+                         [this](const QImage image) {
+                             images.push_back(image);
+                         });
+        if (raw)
+        {
+            QObject::connect(renderer.get(),
+                             &deflect::qt::QuickRenderer::frameReadyRaw,
+                             [this](const QByteArray pixels, const QSize) {
+                                 rawFrames.push_back(pixels);
+                             });
+        }
+        renderer->init();
+    }
+
+    bool supportsAsyncReadback() const
+    {
+        return renderer->context()->format().majorVersion() >= 3;
+    }
+
+    void render(const QColor& color)
+    {
+        rectangle->setProperty("color", color);
+        control.polishItems();
+        renderer->render();
+    }
+
+    QQuickRenderControl control;
+    QQuickWindow window{&control};
+    QQmlEngine engine;
+    QQmlComponent component{&engine};
+    std::unique_ptr<QQuickItem> rectangle;
+    std::unique_ptr<deflect::qt::QuickRenderer> renderer;
+    std::vector<QImage> images;
+    std::vector<QByteArray> rawFrames;
+};
+
+BOOST_FIXTURE_TEST_CASE(async_readback_delivers_frames_one_frame_late, Fixture)
+{
+    if (!_hasOpenGL())
+    {
+        BOOST_TEST_MESSAGE("Skipped, OpenGL is not available");
+        return;
+    }
+    init(true, false);
+    if (!supportsAsyncReadback())
+    {
+        BOOST_TEST_MESSAGE("Skipped, OpenGL 3 is not available");
+        return;
+    }
+
+    render(Qt::red);
+    BOOST_CHECK(images.empty());
+
+    // the previous frame is delivered when the next one is read back
+    render(Qt::blue);
+    BOOST_REQUIRE_EQUAL(images.size(), 1);
+    _checkImage(images[0], Qt::red);
+
+    // the last frame is delivered by flush()
+    renderer->flush();
+    BOOST_REQUIRE_EQUAL(images.size(), 2);
+    _checkImage(images[1], Qt::blue);
+
+    renderer->flush();
+    BOOST_CHECK_EQUAL(images.size(), 2);
+}
+
+BOOST_FIXTURE_TEST_CASE(async_readback_delivers_raw_frames_one_frame_late,
+                        Fixture)
+{
+    if (!_hasOpenGL())
+    {
+        BOOST_TEST_MESSAGE("Skipped, OpenGL is not available");
+        return;
+    }
+    init(true, true);
+    if (!supportsAsyncReadback())
+    {
+        BOOST_TEST_MESSAGE("Skipped, OpenGL 3 is not available");
+        return;
+    }
+
+    render(Qt::red);
+    BOOST_CHECK(rawFrames.empty());
+    BOOST_CHECK(images.empty());
+
+    render(Qt::blue);
+    BOOST_REQUIRE_EQUAL(rawFrames.size(), 1);
+    BOOST_REQUIRE_EQUAL(images.size(), 1);
+    _checkRawFrame(rawFrames[0], Qt::red);
+    _checkImage(images[0], Qt::red);
+
+    renderer->flush();
+    BOOST_REQUIRE_EQUAL(rawFrames.size(), 2);
+    _checkRawFrame(rawFrames[1], Qt::blue);
+}
+
+BOOST_FIXTURE_TEST_CASE(synchronous_readback_delivers_frames_immediately,
+                        Fixture)
+{
+    if (!_hasOpenGL())
+    {
+        BOOST_TEST_MESSAGE("Skipped, OpenGL is not available");
+        return;
+    }
+    init(false, true);
+
+    render(Qt::red);
+    BOOST_REQUIRE_EQUAL(images.size(), 1);
+    BOOST_REQUIRE_EQUAL(rawFrames.size(), 1);
+    _checkImage(images[0], Qt::red);
+    _checkRawFrame(rawFrames[0], Qt::red);
+
+    render(Qt::blue);
+    BOOST_REQUIRE_EQUAL(images.size(), 2);
+    _checkImage(images[1], Qt::blue);
+    _checkRawFrame(rawFrames[1], Qt::blue);
+
+    // nothing is pending
+    renderer->flush();
+    BOOST_CHECK_EQUAL(images.size(), 2);
+}
@@ -44,6 +44,8 @@ namespace ut = boost::unit_test;
 #include <deflect/server/Frame.h>
 #include <deflect/server/ReceiveBuffer.h>
 
+#include <algorithm>
+
 inline std::ostream& operator<<(std::ostream& str, const QSize& s)
 {
     str << s.width() << 'x' << s.height();
@@ -488,3 +490,209 @@ BOOST_AUTO_TEST_CASE(TestStereoFourSourcesScreenSpaceAndStereoSplit)
 
     _testStereoBuffer(buffer);
 }
+
+// Start sending partial frames, the previous frame is then always kept
+void _startPartialFrames(deflect::server::ReceiveBuffer& buffer,
+                         const size_t sourceIndex,
+                         const deflect::server::Tiles& frame)
+{
+    _insert(buffer, sourceIndex, frame);
+    buffer.finishPartialFrameForSource(sourceIndex);
+    BOOST_REQUIRE(!buffer.needsFullFrame(sourceIndex));
+    buffer.popFrame();
+}
+
+BOOST_AUTO_TEST_CASE(TestPartialFrameKeepsUncoveredTilesOfPreviousFrame)
+{
+    const size_t sourceIndex = 46;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex);
+
+    const auto testTiles = generateTestTiles();
+    _startPartialFrames(buffer, sourceIndex, testTiles);
+    _insert(buffer, sourceIndex, testTiles);
+    buffer.finishFrameForSource(sourceIndex);
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+    BOOST_CHECK_EQUAL(buffer.popFrame().size(), 4);
+
+    auto updatedTile = testTiles[2];
+    updatedTile.imageData = "updated";
+    buffer.insert(updatedTile, sourceIndex);
+    buffer.finishPartialFrameForSource(sourceIndex);
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+
+    const auto tiles = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL(tiles.size(), 4);
+    BOOST_CHECK_EQUAL(tiles[3].imageData.toStdString(), "updated");
+    for (size_t i = 0; i < 3; ++i)
+        BOOST_CHECK(tiles[i].imageData.isEmpty());
+
+    deflect::server::Frame frame;
+    frame.tiles = tiles;
+    BOOST_CHECK_EQUAL(frame.computeDimensions(), QSize(192, 768));
+
+    // a full frame replaces all the tiles of the previous frame
+    buffer.insert(testTiles[0], sourceIndex);
+    buffer.finishFrameForSource(sourceIndex);
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+    BOOST_CHECK_EQUAL(buffer.popFrame().size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(TestPartialFrameAfterCopiesKeepsUntouchedTiles)
+{
+    const size_t sourceIndex = 46;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex);
+
+    const auto testTiles = generateTestTiles();
+    _startPartialFrames(buffer, sourceIndex, testTiles);
+    _insert(buffer, sourceIndex, testTiles);
+    buffer.finishFrameForSource(sourceIndex);
+    BOOST_CHECK(!buffer.isNextFrameCopying());
+    BOOST_CHECK_EQUAL(buffer.popFrame().size(), 4);
+
+    auto copy = testTiles[0];
+    copy.format = deflect::Format::copy;
+    copy.sourceY = 128;
+    buffer.insert(copy, sourceIndex);
+    buffer.insert(testTiles[1], sourceIndex);
+    buffer.finishPartialFrameForSource(sourceIndex);
+    BOOST_REQUIRE(buffer.hasCompleteFrame());
+    BOOST_CHECK(buffer.isNextFrameCopying());
+
+    BOOST_CHECK(buffer.isNextFrameIncomplete());
+
+    const auto tiles = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL(tiles.size(), 2);
+    BOOST_CHECK(tiles[0].format == deflect::Format::copy);
+
+    // the next partial frame keeps the tiles not overwritten by the copies,
+    // but the copies are not applied again
+    buffer.insert(testTiles[2], sourceIndex);
+    buffer.finishPartialFrameForSource(sourceIndex);
+    BOOST_CHECK(!buffer.isNextFrameCopying());
+    BOOST_CHECK(buffer.isNextFrameIncomplete());
+
+    deflect::server::Frame frame;
+    frame.tiles = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL(frame.tiles.size(), 3);
+    for (const auto& tile : frame.tiles)
+        BOOST_CHECK(tile.format != deflect::Format::copy);
+    BOOST_CHECK_EQUAL(frame.computeDimensions(), QSize(192, 768));
+
+    // a full frame is complete again
+    _insert(buffer, sourceIndex, testTiles);
+    buffer.finishFrameForSource(sourceIndex);
+    BOOST_CHECK(!buffer.isNextFrameIncomplete());
+    BOOST_CHECK_EQUAL(buffer.popFrame().size(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(TestPartialFrameAfterCopiesKeepsMovedTiles)
+{
+    const size_t sourceIndex = 46;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex);
+
+    const auto testTiles = generateTestTiles();
+    _startPartialFrames(buffer, sourceIndex, testTiles);
+    _insert(buffer, sourceIndex, testTiles);
+    buffer.finishFrameForSource(sourceIndex);
+    buffer.popFrame();
+
+    // scroll the left column up by the height of its first tile
+    auto copy = testTiles[2];
+    copy.format = deflect::Format::copy;
+    copy.y = 0;
+    copy.sourceX = testTiles[2].x;
+    copy.sourceY = testTiles[2].y;
+    buffer.insert(copy, sourceIndex);
+    buffer.finishPartialFrameForSource(sourceIndex);
+    BOOST_REQUIRE_EQUAL(buffer.popFrame().size(), 1);
+
+    auto exposed = testTiles[0];
+    exposed.y = testTiles[2].height;
+    buffer.insert(exposed, sourceIndex);
+    buffer.finishPartialFrameForSource(sourceIndex);
+
+    deflect::server::Frame frame;
+    frame.tiles = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL(frame.tiles.size(), 4);
+    const auto moved =
+        std::find_if(frame.tiles.begin(), frame.tiles.end(),
+                     [&](const deflect::server::Tile& tile) {
+                         return tile.x == 0 && tile.y == 0 &&
+                                tile.height == testTiles[2].height;
+                     });
+    BOOST_CHECK(moved != frame.tiles.end());
+    BOOST_CHECK_EQUAL(frame.computeDimensions(), QSize(192, 768));
+}
+
+BOOST_AUTO_TEST_CASE(TestPartialFrameAfterFullFramesIsComplete)
+{
+    const size_t sourceIndex = 46;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex);
+
+    const auto testTiles = generateTestTiles();
+    for (size_t i = 0; i < 2; ++i)
+    {
+        _insert(buffer, sourceIndex, testTiles);
+        buffer.finishFrameForSource(sourceIndex);
+        BOOST_CHECK_EQUAL(buffer.popFrame().size(), 4);
+    }
+
+    // the last full frame completes the first partial frame
+    auto updatedTile = testTiles[2];
+    updatedTile.imageData = "updated";
+    buffer.insert(updatedTile, sourceIndex);
+    buffer.finishPartialFrameForSource(sourceIndex);
+    BOOST_CHECK(!buffer.needsFullFrame(sourceIndex));
+    BOOST_CHECK(!buffer.isNextFrameIncomplete());
+
+    const auto tiles = buffer.popFrame();
+    BOOST_REQUIRE_EQUAL(tiles.size(), 4);
+    BOOST_CHECK_EQUAL(tiles[3].imageData.toStdString(), "updated");
+}
+
+BOOST_AUTO_TEST_CASE(TestPartialFrameNeedsFullFrameIfPreviousWasNotKept)
+{
+    const size_t sourceIndex = 46;
+
+    deflect::server::ReceiveBuffer buffer;
+    buffer.addSource(sourceIndex);
+
+    auto testTiles = generateTestTiles();
+    for (auto& tile : testTiles)
+        tile.imageDataOwner = std::make_shared<int>(0); // as shared memory
+    _insert(buffer, sourceIndex, testTiles);
+    buffer.finishFrameForSource(sourceIndex);
+    BOOST_CHECK(!buffer.needsFullFrame(sourceIndex));
+    BOOST_CHECK_EQUAL(buffer.popFrame().size(), 4);
+
+    // the shared memory tiles of the first full frame were not kept
+    for (size_t i = 0; i < 2; ++i)
+    {
+        buffer.insert(testTiles[2], sourceIndex);
+        buffer.finishPartialFrameForSource(sourceIndex);
+        BOOST_CHECK(buffer.needsFullFrame(sourceIndex));
+        BOOST_CHECK(buffer.isNextFrameIncomplete());
+        BOOST_CHECK_EQUAL(buffer.popFrame().size(), 1);
+    }
+
+    _insert(buffer, sourceIndex, testTiles);
+    buffer.finishFrameForSource(sourceIndex);
+    BOOST_CHECK(!buffer.needsFullFrame(sourceIndex));
+    BOOST_CHECK(!buffer.isNextFrameIncomplete());
+    BOOST_CHECK_EQUAL(buffer.popFrame().size(), 4);
+
+    // from now on the partial frames are completed
+    buffer.insert(testTiles[2], sourceIndex);
+    buffer.finishPartialFrameForSource(sourceIndex);
+    BOOST_CHECK(!buffer.needsFullFrame(sourceIndex));
+    BOOST_CHECK(!buffer.isNextFrameIncomplete());
+    BOOST_CHECK_EQUAL(buffer.popFrame().size(), 4);
+}
@@ -0,0 +1,170 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE SegmentTrackerTests
+
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/ImageWrapper.h>
+#include <deflect/SegmentTracker.h>
+
+#include <vector>
+
+namespace
+{
+deflect::SegmentParameters _makeSegment(const uint32_t x, const uint32_t y)
+{
+    deflect::SegmentParameters params;
+    params.x = x;
+    params.y = y;
+    params.width = 2;
+    params.height = 2;
+    return params;
+}
+}
+
+BOOST_AUTO_TEST_CASE(testSegmentChangesAreDetected)
+{
+    std::vector<char> data(4 * 4 * 4, 0);
+    const deflect::ImageWrapper image(data.data(), 4, 4, deflect::RGBA);
+    const auto topLeft = _makeSegment(0, 0);
+    const auto bottomRight = _makeSegment(2, 2);
+
+    deflect::SegmentTracker tracker{std::chrono::hours(1)};
+    BOOST_CHECK(tracker.update(image, topLeft, false));
+    BOOST_CHECK(tracker.update(image, bottomRight, false));
+    BOOST_CHECK(!tracker.update(image, topLeft, false));
+    BOOST_CHECK(!tracker.update(image, bottomRight, false));
+
+    data[(3 * 4 + 3) * 4] = 1; // last pixel
+    BOOST_CHECK(!tracker.update(image, topLeft, false));
+    BOOST_CHECK(tracker.update(image, bottomRight, false));
+    BOOST_CHECK(!tracker.update(image, bottomRight, false));
+
+    tracker.clear();
+    BOOST_CHECK(tracker.update(image, topLeft, false));
+}
+
+BOOST_AUTO_TEST_CASE(testChangedSegmentsAreRefinedAfterDelay)
+{
+    std::vector<char> data(4 * 4 * 4, 0);
+    deflect::ImageWrapper image(data.data(), 4, 4, deflect::RGBA);
+    image.channel = 2;
+    image.subsampling = deflect::ChromaSubsampling::YUV420;
+    const auto segment = _makeSegment(2, 0);
+    data[2 * 4] = 42; // first pixel of the segment
+
+    deflect::SegmentTracker delayed{std::chrono::hours(1)};
+    BOOST_CHECK(delayed.update(image, segment, true));
+    deflect::SegmentTracker::Refinement refinement;
+    BOOST_CHECK(!delayed.takeRefinement(refinement));
+    BOOST_CHECK(delayed.getTimeToNextRefinement() > std::chrono::minutes(59));
+
+    deflect::SegmentTracker tracker{std::chrono::milliseconds(0)};
+    BOOST_CHECK(tracker.getTimeToNextRefinement().count() < 0);
+    BOOST_CHECK(tracker.update(image, segment, true));
+    BOOST_CHECK_EQUAL(tracker.getTimeToNextRefinement().count(), 0);
+    BOOST_REQUIRE(tracker.takeRefinement(refinement));
+    BOOST_CHECK_EQUAL(refinement.parameters.x, 2u);
+    BOOST_CHECK_EQUAL(int(refinement.channel), 2);
+    BOOST_CHECK(refinement.subsampling == image.subsampling);
+
+    // only the quality of the refined segment is raised
+    const auto refined = refinement.makeImage(100);
+    BOOST_CHECK_EQUAL(refined.compressionQuality, 100u);
+    BOOST_CHECK(refined.subsampling == deflect::ChromaSubsampling::YUV420);
+    BOOST_CHECK_EQUAL(refined.x, 2u);
+    BOOST_CHECK_EQUAL(int(refined.channel), 2);
+    BOOST_REQUIRE_EQUAL(refinement.pixels.size(), 2 * 2 * 4);
+    BOOST_CHECK_EQUAL(int(refinement.pixels[0]), 42);
+
+    // each change is refined only once
+    BOOST_CHECK(!tracker.takeRefinement(refinement));
+    BOOST_CHECK(!tracker.update(image, segment, true));
+    BOOST_CHECK(!tracker.takeRefinement(refinement));
+
+    // updating without refinement cancels the pending one
+    data[2 * 4] = 0;
+    BOOST_CHECK(tracker.update(image, segment, true));
+    BOOST_CHECK(!tracker.update(image, segment, false));
+    BOOST_CHECK(!tracker.takeRefinement(refinement));
+}
+
+BOOST_AUTO_TEST_CASE(testOverlappingSegmentsAreForgotten)
+{
+    std::vector<char> data(4 * 4 * 4, 0);
+    const deflect::ImageWrapper image(data.data(), 4, 4, deflect::RGBA);
+    const auto topLeft = _makeSegment(0, 0);
+    const auto bottomRight = _makeSegment(2, 2);
+    auto whole = _makeSegment(0, 0);
+    whole.width = 4;
+    whole.height = 4;
+
+    deflect::SegmentTracker tracker{std::chrono::milliseconds(0)};
+    BOOST_CHECK(tracker.update(image, topLeft, true));
+    BOOST_CHECK(tracker.update(image, whole, false));
+
+    // the content of the previous segment is outdated, never refine it
+    deflect::SegmentTracker::Refinement refinement;
+    BOOST_CHECK(!tracker.takeRefinement(refinement));
+    BOOST_CHECK(tracker.update(image, topLeft, false));
+    BOOST_CHECK(tracker.update(image, bottomRight, false));
+    BOOST_CHECK(tracker.update(image, whole, false));
+
+    // the segments which do not overlap are kept
+    BOOST_CHECK(tracker.update(image, topLeft, false));
+    BOOST_CHECK(tracker.update(image, bottomRight, false));
+    BOOST_CHECK(!tracker.update(image, topLeft, false));
+}
+
+BOOST_AUTO_TEST_CASE(testSegmentsAreForgottenWhenFrameSizeChanges)
+{
+    std::vector<char> data(4 * 4 * 4, 0);
+    const deflect::ImageWrapper image(data.data(), 4, 4, deflect::RGBA);
+    const auto segment = _makeSegment(0, 0);
+
+    deflect::SegmentTracker tracker{std::chrono::hours(1)};
+    tracker.setFrameSize(QSize(4, 4));
+    BOOST_CHECK(tracker.update(image, segment, false));
+    tracker.setFrameSize(QSize(4, 4));
+    BOOST_CHECK(!tracker.update(image, segment, false));
+    tracker.setFrameSize(QSize(8, 4));
+    BOOST_CHECK(tracker.update(image, segment, false));
+}
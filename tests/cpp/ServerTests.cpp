@@ -46,15 +46,67 @@ namespace ut = boost::unit_test;
 #include "MinimalGlobalQtApp.h"
 #include "boost_test_thread_safe.h"
 
+#include <deflect/MessageHeader.h>
+#include <deflect/NetworkProtocol.h>
 #include <deflect/Stream.h>
 #include <deflect/server/Frame.h>
+#include <deflect/server/Relay.h>
+
+#include <QDataStream>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QUdpSocket>
 
 #include <boost/mpl/vector.hpp>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <numeric>
 
 namespace
 {
 const QString testStreamId("teststream");
+const QString multicastGroup("239.255.70.1");
+const quint16 multicastPort = 17010;
+
+bool _canUseLoopbackMulticast()
+{
+    const QHostAddress group(multicastGroup);
+    QUdpSocket receiver;
+    if (!receiver.bind(QHostAddress::AnyIPv4, multicastPort,
+                       QUdpSocket::ShareAddress |
+                           QUdpSocket::ReuseAddressHint) ||
+        !receiver.joinMulticastGroup(group))
+    {
+        return false;
+    }
+
+    QUdpSocket sender;
+    sender.bind(QHostAddress::AnyIPv4, 0);
+    sender.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+    return sender.writeDatagram("probe", group, multicastPort) > 0 &&
+           receiver.waitForReadyRead(1000);
+}
+
+// More connections than server threads, so that some of them share a thread
+size_t _getConnectionCount()
+{
+    return size_t(QThread::idealThreadCount()) + 1;
+}
+
+void _write(QTcpSocket& socket, const deflect::MessageType type,
+            const QByteArray& data, const int size)
+{
+    {
+        QDataStream stream(&socket);
+        stream << deflect::MessageHeader(type, size, "rawclient");
+    }
+    socket.write(data);
+    BOOST_REQUIRE(socket.waitForBytesWritten());
+}
 }
 
 BOOST_GLOBAL_FIXTURE(MinimalGlobalQtApp);
@@ -207,6 +259,177 @@ BOOST_AUTO_TEST_CASE(oneObserverAndOneStream)
     SAFE_BOOST_CHECK_EQUAL(getReceivedFrames(), expectedFrames);
 }
 
+BOOST_AUTO_TEST_CASE(observerReceivesEventsAsynchronously)
+{
+    const size_t expectedEvents = 10;
+    {
+        deflect::Observer observer(testStreamId.toStdString(), "localhost",
+                                   serverPort());
+        SAFE_BOOST_REQUIRE(observer.isConnected());
+        waitForMessage(); // handle stream open
+
+        SAFE_BOOST_CHECK(observer.registerForEvents(true));
+        waitForMessage();
+
+        std::atomic<size_t> notifications{0};
+        observer.setEventCallback([&] { ++notifications; });
+
+        deflect::Event event;
+        event.type = deflect::Event::EVT_CLICK;
+        for (size_t i = 0; i < expectedEvents; ++i)
+        {
+            event.key = i;
+            processEvent(event);
+        }
+
+        const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        std::vector<deflect::Event> events;
+        while (events.size() < expectedEvents &&
+               std::chrono::steady_clock::now() < deadline)
+        {
+            const auto newEvents = observer.getEvents();
+            events.insert(events.end(), newEvents.begin(), newEvents.end());
+        }
+
+        BOOST_CHECK_EQUAL(events.size(), expectedEvents);
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            BOOST_CHECK_EQUAL(events[i].type, deflect::Event::EVT_CLICK);
+            BOOST_CHECK_EQUAL(events[i].key, int(i));
+        }
+        BOOST_CHECK(notifications > 0);
+    }
+
+    waitForMessage(); // handle close of observer
+    SAFE_BOOST_CHECK_EQUAL(getOpenedStreams(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(registerForEventsWhileReceivingAsynchronously)
+{
+    {
+        deflect::Observer observer(testStreamId.toStdString(), "localhost",
+                                   serverPort());
+        SAFE_BOOST_REQUIRE(observer.isConnected());
+        waitForMessage(); // handle stream open
+
+        // the background thread must hand over the bind reply
+        observer.setEventCallback([] {});
+        SAFE_BOOST_CHECK(observer.registerForEvents(true));
+        waitForMessage();
+        SAFE_BOOST_CHECK(observer.isRegisteredForEvents());
+    }
+
+    waitForMessage(); // handle close of observer
+    SAFE_BOOST_CHECK_EQUAL(getOpenedStreams(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(coalescedEventsKeepTheirDeltasAndLatestState)
+{
+    const size_t moveCount = 100;
+    const size_t touchUpdateCount = 50;
+    const size_t clickCount = 10;
+    {
+        deflect::Observer observer(testStreamId.toStdString(), "localhost",
+                                   serverPort());
+        SAFE_BOOST_REQUIRE(observer.isConnected());
+        waitForMessage(); // handle stream open
+
+        SAFE_BOOST_CHECK(observer.registerForEvents(true));
+        waitForMessage();
+
+        // Events are merged only while they are pending, so how many of them
+        // get merged depends on timing; the checks below hold in all cases.
+        deflect::Event move;
+        move.type = deflect::Event::EVT_MOVE;
+        move.dx = 1.0;
+        move.dy = 2.0;
+        for (size_t i = 0; i < moveCount; ++i)
+        {
+            move.mouseX = i;
+            processEvent(move);
+        }
+
+        deflect::Event touch;
+        touch.type = deflect::Event::EVT_TOUCH_UPDATE;
+        for (size_t i = 0; i < touchUpdateCount; ++i)
+        {
+            touch.mouseX = i;
+            for (int point = 0; point < 2; ++point)
+            {
+                touch.key = point;
+                processEvent(touch);
+            }
+        }
+
+        deflect::Event click;
+        click.type = deflect::Event::EVT_CLICK;
+        for (size_t i = 0; i < clickCount; ++i)
+        {
+            click.key = i;
+            processEvent(click);
+        }
+
+        const auto deadline =
+            std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        std::vector<deflect::Event> events;
+        while ((events.empty() ||
+                events.back().type != deflect::Event::EVT_CLICK ||
+                events.back().key != int(clickCount - 1)) &&
+               std::chrono::steady_clock::now() < deadline)
+        {
+            const auto newEvents = observer.getEvents();
+            events.insert(events.end(), newEvents.begin(), newEvents.end());
+        }
+
+        double movedX = 0.0;
+        double movedY = 0.0;
+        double lastMouseX = -1.0;
+        double lastTouchX[2] = {-1.0, -1.0};
+        std::vector<int> clicks;
+        auto previousType = deflect::Event::EVT_MOVE;
+        for (const auto& event : events)
+        {
+            switch (event.type)
+            {
+            case deflect::Event::EVT_MOVE:
+                BOOST_CHECK(previousType == deflect::Event::EVT_MOVE);
+                BOOST_CHECK(event.mouseX > lastMouseX);
+                lastMouseX = event.mouseX;
+                movedX += event.dx;
+                movedY += event.dy;
+                break;
+            case deflect::Event::EVT_TOUCH_UPDATE:
+                BOOST_REQUIRE(event.key == 0 || event.key == 1);
+                BOOST_CHECK(event.mouseX > lastTouchX[event.key]);
+                lastTouchX[event.key] = event.mouseX;
+                BOOST_CHECK(previousType != deflect::Event::EVT_CLICK);
+                break;
+            case deflect::Event::EVT_CLICK:
+                clicks.push_back(event.key);
+                break;
+            default:
+                BOOST_ERROR("Unexpected event type " << event.type);
+            }
+            previousType = event.type;
+        }
+
+        BOOST_CHECK_EQUAL(movedX, moveCount * 1.0);
+        BOOST_CHECK_EQUAL(movedY, moveCount * 2.0);
+        BOOST_CHECK_EQUAL(lastMouseX, moveCount - 1);
+        BOOST_CHECK_EQUAL(lastTouchX[0], touchUpdateCount - 1);
+        BOOST_CHECK_EQUAL(lastTouchX[1], touchUpdateCount - 1);
+
+        // Clicks are never merged
+        BOOST_REQUIRE_EQUAL(clicks.size(), clickCount);
+        for (size_t i = 0; i < clickCount; ++i)
+            BOOST_CHECK_EQUAL(clicks[i], int(i));
+    }
+
+    waitForMessage(); // handle close of observer
+    SAFE_BOOST_CHECK_EQUAL(getOpenedStreams(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(closeObserverBeforeStream)
 {
     {
@@ -470,4 +693,435 @@ BOOST_AUTO_TEST_CASE(uncompressedImages)
     BOOST_CHECK_EQUAL(getReceivedFrames(), expectedFrames);
 }
 
+BOOST_AUTO_TEST_CASE(uncompressedImagesThroughSharedMemory)
+{
+    // several segments per frame, more than the slots of the shared memory
+    const unsigned int width = 600;
+    const unsigned int height = 600;
+    std::vector<uint8_t> pixels(width * height * 4);
+    std::iota(pixels.begin(), pixels.end(), 0);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    const size_t expectedFrames = 5;
+    std::atomic<size_t> corruptedRows{0};
+
+    setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_REQUIRE_EQUAL(frame->tiles.size(), 4);
+        for (const auto& tile : frame->tiles)
+        {
+            SAFE_BOOST_CHECK(tile.format == deflect::Format::rgba);
+            const auto rowSize = tile.width * 4;
+            SAFE_BOOST_REQUIRE_EQUAL(tile.imageData.size(),
+                                     int(rowSize * tile.height));
+            for (uint32_t y = 0; y < tile.height; ++y)
+            {
+                const auto row = tile.imageData.constData() + y * rowSize;
+                const auto expected =
+                    pixels.data() + ((tile.y + y) * width + tile.x) * 4;
+                if (std::memcmp(row, expected, rowSize) != 0)
+                    ++corruptedRows;
+            }
+        }
+    });
+
+    qputenv("DEFLECT_SHM_SLOTS", "2");
+    deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                           serverPort());
+    qunsetenv("DEFLECT_SHM_SLOTS");
+    BOOST_REQUIRE(stream.isConnected());
+    waitForMessage(); // handle stream open
+
+    for (size_t i = 0; i < expectedFrames; ++i)
+    {
+        stream.sendAndFinish(image).wait();
+        requestFrame(testStreamId);
+        waitForMessage();
+    }
+
+    BOOST_CHECK_EQUAL(getReceivedFrames(), expectedFrames);
+    BOOST_CHECK_EQUAL(corruptedRows.load(), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_CASE(relayCompressedTilesToDownstreamServer)
+{
+    DeflectServer wall;
+    deflect::server::Relay* relay = nullptr;
+    DeflectServer lab({}, [&](deflect::server::Server& s) {
+        const auto downstream = QString("localhost:%1").arg(wall.serverPort());
+        relay = new deflect::server::Relay(s, {downstream}, &s);
+    });
+
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    std::vector<uint8_t> pixels(width * height * 4);
+    std::iota(pixels.begin(), pixels.end(), 0);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    // the tiles reach the wall as they were sent, at the same position
+    wall.setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_REQUIRE_EQUAL(frame->tiles.size(), 1);
+        SAFE_BOOST_CHECK_EQUAL(frame->uri.toStdString(),
+                               testStreamId.toStdString());
+        const auto& tile = frame->tiles[0];
+        SAFE_BOOST_CHECK(tile.format == deflect::Format::rgba);
+        SAFE_BOOST_CHECK_EQUAL(tile.x, 0u);
+        SAFE_BOOST_CHECK_EQUAL(tile.y, 0u);
+        SAFE_BOOST_CHECK(tile.imageData ==
+                         QByteArray((const char*)pixels.data(), pixels.size()));
+        const auto dim = frame->computeDimensions();
+        SAFE_BOOST_CHECK_EQUAL(dim.width(), width);
+        SAFE_BOOST_CHECK_EQUAL(dim.height(), height);
+    });
+
+    {
+        deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                               lab.serverPort());
+        BOOST_REQUIRE(stream.isConnected());
+        lab.waitForMessage();  // handle stream open
+        wall.waitForMessage(); // relayed stream open
+
+        BOOST_CHECK(stream.sendAndFinish(image).get());
+        wall.requestFrame(testStreamId);
+        wall.waitForMessage();
+    }
+
+    while (lab.getOpenedStreams() > 0)
+        lab.waitForMessage(); // handle stream close
+    while (wall.getOpenedStreams() > 0)
+        wall.waitForMessage(); // relayed stream close
+
+    // the relay requested the frame from the lab server
+    BOOST_CHECK_EQUAL(lab.getReceivedFrames(), 1);
+    BOOST_CHECK_EQUAL(wall.getReceivedFrames(), 1);
+    BOOST_CHECK_EQUAL(relay->getDroppedFrames(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(relayReportsUnreachableDownstreamServer)
+{
+    const QString downstream("localhost:1");
+    std::atomic<bool> failed{false};
+    DeflectServer lab({}, [&](deflect::server::Server& s) {
+        auto relay = new deflect::server::Relay(s, {downstream}, &s);
+        QObject::connect(relay, &deflect::server::Relay::relayError,
+                         [&](const QString uri, const QString address,
+                             const QString) {
+                             SAFE_BOOST_CHECK(uri == testStreamId);
+                             SAFE_BOOST_CHECK(address == downstream);
+                             failed = true;
+                         });
+    });
+
+    {
+        deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                               lab.serverPort());
+        BOOST_REQUIRE(stream.isConnected());
+        lab.waitForMessage(); // handle stream open
+
+        for (size_t i = 0; i < 100 && !failed; ++i)
+            QThread::msleep(50);
+        BOOST_CHECK(failed);
+    }
+
+    // the failed link is closed with the stream
+    while (lab.getOpenedStreams() > 0)
+        lab.waitForMessage(); // handle stream close
+}
+
+BOOST_AUTO_TEST_CASE(aggregateSourcesOfStreamToUpstreamServer)
+{
+    // Same setup as the StreamAggregator application
+    DeflectServer upstream;
+    DeflectServer aggregator({}, [&](deflect::server::Server& s) {
+        const auto host = QString("localhost:%1").arg(upstream.serverPort());
+        new deflect::server::Relay(s, {host}, &s);
+    });
+
+    const size_t sourceCount = _getConnectionCount();
+    const unsigned int size = 4;
+    const std::vector<uint8_t> pixels(size * size * 4);
+
+    upstream.setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_CHECK_EQUAL(frame->tiles.size(), sourceCount);
+        const auto dim = frame->computeDimensions();
+        SAFE_BOOST_CHECK_EQUAL(dim.width(), int(sourceCount * size));
+        SAFE_BOOST_CHECK_EQUAL(dim.height(), size);
+    });
+
+    // the sources must all be added before the first frame is finished, which
+    // is the case once their data (sent after the open) is received
+    size_t dataReceived = 0;
+    aggregator.setDataReceivedCallback(
+        [&](const QString, QByteArray) { ++dataReceived; });
+
+    const char data[] = "ready";
+    std::vector<std::unique_ptr<deflect::Stream>> sources;
+    for (size_t i = 0; i < sourceCount; ++i)
+    {
+        sources.emplace_back(new deflect::Stream(testStreamId.toStdString(),
+                                                 "localhost",
+                                                 aggregator.serverPort()));
+        BOOST_REQUIRE(sources.back()->isConnected());
+        sources.back()->sendData(data, sizeof(data));
+    }
+    while (dataReceived < sourceCount)
+        aggregator.waitForMessage();
+    while (upstream.getOpenedStreams() == 0)
+        upstream.waitForMessage(); // relayed stream open
+
+    // each source sends its part of the frame
+    for (size_t i = 0; i < sourceCount; ++i)
+    {
+        deflect::ImageWrapper image(pixels.data(), size, size, deflect::RGBA,
+                                    unsigned(i) * size, 0);
+        image.compressionPolicy = deflect::COMPRESSION_OFF;
+        BOOST_CHECK(sources[i]->sendAndFinish(image).get());
+    }
+    upstream.requestFrame(testStreamId);
+    while (upstream.getReceivedFrames() == 0)
+        upstream.waitForMessage();
+
+    sources.clear();
+    while (aggregator.getOpenedStreams() > 0)
+        aggregator.waitForMessage(); // handle stream close
+    while (upstream.getOpenedStreams() > 0)
+        upstream.waitForMessage(); // relayed stream close
+
+    // the upstream server received the merged frame over a single connection
+    BOOST_CHECK_EQUAL(aggregator.getReceivedFrames(), 1);
+    BOOST_CHECK_EQUAL(upstream.getReceivedFrames(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(incompleteMessageDoesNotBlockOtherConnections)
+{
+    DeflectServer server;
+
+    const auto sentData = QByteArray{"Hello World!"};
+    QByteArray receivedData;
+    server.setDataReceivedCallback(
+        [&](const QString, QByteArray data) { receivedData = data; });
+
+    // a client which stalls in the middle of a message
+    QTcpSocket client;
+    client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+    BOOST_REQUIRE(client.waitForConnected());
+    const auto version = QByteArray::number(NETWORK_PROTOCOL_VERSION);
+    _write(client, deflect::MESSAGE_TYPE_PIXELSTREAM_OPEN, version,
+           version.size());
+    server.waitForMessage(); // handle stream open
+    _write(client, deflect::MESSAGE_TYPE_DATA, sentData.left(5),
+           sentData.size());
+
+    const unsigned int size = 4;
+    const std::vector<uint8_t> pixels(size * size * 4);
+    deflect::ImageWrapper image(pixels.data(), size, size, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    // the other streams are still served, including the ones sharing its
+    // thread
+    const size_t streamCount = _getConnectionCount();
+    std::vector<std::unique_ptr<deflect::Stream>> streams;
+    for (size_t i = 0; i < streamCount; ++i)
+    {
+        const auto id = testStreamId + QString::number(i);
+        streams.emplace_back(new deflect::Stream(id.toStdString(), "localhost",
+                                                 server.serverPort()));
+        BOOST_REQUIRE(streams.back()->isConnected());
+        while (server.getOpenedStreams() < i + 2)
+            server.waitForMessage(); // handle stream open
+
+        BOOST_CHECK(streams.back()->sendAndFinish(image).get());
+        server.requestFrame(id);
+        while (server.getReceivedFrames() < i + 1)
+            server.waitForMessage();
+    }
+    BOOST_CHECK_EQUAL(server.getReceivedFrames(), streamCount);
+
+    // the message is processed once complete
+    client.write(sentData.mid(5));
+    BOOST_REQUIRE(client.waitForBytesWritten());
+    while (receivedData.isEmpty())
+        server.waitForMessage();
+    BOOST_CHECK(receivedData == sentData);
+}
+
+BOOST_AUTO_TEST_CASE(lateEventRegistrationDoesNotBlockOtherConnections)
+{
+    DeflectServer server;
+    server.holdEventRegistrations();
+
+    deflect::Observer observer(testStreamId.toStdString(), "localhost",
+                               server.serverPort());
+    BOOST_REQUIRE(observer.isConnected());
+    server.waitForMessage(); // handle stream open
+
+    auto registered = std::async(std::launch::async, [&observer] {
+        return observer.registerForEvents(true);
+    });
+    server.waitForMessage(); // handle the registration, left unanswered
+
+    const unsigned int size = 4;
+    const std::vector<uint8_t> pixels(size * size * 4);
+    deflect::ImageWrapper image(pixels.data(), size, size, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    // the other streams are still served, including the ones sharing the
+    // thread of the observer
+    const size_t streamCount = _getConnectionCount();
+    std::vector<std::unique_ptr<deflect::Stream>> streams;
+    for (size_t i = 0; i < streamCount; ++i)
+    {
+        const auto id = testStreamId + QString::number(i);
+        streams.emplace_back(new deflect::Stream(id.toStdString(), "localhost",
+                                                 server.serverPort()));
+        BOOST_REQUIRE(streams.back()->isConnected());
+        while (server.getOpenedStreams() < i + 2)
+            server.waitForMessage(); // handle stream open
+
+        BOOST_CHECK(streams.back()->sendAndFinish(image).get());
+        server.requestFrame(id);
+        while (server.getReceivedFrames() < i + 1)
+            server.waitForMessage();
+    }
+    BOOST_CHECK_EQUAL(server.getReceivedFrames(), streamCount);
+
+    // the observer gets its reply once the application answers
+    BOOST_CHECK(registered.wait_for(std::chrono::seconds(0)) !=
+                std::future_status::ready);
+    server.releaseEventRegistrations();
+    BOOST_CHECK(registered.get());
+    BOOST_CHECK(observer.isRegisteredForEvents());
+}
+
+BOOST_AUTO_TEST_CASE(solidAndCopyTilesAreOnlySentWhenEnabled)
+{
+    const unsigned int size = 64;
+    const std::vector<uint8_t> pixels(size * size * 4, 42);
+    deflect::ImageWrapper image(pixels.data(), size, size, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_ON;
+
+    for (const bool enabled : {false, true})
+    {
+        DeflectServer server({}, [enabled](deflect::server::Server& s) {
+            s.setSolidAndCopyTilesEnabled(enabled);
+        });
+        std::atomic<deflect::Format> format{deflect::Format::rgba};
+        server.setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+            SAFE_BOOST_REQUIRE_EQUAL(frame->tiles.size(), 1);
+            format = frame->tiles[0].format;
+        });
+
+        deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                               server.serverPort());
+        BOOST_REQUIRE(stream.isConnected());
+        server.waitForMessage(); // handle stream open
+
+        // the stream learns the accepted formats when finishing its frames
+        const auto sendFrame = [&] {
+            BOOST_CHECK(stream.sendAndFinish(image).get());
+            server.requestFrame(testStreamId);
+            server.waitForMessage();
+        };
+        sendFrame();
+        BOOST_CHECK(format == deflect::Format::jpeg);
+        for (size_t i = 0; i < 10 && stream.supportsCopyRect() != enabled; ++i)
+            sendFrame();
+        BOOST_CHECK_EQUAL(stream.supportsCopyRect(), enabled);
+
+        sendFrame();
+        BOOST_CHECK(format == (enabled ? deflect::Format::solid
+                                       : deflect::Format::jpeg));
+    }
+}
+
+#ifdef Q_OS_UNIX
+BOOST_AUTO_TEST_CASE(streamOverUnixSocket)
+{
+    const QTemporaryDir dir;
+    BOOST_REQUIRE(dir.isValid());
+    const auto path = dir.filePath("deflect.sock");
+
+    DeflectServer server(path);
+    BOOST_CHECK_EQUAL(server.unixSocketPath().toStdString(),
+                      path.toStdString());
+
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    server.setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_REQUIRE_EQUAL(frame->tiles.size(), 1);
+        const auto dim = frame->computeDimensions();
+        SAFE_BOOST_CHECK_EQUAL(dim.width(), width);
+        SAFE_BOOST_CHECK_EQUAL(dim.height(), height);
+    });
+
+    deflect::Stream stream(testStreamId.toStdString(),
+                           "unix:" + path.toStdString());
+    BOOST_REQUIRE(stream.isConnected());
+    server.waitForMessage(); // handle stream open
+
+    stream.sendAndFinish(image).wait();
+    server.requestFrame(testStreamId);
+    server.waitForMessage();
+
+    BOOST_CHECK_EQUAL(server.getReceivedFrames(), 1);
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(streamOverLoopbackMulticast)
+{
+    if (!_canUseLoopbackMulticast())
+    {
+        BOOST_TEST_MESSAGE("Skipped, loopback multicast is not available");
+        return;
+    }
+
+    DeflectServer server({}, [](deflect::server::Server& s) {
+        s.setMulticastGroup(multicastGroup, multicastPort);
+    });
+    DeflectServer wall({}, [](deflect::server::Server& s) {
+        s.joinMulticastGroup(multicastGroup, multicastPort);
+    });
+
+    const unsigned int width = 4;
+    const unsigned int height = 4;
+    const std::vector<uint8_t> pixels(width * height * 4);
+    deflect::ImageWrapper image(pixels.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_OFF;
+
+    wall.setFrameReceivedCallback([&](deflect::server::FramePtr frame) {
+        SAFE_BOOST_REQUIRE_EQUAL(frame->tiles.size(), 1);
+        SAFE_BOOST_CHECK_EQUAL(frame->uri.toStdString(),
+                               testStreamId.toStdString());
+        const auto dim = frame->computeDimensions();
+        SAFE_BOOST_CHECK_EQUAL(dim.width(), width);
+        SAFE_BOOST_CHECK_EQUAL(dim.height(), height);
+    });
+
+    {
+        deflect::Stream stream(testStreamId.toStdString(), "localhost",
+                               server.serverPort());
+        BOOST_REQUIRE(stream.isConnected());
+        server.waitForMessage(); // handle stream open
+        wall.waitForMessage();   // stream open received through the group
+
+        BOOST_CHECK(stream.sendAndFinish(image).get());
+        wall.requestFrame(testStreamId);
+        wall.waitForMessage();
+    }
+
+    server.waitForMessage(); // handle stream close
+    wall.waitForMessage();
+
+    // the frames only went to the receivers of the group
+    BOOST_CHECK_EQUAL(wall.getReceivedFrames(), 1);
+    BOOST_CHECK_EQUAL(server.getReceivedFrames(), 0);
+    BOOST_CHECK_EQUAL(wall.getOpenedStreams(), 0);
+    BOOST_CHECK_EQUAL(server.getOpenedStreams(), 0);
+}
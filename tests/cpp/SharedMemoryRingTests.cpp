@@ -0,0 +1,119 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE SharedMemoryRingTests
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include <deflect/SharedMemoryRing.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+const uint32_t slotCount = 4;
+const uint32_t slotSize = 16;
+}
+
+BOOST_AUTO_TEST_CASE(testInvalidDimensionsThrow)
+{
+    BOOST_CHECK_THROW(deflect::SharedMemoryRing("test", 0, slotSize),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(deflect::SharedMemoryRing("test", slotCount, 0),
+                      std::invalid_argument);
+    BOOST_CHECK_THROW(deflect::SharedMemoryRing("test", 1000, slotSize),
+                      std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(testAttachToInvalidKeyThrows)
+{
+    BOOST_CHECK_THROW(deflect::SharedMemoryRing("deflect_no_such_ring"),
+                      std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(testConsumerAttachesToTheRingOfTheProducer)
+{
+    deflect::SharedMemoryRing producer("test", slotCount, slotSize);
+    deflect::SharedMemoryRing consumer(producer.getKey());
+    BOOST_CHECK_EQUAL(consumer.getKey(), producer.getKey());
+    BOOST_CHECK_EQUAL(consumer.getSlotCount(), slotCount);
+    BOOST_CHECK_EQUAL(consumer.getSlotSize(), slotSize);
+
+    // each ring has its own key
+    deflect::SharedMemoryRing other("test", slotCount, slotSize);
+    BOOST_CHECK_NE(other.getKey(), producer.getKey());
+}
+
+BOOST_AUTO_TEST_CASE(testPublishedDataIsReadByTheConsumer)
+{
+    deflect::SharedMemoryRing producer("test", slotCount, slotSize);
+    const deflect::SharedMemoryRing consumer(producer.getKey());
+
+    const auto slot = producer.acquireSlot();
+    BOOST_REQUIRE_GE(slot, 0);
+    BOOST_CHECK(!consumer.isPublished(slot));
+
+    const char data[slotSize] = "deflect";
+    std::memcpy(producer.getSlotData(slot), data, slotSize);
+    producer.publishSlot(slot);
+
+    BOOST_REQUIRE(consumer.isPublished(slot));
+    BOOST_CHECK_EQUAL(std::strcmp(consumer.getSlotData(slot), data), 0);
+    BOOST_CHECK(!consumer.isPublished(slotCount)); // out of range
+}
+
+BOOST_AUTO_TEST_CASE(testSlotsAreReusedOnceReleased)
+{
+    deflect::SharedMemoryRing producer("test", slotCount, slotSize);
+    deflect::SharedMemoryRing consumer(producer.getKey());
+
+    for (uint32_t i = 0; i < slotCount; ++i)
+    {
+        const auto slot = producer.acquireSlot();
+        BOOST_REQUIRE_GE(slot, 0);
+        producer.publishSlot(slot);
+    }
+    BOOST_CHECK_EQUAL(producer.acquireSlot(), -1);
+
+    consumer.releaseSlot(2);
+    BOOST_CHECK(!consumer.isPublished(2));
+    BOOST_CHECK_EQUAL(producer.acquireSlot(), 2);
+    BOOST_CHECK_EQUAL(producer.acquireSlot(), -1);
+}
@@ -0,0 +1,184 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE StreamSendWorker
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "DeflectServer.h"
+#include "MinimalDeflectServer.h"
+#include "MinimalGlobalQtApp.h"
+
+#include <deflect/Stream.h>
+#include <deflect/StreamSendWorker.h>
+#include <deflect/server/Frame.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const std::chrono::seconds TIMEOUT{5};
+
+bool _waitFor(const std::function<bool()>& condition)
+{
+    const auto end = std::chrono::steady_clock::now() + TIMEOUT;
+    while (!condition())
+    {
+        if (std::chrono::steady_clock::now() > end)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+}
+
+BOOST_GLOBAL_FIXTURE(MinimalGlobalQtApp);
+
+struct Fixture : MinimalDeflectServer
+{
+    ~Fixture() { worker.reset(); }
+    void start(deflect::IdleTask task)
+    {
+        worker.reset(new deflect::StreamSendWorker(socket, id));
+        worker->setIdleTask(std::move(task));
+        socket.moveToThread(worker.get());
+        worker->start();
+    }
+
+    const std::string id{"test"};
+    deflect::Socket socket{"localhost", serverPort()};
+    std::unique_ptr<deflect::StreamSendWorker> worker;
+};
+
+BOOST_FIXTURE_TEST_CASE(idleTaskRunsWhenNoRequestIsQueued, Fixture)
+{
+    std::atomic<int> calls{0};
+    start([&calls]() {
+        ++calls;
+        return std::chrono::milliseconds(-1);
+    });
+    BOOST_CHECK(_waitFor([&calls] { return calls == 1; }));
+
+    // a negative delay waits for the next request
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(calls, 1);
+    BOOST_CHECK(worker->enqueueRequest([] { return true; }).get());
+    BOOST_CHECK(_waitFor([&calls] { return calls == 2; }));
+}
+
+BOOST_FIXTURE_TEST_CASE(idleTaskRunsAgainAfterItsDelay, Fixture)
+{
+    std::atomic<int> calls{0};
+    start([&calls]() {
+        ++calls;
+        return std::chrono::milliseconds(10);
+    });
+    BOOST_CHECK(_waitFor([&calls] { return calls >= 3; }));
+}
+
+BOOST_FIXTURE_TEST_CASE(requestsAreProcessedBetweenIdleTasks, Fixture)
+{
+    // an idle task which always has more work does not delay the requests
+    std::atomic<int> calls{0};
+    start([&calls]() {
+        ++calls;
+        return std::chrono::milliseconds(0);
+    });
+    BOOST_CHECK(_waitFor([&calls] { return calls > 0; }));
+
+    std::vector<int> processed;
+    std::vector<deflect::Stream::Future> futures;
+    for (int i = 0; i < 10; ++i)
+    {
+        futures.emplace_back(worker->enqueueRequest([&processed, i] {
+            processed.push_back(i);
+            return true;
+        }));
+    }
+    for (auto& future : futures)
+        BOOST_CHECK(future.get());
+    BOOST_CHECK_EQUAL(processed.size(), 10);
+}
+
+BOOST_AUTO_TEST_CASE(staticSegmentsAreRefinedWhenIdle)
+{
+    DeflectServer server;
+
+    std::vector<deflect::server::FramePtr> frames;
+    server.setFrameReceivedCallback([&frames](deflect::server::FramePtr frame) {
+        frames.push_back(frame);
+    });
+
+    const unsigned int size = 128;
+    std::vector<uint8_t> pixels(size * size * 4);
+    std::iota(pixels.begin(), pixels.end(), 0); // not a solid color
+    deflect::ImageWrapper image(pixels.data(), size, size, deflect::RGBA);
+    image.compressionPolicy = deflect::COMPRESSION_ON;
+    image.compressionQuality = 50;
+
+    deflect::Stream stream("refined", "localhost", server.serverPort());
+    BOOST_REQUIRE(stream.isConnected());
+    server.waitForMessage(); // handle stream open
+    stream.setProgressiveRefinement(true);
+
+    BOOST_CHECK(stream.sendAndFinish(image).get());
+    server.requestFrame("refined");
+    while (server.getReceivedFrames() < 1)
+        server.waitForMessage();
+
+    // the send worker sends the segment again at a better quality on its own
+    server.requestFrame("refined");
+    while (server.getReceivedFrames() < 2)
+        server.waitForMessage();
+
+    BOOST_REQUIRE_EQUAL(frames.size(), 2);
+    for (const auto& frame : frames)
+    {
+        BOOST_REQUIRE_EQUAL(frame->tiles.size(), 1);
+        BOOST_CHECK(frame->tiles[0].format == deflect::Format::jpeg);
+        BOOST_CHECK(frame->computeDimensions() == QSize(size, size));
+    }
+    BOOST_CHECK(frames[1]->tiles[0].imageData != frames[0]->tiles[0].imageData);
+}
@@ -47,10 +47,13 @@ namespace ut = boost::unit_test;
 #include <deflect/ImageWrapper.h>
 #include <deflect/server/ImageJpegDecompressor.h>
 #include <deflect/server/Tile.h>
+#include <deflect/server/TileCache.h>
 #include <deflect/server/TileDecoder.h>
 
 #include <QMutex>
-#include <cmath> // std::round
+#include <algorithm>
+#include <cmath>   // std::round
+#include <cstdlib> // std::abs
 
 namespace
 {
@@ -132,8 +135,175 @@ BOOST_AUTO_TEST_CASE(testImageCompressionAndDecompression)
                                   dataOut, dataOut + data.size());
 }
 
+BOOST_AUTO_TEST_CASE(testImageDecompressionAtReducedLevelOfDetail)
+{
+    const auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    imageWrapper.compressionQuality = 100;
+
+    deflect::ImageJpegCompressor compressor;
+    const auto jpegData =
+        compressor.computeJpeg(imageWrapper, QRect(0, 0, 8, 8));
+
+    deflect::server::TileDecoder decoder;
+    for (uint8_t lod = 1; lod <= deflect::server::MAX_JPEG_LOD; ++lod)
+    {
+        deflect::server::Tile tile;
+        tile.width = 8;
+        tile.height = 8;
+        tile.imageData = jpegData;
+
+        decoder.decode(tile, lod);
+        BOOST_CHECK_EQUAL(tile.format, deflect::Format::rgba);
+        BOOST_CHECK_EQUAL(int(tile.lod), int(lod));
+
+        const auto size = 8 >> lod;
+        BOOST_REQUIRE_EQUAL(tile.imageData.size(), size * size * 4);
+        for (int i = 0; i < 3; ++i)
+        {
+            const auto value = tile.imageData[i];
+            BOOST_CHECK_LE(std::abs(int(value) - int(data[i])), 1);
+        }
+    }
+
+    deflect::server::Tile tile;
+    tile.width = 8;
+    tile.height = 8;
+    tile.imageData = jpegData;
+    BOOST_CHECK_THROW(decoder.decode(tile, deflect::server::MAX_JPEG_LOD + 1),
+                      std::invalid_argument);
+    BOOST_CHECK_EQUAL(tile.format, deflect::Format::jpeg);
+}
+
+BOOST_AUTO_TEST_CASE(testDecodeIntoBufferWithPitch)
+{
+    const auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    imageWrapper.compressionQuality = 100;
+
+    deflect::ImageJpegCompressor compressor;
+    const auto jpegData =
+        compressor.computeJpeg(imageWrapper, QRect(0, 0, 8, 8));
+
+    deflect::server::Tile tile;
+    tile.width = 8;
+    tile.height = 8;
+    tile.imageData = jpegData;
+
+    deflect::server::TileDecoder decoder;
+    BOOST_CHECK_EQUAL(decoder.decodeType(tile),
+                      deflect::ChromaSubsampling::YUV444);
+    BOOST_CHECK(tile.jpegHeaderParsed);
+
+    const size_t pitch = 8 * 4 + 16;
+    std::vector<char> buffer(pitch * 8, 0);
+    decoder.decodeInto(tile, buffer.data(), pitch);
+
+    // the tile is left untouched
+    BOOST_CHECK_EQUAL(tile.format, deflect::Format::jpeg);
+    BOOST_CHECK(tile.imageData == jpegData);
+
+    for (size_t y = 0; y < 8; ++y)
+    {
+        const auto row = buffer.data() + y * pitch;
+        const auto expected = data.data() + y * 8 * 4;
+        BOOST_CHECK_EQUAL_COLLECTIONS(expected, expected + 8 * 4, row,
+                                      row + 8 * 4);
+        BOOST_CHECK_EQUAL(row[8 * 4], 0); // padding not overwritten
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testDecodeWithTileCache)
+{
+    const auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    deflect::ImageJpegCompressor compressor;
+    const auto jpegData =
+        compressor.computeJpeg(imageWrapper, QRect(0, 0, 8, 8));
+
+    auto cache = std::make_shared<deflect::server::TileCache>(1024 * 1024);
+    deflect::server::TileDecoder decoder;
+    decoder.setCache(cache);
+
+    deflect::server::Tile tile;
+    tile.width = 8;
+    tile.height = 8;
+    tile.imageData = jpegData;
+
+    auto tile1 = tile;
+    decoder.decode(tile1);
+    BOOST_CHECK_EQUAL(tile1.format, deflect::Format::rgba);
+    BOOST_CHECK_EQUAL(cache->getCount(), 1);
+    BOOST_CHECK_EQUAL(cache->getSize(), size_t(jpegData.size()) + 8 * 8 * 4);
+
+    // identical data is not decoded again, the decoded data is shared
+    auto tile2 = tile;
+    decoder.decode(tile2);
+    BOOST_CHECK_EQUAL(tile2.format, deflect::Format::rgba);
+    BOOST_CHECK(tile2.imageData.constData() == tile1.imageData.constData());
+    BOOST_CHECK_EQUAL(cache->getCount(), 1);
+
+    // a different geometry or level of detail is cached separately
+    auto tile3 = tile;
+    tile3.x = 8;
+    decoder.decode(tile3);
+    auto tile4 = tile;
+    decoder.decode(tile4, 1);
+    BOOST_CHECK_EQUAL(cache->getCount(), 3);
+    BOOST_CHECK(tile3.imageData.constData() != tile1.imageData.constData());
+    BOOST_CHECK_EQUAL(tile4.imageData.size(), 4 * 4 * 4);
+
+    // least recently used tiles are evicted
+    auto smallCache =
+        std::make_shared<deflect::server::TileCache>(cache->getSize() / 2);
+    decoder.setCache(smallCache);
+    for (uint32_t x = 0; x < 8; ++x)
+    {
+        auto newTile = tile;
+        newTile.x = x;
+        decoder.decode(newTile);
+    }
+    BOOST_CHECK_LE(smallCache->getSize(), smallCache->getMaxSize());
+    BOOST_CHECK_EQUAL(smallCache->getCount(), 1);
+
+    smallCache->clear();
+    BOOST_CHECK_EQUAL(smallCache->getSize(), 0);
+}
+
 #ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
 
+BOOST_AUTO_TEST_CASE(testDecodeToYUVIntoBuffer)
+{
+    const auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    imageWrapper.compressionQuality = 100;
+    imageWrapper.subsampling = deflect::ChromaSubsampling::YUV420;
+
+    deflect::ImageJpegCompressor compressor;
+    const auto jpegData =
+        compressor.computeJpeg(imageWrapper, QRect(0, 0, 8, 8));
+
+    deflect::server::Tile tile;
+    tile.width = 8;
+    tile.height = 8;
+    tile.imageData = jpegData;
+
+    deflect::server::TileDecoder decoder;
+    const auto size = decoder.getDecodedSize(tile, deflect::Format::yuv420);
+    BOOST_REQUIRE_EQUAL(size, 8 * 8 + 2 * 4 * 4);
+
+    std::vector<char> buffer(size);
+    BOOST_CHECK_EQUAL(decoder.decodeToYUVInto(tile, buffer.data()),
+                      deflect::Format::yuv420);
+
+    decoder.decodeToYUV(tile);
+    BOOST_CHECK_EQUAL(tile.format, deflect::Format::yuv420);
+    BOOST_REQUIRE_EQUAL(size_t(tile.imageData.size()), size);
+    BOOST_CHECK_EQUAL_COLLECTIONS(buffer.begin(), buffer.end(),
+                                  tile.imageData.begin(),
+                                  tile.imageData.end());
+}
+
 QByteArray decodeToYUVWithDecompressor(
     const QByteArray& jpegData, const deflect::ChromaSubsampling expected)
 {
@@ -282,6 +452,61 @@ BOOST_AUTO_TEST_CASE(testImageSegmentationWithCompressionAndDecompression)
                                   dataOut + tile.imageData.size());
 }
 
+BOOST_AUTO_TEST_CASE(testSolidSegmentsDetectionAndDecoding)
+{
+    auto data = makeTestImage();
+    deflect::ImageWrapper imageWrapper(data.data(), 8, 8, deflect::RGBA);
+    imageWrapper.subsampling = deflect::ChromaSubsampling::YUV420;
+
+    deflect::Segments segments;
+    deflect::ImageSegmenter segmenter;
+    segmenter.setNominalSegmentDimensions(4, 8);
+    segmenter.setSolidSegmentsEnabled(true);
+    const auto appendFunc =
+        std::bind(&append, std::ref(segments), std::placeholders::_1);
+
+    data[1 * 4 + 1] = 0; // left half is no longer uniform
+    segmenter.generate(imageWrapper, appendFunc);
+    BOOST_REQUIRE_EQUAL(segments.size(), 2);
+    std::sort(segments.begin(), segments.end(),
+              [](const deflect::Segment& a, const deflect::Segment& b) {
+                  return a.parameters.x < b.parameters.x;
+              });
+    BOOST_CHECK_EQUAL(segments[0].parameters.format, deflect::Format::jpeg);
+    BOOST_REQUIRE_EQUAL(segments[1].parameters.format, deflect::Format::solid);
+    BOOST_REQUIRE_EQUAL(segments[1].imageData.size(), 4);
+
+    deflect::server::Tile tile;
+    tile.x = 4;
+    tile.width = 4;
+    tile.height = 8;
+    tile.format = deflect::Format::solid;
+    tile.imageData = segments[1].imageData;
+
+    deflect::server::TileDecoder decoder;
+    BOOST_CHECK_EQUAL(decoder.decodeType(tile),
+                      deflect::ChromaSubsampling::YUV420);
+
+    auto rgbaTile = tile;
+    decoder.decode(rgbaTile);
+    BOOST_CHECK_EQUAL(rgbaTile.format, deflect::Format::rgba);
+    BOOST_REQUIRE_EQUAL(rgbaTile.imageData.size(), 4 * 8 * 4);
+    const auto pixels = rgbaTile.imageData.constData();
+    for (int i = 0; i < 4 * 8; ++i)
+    {
+        BOOST_CHECK_EQUAL_COLLECTIONS(data.data(), data.data() + 4,
+                                      pixels + i * 4, pixels + i * 4 + 4);
+    }
+
+#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
+    auto yuvTile = tile;
+    decoder.decodeToYUV(yuvTile);
+    BOOST_CHECK_EQUAL(yuvTile.format, deflect::Format::yuv420);
+    BOOST_REQUIRE_EQUAL(yuvTile.imageData.size(), 4 * 8 + 2 * 2 * 4);
+    BOOST_CHECK_EQUAL(int(uint8_t(yuvTile.imageData[0])), _toY(92, 28, 0));
+#endif
+}
+
 BOOST_AUTO_TEST_CASE(testDecompressionOfInvalidData)
 {
     const QByteArray invalidJpegData{"notjpeg923%^#8"};
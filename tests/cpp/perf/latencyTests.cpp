@@ -0,0 +1,315 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#define BOOST_TEST_MODULE Latency
+#include <boost/test/unit_test.hpp>
+namespace ut = boost::unit_test;
+
+#include "MinimalGlobalQtApp.h"
+
+#include <deflect/ImageSegmenter.h>
+#include <deflect/Segment.h>
+#include <deflect/Stream.h>
+#include <deflect/StreamPrivate.h>
+#include <deflect/defines.h>
+#include <deflect/server/Frame.h>
+#include <deflect/server/FrameDispatcher.h>
+#include <deflect/server/Server.h>
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+#include <deflect/server/TileDecoder.h>
+#endif
+
+#include <QSemaphore>
+#include <QThread>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// Measures the end-to-end latency of single frames streamed over the loopback
+// interface, from the start of the compression until the decoded tiles are
+// available to the server application. Only one frame is in flight at a time.
+//
+// To attribute the latency, the stages are timestamped separately:
+// - compress: segmentation and (JPEG) compression of the image
+// - send: writing all the segments to the client socket
+// - receive: until the last tile and the finish message are processed by the
+//            server and the frame is complete (FrameDispatcher)
+// - dispatch: until the frame is delivered to the application thread
+// - decode: decoding of all the tiles in parallel (TileDecoder)
+//
+// Note: unlike Stream::send(), the compression is completed before sending so
+// that both stages can be measured independently.
+
+#define WIDTH (1920u)
+#define HEIGHT (1080u)
+#define NWARMUP (10u)
+#define NFRAMES (200u)
+
+BOOST_GLOBAL_FIXTURE(MinimalGlobalQtApp);
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+enum Stage
+{
+    STAGE_COMPRESS,
+    STAGE_SEND,
+    STAGE_RECEIVE,
+    STAGE_DISPATCH,
+    STAGE_DECODE,
+    STAGE_COUNT
+};
+const std::array<const char*, STAGE_COUNT> stageNames{
+    {"compress", "send", "receive", "dispatch", "decode"}};
+
+/** The start of a frame followed by the end time of each of its stages. */
+using Timestamps = std::array<Clock::time_point, STAGE_COUNT + 1>;
+
+double _toMs(const Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>{duration}.count();
+}
+
+std::vector<uint8_t> _makeTestImage()
+{
+    std::vector<uint8_t> pixels(WIDTH * HEIGHT * 4);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = uint8_t(qrand());
+    return pixels;
+}
+}
+
+namespace deflect
+{
+namespace test
+{
+/**
+ * Stream pre-segmented images, recording the time spent in each client stage.
+ */
+class Application
+{
+public:
+    Application(const quint16 port, const CompressionPolicy compression)
+        : _pixels(_makeTestImage())
+        , _image(_pixels.data(), WIDTH, HEIGHT, RGBA)
+        , _stream("latency", "localhost", port)
+    {
+        _image.compressionPolicy = compression;
+        _image.compressionQuality = 80;
+        _segmenter.setNominalSegmentDimensions(512, 512);
+    }
+
+    bool isConnected() const { return _stream.isConnected(); }
+    bool sendFrame(Timestamps& times)
+    {
+        times[0] = Clock::now();
+        Segments segments;
+        _segmenter.generate(_image, [&segments](const Segment& segment) {
+            segments.push_back(segment);
+            return true;
+        });
+        times[1 + STAGE_COMPRESS] = Clock::now();
+
+        std::vector<Task> tasks;
+        for (auto& segment : segments)
+            tasks.emplace_back(_stream._impl->task.send(std::move(segment)));
+        tasks.emplace_back([&times] {
+            times[1 + STAGE_SEND] = Clock::now();
+            return true;
+        });
+        auto sent = _stream._impl->sendWorker.enqueueRequest(std::move(tasks));
+        auto finished = _stream.finishFrame();
+        return sent.get() && finished.get();
+    }
+
+private:
+    std::vector<uint8_t> _pixels;
+    ImageWrapper _image;
+    Stream _stream;
+    ImageSegmenter _segmenter;
+};
+}
+}
+
+class LatencyThread : public QThread
+{
+public:
+    LatencyThread(const quint16 port, const deflect::CompressionPolicy policy,
+                  std::vector<Timestamps>& times, QSemaphore& frameProcessed)
+        : _port(port)
+        , _policy(policy)
+        , _times(times)
+        , _frameProcessed(frameProcessed)
+    {
+    }
+
+private:
+    const quint16 _port;
+    const deflect::CompressionPolicy _policy;
+    std::vector<Timestamps>& _times;
+    QSemaphore& _frameProcessed;
+
+    void run() final
+    {
+        deflect::test::Application streamer(_port, _policy);
+        BOOST_CHECK(streamer.isConnected());
+
+        for (auto& times : _times)
+        {
+            if (!streamer.sendFrame(times))
+                break;
+            _frameProcessed.acquire();
+        }
+        QCoreApplication::instance()->exit();
+    }
+};
+
+void printStatistics(const std::string& name, std::vector<Timestamps> times)
+{
+    times.erase(times.begin(), times.begin() + NWARMUP);
+
+    std::cout << name << ": latency of " << times.size() << " frames of "
+              << WIDTH << "x" << HEIGHT << " [ms]" << std::endl;
+    std::cout << std::left << std::setw(10) << "stage" << std::right
+              << std::setw(10) << "p50" << std::setw(10) << "p99"
+              << std::setw(10) << "max" << std::endl;
+
+    const auto print = [&times](const char* stageName, const size_t begin,
+                                const size_t end) {
+        std::vector<double> values;
+        for (const auto& t : times)
+            values.push_back(_toMs(t[end] - t[begin]));
+        std::sort(values.begin(), values.end());
+        const auto percentile = [&values](const double p) {
+            const auto i = size_t(std::ceil(p * values.size()));
+            return values[std::min(std::max<size_t>(i, 1), values.size()) - 1];
+        };
+        std::cout << std::left << std::setw(10) << stageName << std::right
+                  << std::fixed << std::setprecision(3) << std::setw(10)
+                  << percentile(0.5) << std::setw(10) << percentile(0.99)
+                  << std::setw(10) << values.back() << std::endl;
+    };
+
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+        print(stageNames[stage], stage, stage + 1);
+    print("total", 0, STAGE_COUNT);
+}
+
+std::vector<Timestamps> measureLatency(const deflect::CompressionPolicy policy)
+{
+    using deflect::server::FrameDispatcher;
+    using deflect::server::FramePtr;
+    using deflect::server::Server;
+
+    std::vector<Timestamps> times(NWARMUP + NFRAMES);
+    std::atomic<size_t> frameIndex{0};
+    std::atomic<bool> frameComplete{false};
+    QSemaphore frameProcessed;
+
+    Server server(0);
+    const auto dispatcher = server.findChild<FrameDispatcher*>();
+    BOOST_REQUIRE(dispatcher);
+
+    QObject::connect(&server, &Server::pixelStreamOpened, &server,
+                     &Server::requestFrame);
+
+    // Emitted from the server worker thread as soon as the frame is complete
+    QObject::connect(dispatcher, &FrameDispatcher::sendFrame,
+                     [&](FramePtr) {
+                         times[frameIndex][1 + STAGE_RECEIVE] = Clock::now();
+                         frameComplete = true;
+                     },
+                     Qt::DirectConnection);
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+    std::vector<std::unique_ptr<deflect::server::TileDecoder>> decoders;
+#endif
+    QObject::connect(&server, &Server::receivedFrame, [&](FramePtr frame) {
+        auto& t = times[frameIndex];
+        t[1 + STAGE_DISPATCH] = Clock::now();
+
+        // The queued receivedFrame() may overtake the direct slot above
+        while (!frameComplete)
+            std::this_thread::yield();
+        frameComplete = false;
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+        while (decoders.size() < frame->tiles.size())
+            decoders.emplace_back(new deflect::server::TileDecoder);
+        for (size_t i = 0; i < frame->tiles.size(); ++i)
+        {
+            if (frame->tiles[i].format == deflect::Format::jpeg)
+                decoders[i]->startDecoding(frame->tiles[i]);
+        }
+        for (size_t i = 0; i < frame->tiles.size(); ++i)
+            decoders[i]->waitDecoding();
+#endif
+        t[1 + STAGE_DECODE] = Clock::now();
+
+        ++frameIndex;
+        server.requestFrame(frame->uri);
+        frameProcessed.release();
+    });
+
+    LatencyThread thread(server.getPort(), policy, times, frameProcessed);
+    thread.start();
+    QCoreApplication::instance()->exec();
+    BOOST_CHECK(thread.wait());
+    BOOST_CHECK_EQUAL(frameIndex.load(), times.size());
+    return times;
+}
+
+BOOST_AUTO_TEST_CASE(testRawLatency)
+{
+    printStatistics("raw", measureLatency(deflect::COMPRESSION_OFF));
+}
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+BOOST_AUTO_TEST_CASE(testJpegLatency)
+{
+    printStatistics("jpeg", measureLatency(deflect::COMPRESSION_ON));
+}
+#endif
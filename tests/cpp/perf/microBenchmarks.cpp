@@ -0,0 +1,471 @@
+/*********************************************************************/
+/* Copyright (c) 2018, EPFL/Blue Brain Project                       */
+/*                     Raphael Dumusc <raphael.dumusc@epfl.ch>       */
+/* All rights reserved.                                              */
+/*                                                                   */
+/* Redistribution and use in source and binary forms, with or        */
+/* without modification, are permitted provided that the following   */
+/* conditions are met:                                               */
+/*                                                                   */
+/*   1. Redistributions of source code must retain the above         */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer.                                                  */
+/*                                                                   */
+/*   2. Redistributions in binary form must reproduce the above      */
+/*      copyright notice, this list of conditions and the following  */
+/*      disclaimer in the documentation and/or other materials       */
+/*      provided with the distribution.                              */
+/*                                                                   */
+/*    THIS  SOFTWARE  IS  PROVIDED  BY  THE  ECOLE  POLYTECHNIQUE    */
+/*    FEDERALE DE LAUSANNE  ''AS IS''  AND ANY EXPRESS OR IMPLIED    */
+/*    WARRANTIES, INCLUDING, BUT  NOT  LIMITED  TO,  THE  IMPLIED    */
+/*    WARRANTIES OF MERCHANTABILITY AND FITNESS FOR  A PARTICULAR    */
+/*    PURPOSE  ARE  DISCLAIMED.  IN  NO  EVENT  SHALL  THE  ECOLE    */
+/*    POLYTECHNIQUE  FEDERALE  DE  LAUSANNE  OR  CONTRIBUTORS  BE    */
+/*    LIABLE  FOR  ANY  DIRECT,  INDIRECT,  INCIDENTAL,  SPECIAL,    */
+/*    EXEMPLARY,  OR  CONSEQUENTIAL  DAMAGES  (INCLUDING, BUT NOT    */
+/*    LIMITED TO,  PROCUREMENT  OF  SUBSTITUTE GOODS OR SERVICES;    */
+/*    LOSS OF USE, DATA, OR  PROFITS;  OR  BUSINESS INTERRUPTION)    */
+/*    HOWEVER CAUSED AND  ON ANY THEORY OF LIABILITY,  WHETHER IN    */
+/*    CONTRACT, STRICT LIABILITY,  OR TORT  (INCLUDING NEGLIGENCE    */
+/*    OR OTHERWISE) ARISING  IN ANY WAY  OUT OF  THE USE OF  THIS    */
+/*    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.   */
+/*                                                                   */
+/* The views and conclusions contained in the software and           */
+/* documentation are those of the authors and should not be          */
+/* interpreted as representing official policies, either expressed   */
+/* or implied, of Ecole polytechnique federale de Lausanne.          */
+/*********************************************************************/
+
+#include "Timer.h"
+
+#include <deflect/ImageSegmenter.h>
+#include <deflect/ImageWrapper.h>
+#include <deflect/MessageHeader.h>
+#include <deflect/defines.h>
+#include <deflect/server/Frame.h>
+#include <deflect/server/ReceiveBuffer.h>
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+#include <deflect/ImageJpegCompressor.h>
+#include <deflect/server/ImageJpegDecompressor.h>
+#endif
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QDateTime>
+#include <QRect>
+#include <QThread>
+
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+/**
+ * Micro-benchmarks for the hot paths of the library.
+ *
+ * The command line flags and the JSON output follow the conventions of Google
+ * Benchmark, so that results can be archived and compared between revisions
+ * with the usual tools (e.g. compare.py), without depending on the library.
+ */
+
+namespace
+{
+const unsigned int IMAGE_WIDTH = 3840;
+const unsigned int IMAGE_HEIGHT = 2160;
+const unsigned int SEGMENT_SIZE = 512;
+const unsigned int JPEG_QUALITY = 80;
+const size_t SOURCE_COUNT = 4;
+const size_t MAX_ITERATIONS = 1000000000;
+
+struct BenchmarkOptions
+{
+    BenchmarkOptions(int& argc, char** argv)
+        : desc("Allowed options")
+    {
+        using namespace boost::program_options;
+        // clang-format off
+        desc.add_options()
+            ("help", "produce help message")
+            ("benchmark_filter", value<std::string>()->default_value(".*"),
+                     "run only the benchmarks matching this regex")
+            ("benchmark_min_time", value<double>()->default_value(0.5),
+                     "minimum time to run each benchmark [seconds]")
+            ("benchmark_format", value<std::string>()->default_value("console"),
+                     "output format on stdout: console|json")
+            ("benchmark_out", value<std::string>()->default_value(""),
+                     "write the results as json to this file")
+        ;
+        // clang-format on
+
+        variables_map vm;
+        store(parse_command_line(argc, argv, desc), vm);
+        notify(vm);
+
+        getHelp = vm.count("help");
+        filter = vm["benchmark_filter"].as<std::string>();
+        minTime = vm["benchmark_min_time"].as<double>();
+        format = vm["benchmark_format"].as<std::string>();
+        outFile = vm["benchmark_out"].as<std::string>();
+    }
+
+    boost::program_options::options_description desc;
+
+    bool getHelp = false;
+    std::string filter;
+    double minTime = 0.5;
+    std::string format;
+    std::string outFile;
+};
+
+struct Result
+{
+    std::string name;
+    size_t iterations;
+    double realTime; // [ns] per iteration
+    double cpuTime;  // [ns] per iteration
+    size_t bytesPerIteration;
+
+    double bytesPerSecond() const
+    {
+        return realTime > 0.0 ? bytesPerIteration * 1e9 / realTime : 0.0;
+    }
+};
+
+/**
+ * Minimal benchmark runner: the function is repeated with an increasing number
+ * of iterations until the batch lasts at least the minimum time.
+ */
+class Runner
+{
+public:
+    explicit Runner(const BenchmarkOptions& options)
+        : _options(options)
+        , _filter(options.filter)
+    {
+    }
+
+    using Function = std::function<void()>;
+
+    void run(const std::string& name, const Function& func,
+             const size_t bytesPerIteration = 0)
+    {
+        if (!std::regex_search(name, _filter))
+            return;
+
+        func(); // warm-up
+
+        size_t iterations = 1;
+        while (true)
+        {
+            Timer timer;
+            const auto cpuStart = std::clock();
+            timer.start();
+            for (size_t i = 0; i < iterations; ++i)
+                func();
+            const double realTime = timer.elapsed();
+            const double cpuTime =
+                double(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+
+            if (realTime >= _options.minTime || iterations >= MAX_ITERATIONS)
+            {
+                _add({name, iterations, realTime * 1e9 / iterations,
+                      cpuTime * 1e9 / iterations, bytesPerIteration});
+                return;
+            }
+            // Aim for the minimum time, growing at most by 10x per step
+            const double factor =
+                realTime > 0.0 ? 1.4 * _options.minTime / realTime : 10.0;
+            iterations = std::max(iterations + 1,
+                                  size_t(iterations * std::min(factor, 10.0)));
+        }
+    }
+
+    void writeJson(std::ostream& out) const
+    {
+        out << "{\n";
+        out << "  \"context\": {\n";
+        out << "    \"date\": \""
+            << QDateTime::currentDateTime().toString(Qt::ISODate).toStdString()
+            << "\",\n";
+        out << "    \"executable\": \"deflect-microBenchmarks\",\n";
+        out << "    \"num_cpus\": " << QThread::idealThreadCount() << ",\n";
+#ifdef NDEBUG
+        out << "    \"library_build_type\": \"release\"\n";
+#else
+        out << "    \"library_build_type\": \"debug\"\n";
+#endif
+        out << "  },\n";
+        out << "  \"benchmarks\": [\n";
+        for (size_t i = 0; i < _results.size(); ++i)
+        {
+            const auto& result = _results[i];
+            out << "    {\n";
+            out << "      \"name\": \"" << result.name << "\",\n";
+            out << "      \"run_name\": \"" << result.name << "\",\n";
+            out << "      \"run_type\": \"iteration\",\n";
+            out << "      \"iterations\": " << result.iterations << ",\n";
+            out << "      \"real_time\": " << result.realTime << ",\n";
+            out << "      \"cpu_time\": " << result.cpuTime << ",\n";
+            if (result.bytesPerIteration > 0)
+                out << "      \"bytes_per_second\": " << result.bytesPerSecond()
+                    << ",\n";
+            out << "      \"time_unit\": \"ns\"\n";
+            out << "    }" << (i + 1 < _results.size() ? "," : "") << "\n";
+        }
+        out << "  ]\n";
+        out << "}\n";
+    }
+
+private:
+    const BenchmarkOptions& _options;
+    const std::regex _filter;
+    std::vector<Result> _results;
+
+    void _add(Result&& result)
+    {
+        if (_options.format == "console")
+        {
+            std::cout << std::left << std::setw(56) << result.name << std::right
+                      << std::setw(14) << std::fixed << std::setprecision(0)
+                      << result.realTime << " ns" << std::setw(14)
+                      << result.cpuTime << " ns" << std::setw(12)
+                      << result.iterations;
+            if (result.bytesPerIteration > 0)
+                std::cout << std::setw(12) << std::setprecision(1)
+                          << result.bytesPerSecond() / (1024 * 1024)
+                          << " MiB/s";
+            std::cout << std::endl;
+        }
+        _results.emplace_back(std::move(result));
+    }
+};
+
+/** A mix of smooth gradients and noise, to be representative of rendering. */
+std::vector<char> makeTestImage(const unsigned int width,
+                                const unsigned int height)
+{
+    std::vector<char> data(size_t(width) * height * 4);
+    uint32_t seed = 42;
+    for (unsigned int y = 0; y < height; ++y)
+    {
+        for (unsigned int x = 0; x < width; ++x)
+        {
+            seed = seed * 1664525u + 1013904223u; // LCG, deterministic
+            const auto noise = (seed >> 24) & 0x1f;
+            auto pixel = &data[(size_t(y) * width + x) * 4];
+            pixel[0] = char((x * 255 / width) ^ noise);
+            pixel[1] = char((y * 255 / height) ^ noise);
+            pixel[2] = char(((x + y) & 0xff));
+            pixel[3] = char(0xff);
+        }
+    }
+    return data;
+}
+
+deflect::ImageWrapper makeImage(const std::vector<char>& data,
+                                const unsigned int width,
+                                const unsigned int height,
+                                const deflect::CompressionPolicy compression)
+{
+    deflect::ImageWrapper image(data.data(), width, height, deflect::RGBA);
+    image.compressionPolicy = compression;
+    image.compressionQuality = JPEG_QUALITY;
+    return image;
+}
+
+std::string makeName(const std::string& name, const unsigned int width,
+                     const unsigned int height)
+{
+    return name + "/" + std::to_string(width) + "x" + std::to_string(height);
+}
+
+deflect::server::Tiles makeTiles(const unsigned int width,
+                                 const unsigned int height)
+{
+    deflect::server::Tiles tiles;
+    for (unsigned int y = 0; y < height; y += SEGMENT_SIZE)
+    {
+        for (unsigned int x = 0; x < width; x += SEGMENT_SIZE)
+        {
+            deflect::server::Tile tile;
+            tile.x = x;
+            tile.y = y;
+            tile.width = std::min(SEGMENT_SIZE, width - x);
+            tile.height = std::min(SEGMENT_SIZE, height - y);
+            tiles.push_back(tile);
+        }
+    }
+    return tiles;
+}
+
+void benchmarkImageSegmenter(Runner& runner)
+{
+    const auto data = makeTestImage(IMAGE_WIDTH, IMAGE_HEIGHT);
+
+    deflect::ImageSegmenter segmenter;
+    segmenter.setNominalSegmentDimensions(SEGMENT_SIZE, SEGMENT_SIZE);
+    const auto handler = [](const deflect::Segment&) { return true; };
+
+    const auto raw = makeImage(data, IMAGE_WIDTH, IMAGE_HEIGHT,
+                               deflect::COMPRESSION_OFF);
+    runner.run(makeName("ImageSegmenter/generate/raw", IMAGE_WIDTH,
+                        IMAGE_HEIGHT),
+               [&] { segmenter.generate(raw, handler); }, data.size());
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+    const auto jpeg =
+        makeImage(data, IMAGE_WIDTH, IMAGE_HEIGHT, deflect::COMPRESSION_ON);
+    runner.run(makeName("ImageSegmenter/generate/jpeg", IMAGE_WIDTH,
+                        IMAGE_HEIGHT),
+               [&] { segmenter.generate(jpeg, handler); }, data.size());
+#endif
+}
+
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+void benchmarkJpeg(Runner& runner)
+{
+    const auto size = SEGMENT_SIZE;
+    const auto data = makeTestImage(size, size);
+    const QRect region(0, 0, size, size);
+
+    for (const auto subsamp : {deflect::ChromaSubsampling::YUV444,
+                               deflect::ChromaSubsampling::YUV420})
+    {
+        auto image = makeImage(data, size, size, deflect::COMPRESSION_ON);
+        image.subsampling = subsamp;
+        const auto suffix =
+            subsamp == deflect::ChromaSubsampling::YUV444 ? "/444" : "/420";
+
+        deflect::ImageJpegCompressor compressor;
+        runner.run(makeName("ImageJpegCompressor/computeJpeg", size, size) +
+                       suffix,
+                   [&] { compressor.computeJpeg(image, region); },
+                   data.size());
+
+        const auto jpegData = compressor.computeJpeg(image, region);
+        deflect::server::ImageJpegDecompressor decompressor;
+        runner.run(makeName("ImageJpegDecompressor/decompress", size, size) +
+                       suffix,
+                   [&] { decompressor.decompress(jpegData); }, data.size());
+#ifndef DEFLECT_USE_LEGACY_LIBJPEGTURBO
+        runner.run(makeName("ImageJpegDecompressor/decompressToYUV", size,
+                            size) +
+                       suffix,
+                   [&] { decompressor.decompressToYUV(jpegData); },
+                   data.size());
+#endif
+    }
+}
+#endif
+
+void benchmarkMessageHeader(Runner& runner)
+{
+    const deflect::MessageHeader header(deflect::MESSAGE_TYPE_PIXELSTREAM, 512,
+                                        "BenchmarkStream");
+    QByteArray storage;
+    storage.reserve(deflect::MessageHeader::serializedSize);
+
+    runner.run("MessageHeader/serialize",
+               [&] {
+                   storage.clear();
+                   QDataStream out(&storage, QIODevice::WriteOnly);
+                   out << header;
+               },
+               deflect::MessageHeader::serializedSize);
+
+    deflect::MessageHeader deserialized;
+    runner.run("MessageHeader/deserialize",
+               [&] {
+                   QDataStream in(storage);
+                   in >> deserialized;
+               },
+               deflect::MessageHeader::serializedSize);
+}
+
+void benchmarkReceiveBuffer(Runner& runner)
+{
+    const auto tiles = makeTiles(IMAGE_WIDTH, IMAGE_HEIGHT);
+
+    deflect::server::ReceiveBuffer buffer;
+    for (size_t source = 0; source < SOURCE_COUNT; ++source)
+        buffer.addSource(source);
+
+    const auto name = makeName("ReceiveBuffer/insert+popFrame", IMAGE_WIDTH,
+                               IMAGE_HEIGHT) +
+                      "/" + std::to_string(SOURCE_COUNT) + "sources";
+    runner.run(name, [&] {
+        for (size_t source = 0; source < SOURCE_COUNT; ++source)
+        {
+            for (const auto& tile : tiles)
+                buffer.insert(tile, source);
+            buffer.finishFrameForSource(source);
+        }
+        if (buffer.hasCompleteFrame())
+            buffer.popFrame();
+    });
+}
+
+void benchmarkFrame(Runner& runner)
+{
+    deflect::server::Frame frame;
+    for (uint8_t channel = 0; channel < 2; ++channel)
+    {
+        for (auto view : {deflect::View::left_eye, deflect::View::right_eye})
+        {
+            for (auto tile : makeTiles(IMAGE_WIDTH, IMAGE_HEIGHT))
+            {
+                tile.channel = channel;
+                tile.view = view;
+                frame.tiles.push_back(tile);
+            }
+        }
+    }
+
+    const auto name = makeName("Frame/computeChannelDimensions", IMAGE_WIDTH,
+                               IMAGE_HEIGHT) +
+                      "/" + std::to_string(frame.tiles.size()) + "tiles";
+    runner.run(name, [&] { frame.computeChannelDimensions(); });
+}
+}
+
+int main(int argc, char** argv)
+{
+    const BenchmarkOptions options(argc, argv);
+    if (options.getHelp)
+    {
+        std::cout << options.desc;
+        return 0;
+    }
+
+    Runner runner(options);
+    benchmarkImageSegmenter(runner);
+#ifdef DEFLECT_USE_LIBJPEGTURBO
+    benchmarkJpeg(runner);
+#endif
+    benchmarkMessageHeader(runner);
+    benchmarkReceiveBuffer(runner);
+    benchmarkFrame(runner);
+
+    if (options.format == "json")
+        runner.writeJson(std::cout);
+
+    if (!options.outFile.empty())
+    {
+        std::ofstream file(options.outFile);
+        if (!file)
+        {
+            std::cerr << "Could not open: " << options.outFile << std::endl;
+            return 1;
+        }
+        runner.writeJson(file);
+    }
+    return 0;
+}
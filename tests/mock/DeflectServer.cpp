@@ -42,9 +42,26 @@
 
 #include <boost/test/unit_test.hpp>
 
-DeflectServer::DeflectServer()
+DeflectServer::DeflectServer(const QString& unixSocketPath,
+                             const ServerSetup& setup)
 {
-    _server = new deflect::server::Server(0 /* OS-chosen port */);
+    if (unixSocketPath.isEmpty())
+        _server = new deflect::server::Server(0 /* OS-chosen port */);
+    else
+        _server = new deflect::server::Server(0, unixSocketPath);
+
+    if (setup)
+    {
+        try
+        {
+            setup(*_server);
+        }
+        catch (...)
+        {
+            delete _server;
+            throw;
+        }
+    }
     _server->moveToThread(&_thread);
     _thread.connect(&_thread, &QThread::finished, _server,
                     &deflect::server::Server::deleteLater);
@@ -109,7 +126,10 @@ DeflectServer::DeflectServer()
                                                        evtReceiver);
 
                          _eventReceiver = evtReceiver;
-                         success->set_value(true);
+                         if (_holdRegistrations)
+                             _heldRegistrations.push_back(success);
+                         else
+                             success->set_value(true);
                          _receivedState = true;
                          _received.wakeAll();
                          _mutex.unlock();
@@ -145,6 +165,21 @@ void DeflectServer::waitForMessage()
     _receivedState = false;
 }
 
+void DeflectServer::holdEventRegistrations()
+{
+    QMutexLocker lock(&_mutex);
+    _holdRegistrations = true;
+}
+
+void DeflectServer::releaseEventRegistrations()
+{
+    QMutexLocker lock(&_mutex);
+    _holdRegistrations = false;
+    for (auto& success : _heldRegistrations)
+        success->set_value(true);
+    _heldRegistrations.clear();
+}
+
 void DeflectServer::processEvent(const deflect::Event& event)
 {
     BOOST_REQUIRE(_eventReceiver);
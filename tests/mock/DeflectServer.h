@@ -51,13 +51,21 @@ typedef __int32 int32_t;
 #include <deflect/server/EventReceiver.h>
 #include <deflect/server/Server.h>
 
+#include <functional>
+#include <vector>
+
 class DeflectServer
 {
 public:
-    explicit DeflectServer();
+    /** Configure the server before it is moved to its thread. */
+    using ServerSetup = std::function<void(deflect::server::Server&)>;
+
+    explicit DeflectServer(const QString& unixSocketPath = QString(),
+                           const ServerSetup& setup = ServerSetup());
     ~DeflectServer();
 
     quint16 serverPort() const { return _server->getPort(); }
+    QString unixSocketPath() const { return _server->getUnixSocketPath(); }
     void requestFrame(QString uri);
     void waitForMessage();
 
@@ -93,6 +101,12 @@ public:
 
     void processEvent(const deflect::Event& event);
 
+    /** Leave the registrations for events unanswered until released. */
+    void holdEventRegistrations();
+
+    /** Answer the held registrations for events successfully. */
+    void releaseEventRegistrations();
+
 private:
     QThread _thread;
     // destroyed by Object::deleteLater
@@ -111,6 +125,9 @@ private:
     FrameReceivedCallback _frameReceivedCallback;
 
     deflect::server::EventReceiver* _eventReceiver{nullptr};
+
+    bool _holdRegistrations{false};
+    std::vector<deflect::server::BoolPromisePtr> _heldRegistrations;
 };
 
 #endif